@@ -23,6 +23,7 @@
 
 #include "renderer_d3d12.h"
 #include "audioEngine.h"
+#include <tomtendo\timeline.h>
 
 static const uint32_t FramePlotSampleCount = 500;
 using frameSampleBuffer = wtQueue< float, FramePlotSampleCount >;
@@ -123,9 +124,17 @@ void wtRenderer::BuildImguiCommandList()
 
 			if ( ImGui::CollapsingHeader( "ASM", ImGuiTreeNodeFlags_OpenOnArrow ) )
 			{
-				for ( int i = 0; i < fr->romHeader.prgRomBanks; ++i )
+				if ( ImGui::Button( "Refresh" ) ) {
+					app->refreshDisassembly = true;
+				}
+
+				const std::shared_ptr<const wtAppDisassembly_t> disassembly = std::atomic_load( &app->disassembly );
+				const uint32_t bankCount = ( disassembly != nullptr ) ? static_cast<uint32_t>( disassembly->banks.size() ) : 0;
+				for ( uint32_t i = 0; i < bankCount; ++i )
 				{
-					if ( debugData.prgRomAsm[ i ].empty() )
+					const wtAppDisassembly_t::bank_t& bank = disassembly->banks[ i ];
+					const uint32_t lineCount = static_cast<uint32_t>( bank.lineStarts.size() ) - 1;
+					if ( lineCount == 0 )
 						continue;
 
 					char treeNodeName[ wtAppDebug_t::MaxPrgRomBanks ];
@@ -133,9 +142,17 @@ void wtRenderer::BuildImguiCommandList()
 					if ( ImGui::TreeNode( treeNodeName, "PRG Bank %i", i ) )
 					{
 						if ( ImGui::Button( "Copy" ) ) {
-							ToClipboard( debugData.prgRomAsm[ i ] );
+							ToClipboard( bank.text );
 						}
-						ImGui::TextWrapped( debugData.prgRomAsm[ i ].c_str() );
+
+						ImGui::BeginChild( treeNodeName, ImVec2( 0, 400 ), false, ImGuiWindowFlags_HorizontalScrollbar );
+						ImGuiListClipper clipper( lineCount );
+						while ( clipper.Step() )
+						{
+							const char* text = bank.text.c_str();
+							ImGui::TextUnformatted( text + bank.lineStarts[ clipper.DisplayStart ], text + bank.lineStarts[ clipper.DisplayEnd ] );
+						}
+						ImGui::EndChild();
 						ImGui::TreePop();
 					}
 				}
@@ -205,6 +222,41 @@ void wtRenderer::BuildImguiCommandList()
 					ImVec2( 0, 0 ) );
 				ImGui::SameLine();
 				ImGui::Text( "%.3f ms/frame (%.1f FPS)", fr->dbgInfo.frameTimeUs / 1000.0f, 1000000.0f / fr->dbgInfo.frameTimeUs );
+				ImGui::Separator();
+
+				static const char* perfNames[ PERF_COUNTER_COUNT ] = { "CPU", "PPU", "APU", "Mapper", "State", "Commands" };
+				ImGui::Columns( 5, "perfCounters" );
+				ImGui::Text( "Subsystem (us)" );	ImGui::NextColumn();
+				ImGui::Text( "Last" );				ImGui::NextColumn();
+				ImGui::Text( "Min" );				ImGui::NextColumn();
+				ImGui::Text( "Avg" );				ImGui::NextColumn();
+				ImGui::Text( "P99" );				ImGui::NextColumn();
+				for ( uint32_t i = 0; i < PERF_COUNTER_COUNT; ++i )
+				{
+					const perfStat_t& stat = fr->dbgInfo.perf[ i ];
+					ImGui::Text( "%s", perfNames[ i ] );		ImGui::NextColumn();
+					ImGui::Text( "%.1f", stat.lastUs );		ImGui::NextColumn();
+					ImGui::Text( "%.1f", stat.minUs );		ImGui::NextColumn();
+					ImGui::Text( "%.1f", stat.avgUs );		ImGui::NextColumn();
+					ImGui::Text( "%.1f", stat.p99Us );		ImGui::NextColumn();
+				}
+				ImGui::Columns( 1 );
+			}
+
+			if ( ImGui::CollapsingHeader( "Timeline", ImGuiTreeNodeFlags_OpenOnArrow ) )
+			{
+				bool recording = wtTimeline::IsEnabled();
+				if ( ImGui::Checkbox( "Record", &recording ) ) {
+					wtTimeline::Enable( recording );
+				}
+				ImGui::SameLine();
+				if ( ImGui::Button( "Clear" ) ) {
+					wtTimeline::Clear();
+				}
+				ImGui::SameLine();
+				if ( ImGui::Button( "Export" ) ) {
+					wtTimeline::Export( "timeline.json" );
+				}
 			}
 
 			if ( ImGui::CollapsingHeader( "Controls", ImGuiTreeNodeFlags_OpenOnArrow ) )
@@ -284,14 +336,14 @@ void wtRenderer::BuildImguiCommandList()
 					nesSystem.SubmitCommand( traceCmd );
 				}
 
-				if ( fr->stateCount > 0 )
+				if ( fr->movieFrameCount > 0 )
 				{
 					const int32_t displayFrame = static_cast<int>( fr->playbackState.currentFrame );
-					const int32_t maxFrames = static_cast< int >( fr->stateCount );
+					const int32_t maxFrames = static_cast< int >( fr->movieFrameCount );
 					int32_t playFrame = displayFrame;
-					ImGui::SliderInt( "", &playFrame, 0, (int32_t)fr->stateCount );
+					ImGui::SliderInt( "", &playFrame, 0, (int32_t)fr->movieFrameCount );
 					ImGui::SameLine();
-					ImGui::Text( "%i", fr->stateCount );
+					ImGui::Text( "%i", fr->movieFrameCount );
 
 					if( playFrame != displayFrame )
 					{
@@ -0,0 +1,642 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <new>
+
+#include "../wintendoCore/src/system/NesSystem.h"
+#include "../wintendoCore/include/tomtendo/interface.h"
+#include "../wintendoCore/include/tomtendo/vecEnv.h"
+
+// Usage: wintendoBench [-frames N] [-warmup N] [-iters N] [-romdir dir] [-out file.json] [rom.nes ...]
+// ROM paths are relative to -romdir. The first ROM also drives the microbenchmarks.
+
+static std::atomic<uint64_t> allocCount( 0 );
+
+// Array forms too, so every allocation pairs malloc with free. Kept out of line so GCC never
+// matches an inlined free against the operator new call made from std::allocator
+NO_INLINE void* operator new( size_t size )
+{
+	++allocCount;
+	void* ptr = malloc( ( size > 0 ) ? size : 1 );
+	if ( ptr == nullptr ) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+
+NO_INLINE void* operator new[]( size_t size )
+{
+	return operator new( size );
+}
+
+
+NO_INLINE void operator delete( void* ptr ) noexcept
+{
+	free( ptr );
+}
+
+
+NO_INLINE void operator delete( void* ptr, size_t ) noexcept
+{
+	free( ptr );
+}
+
+
+NO_INLINE void operator delete[]( void* ptr ) noexcept
+{
+	free( ptr );
+}
+
+
+NO_INLINE void operator delete[]( void* ptr, size_t ) noexcept
+{
+	free( ptr );
+}
+
+
+// CPU-bound instruction tests, rendering-heavy palette carts and the CHR-RAM PPU tests
+static const char* DefaultRoms[] =
+{
+	"nestest.nes",
+	"instr_test-v5/official_only.nes",
+	"instr_test-v5/all_instrs.nes",
+	"color_test.nes",
+	"full_palette.nes",
+	"full_palette_alt.nes",
+	"palette_ram.nes",
+	"power_up_palette.nes",
+	"sprite_ram.nes",
+	"vbl_clear_time.nes",
+	"vram_access.nes",
+};
+
+
+struct benchConfig_t
+{
+	uint32_t					frames;
+	uint32_t					warmupFrames;
+	uint32_t					iterations;
+	std::string					romDir;
+	std::string					outPath;
+	std::vector<std::string>	roms;
+};
+
+
+struct benchResult_t
+{
+	std::string	name;
+	std::string	unit;
+	uint64_t	ops;
+	double		ns;
+	uint64_t	allocs;
+};
+
+
+struct frameBenchResult_t
+{
+	std::string	rom;
+	int			status;
+	uint64_t	frames;
+	uint64_t	instructions;
+	uint64_t	cpuCycles;
+	double		ns;
+	uint64_t	allocs;
+};
+
+
+class wtBenchTimer
+{
+public:
+	wtBenchTimer()
+	{
+		allocStart = allocCount.load();
+		start = std::chrono::steady_clock::now();
+	}
+
+	double ElapsedNs() const
+	{
+		return static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count() );
+	}
+
+	uint64_t Allocs() const
+	{
+		return allocCount.load() - allocStart;
+	}
+
+private:
+	std::chrono::steady_clock::time_point	start;
+	uint64_t								allocStart;
+};
+
+
+class wtBenchmark
+{
+public:
+	static void ReadMemory( wtSystem& system, const char* name, const uint16_t base, const uint32_t range, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void OpExec( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void PpuExec( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void ApuStep( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void SaveStates( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void FrameHash( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void Fork( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void MovieSeek( const benchConfig_t& cfg, const std::string& rom, config_t& sysCfg, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void VecEnvStep( const benchConfig_t& cfg, const std::string& rom, const uint32_t iterations, std::vector<benchResult_t>& results );
+	static void RunFrames( wtSystem& system, const benchConfig_t& cfg, frameBenchResult_t& result );
+	static void Restore( wtSystem& system, const wtStateBlob& state );
+	static void Record( wtSystem& system, wtStateBlob& state );
+};
+
+
+static volatile uint32_t benchSink;
+static Input benchInput; // No buttons held
+
+
+void wtBenchmark::Restore( wtSystem& system, const wtStateBlob& state )
+{
+	system.RestoreState( state );
+}
+
+
+void wtBenchmark::Record( wtSystem& system, wtStateBlob& state )
+{
+	system.RecordSate( state );
+}
+
+
+void wtBenchmark::ReadMemory( wtSystem& system, const char* name, const uint16_t base, const uint32_t range, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	uint32_t sum = 0;
+	wtBenchTimer timer;
+	for ( uint32_t i = 0; i < iterations; ++i ) {
+		sum += system.ReadMemory( static_cast<uint16_t>( base + ( i % range ) ) );
+	}
+	const double ns = timer.ElapsedNs();
+	benchSink = sum;
+
+	results.push_back( { name, "read", iterations, ns, timer.Allocs() } );
+}
+
+
+void wtBenchmark::OpExec( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	// One instruction per Step, without the PPU/APU interleave of RunLoop
+	Cpu6502& cpu = system.cpu;
+	const uint64_t startInstr = cpu.instrCount;
+
+	wtBenchTimer timer;
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		if ( !cpu.Step<CPU_HOOK_NONE>( cpu.cycle + cpuCycle_t( 1 ) ) ) {
+			break;
+		}
+	}
+	const double ns = timer.ElapsedNs();
+
+	results.push_back( { "OpExec", "instruction", cpu.instrCount - startInstr, ns, timer.Allocs() } );
+}
+
+
+void wtBenchmark::PpuExec( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	PPU& ppu = system.ppu;
+	const ppuCycle_t startCycle = ppu.GetCycle();
+
+	wtBenchTimer timer;
+	ppu.Step( startCycle + ppuCycle_t( iterations ) );
+	const double ns = timer.ElapsedNs();
+
+	results.push_back( { "PPU::Exec", "ppu_cycle", static_cast<uint64_t>( ( ppu.GetCycle() - startCycle ).count() ), ns, timer.Allocs() } );
+}
+
+
+void wtBenchmark::ApuStep( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	APU& apu = system.apu;
+	const cpuCycle_t startCycle = apu.GetCycle();
+
+	wtBenchTimer timer;
+	apu.Begin();
+	apu.Step( startCycle + cpuCycle_t( iterations ) );
+	apu.End();
+	const double ns = timer.ElapsedNs();
+
+	results.push_back( { "APU::Step", "cpu_cycle", static_cast<uint64_t>( ( apu.GetCycle() - startCycle ).count() ), ns, timer.Allocs() } );
+}
+
+
+void wtBenchmark::SaveStates( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	wtStateBlob state;
+	system.RecordSate( state ); // Size the blob so the loop measures steady-state cost
+
+	{
+		wtBenchTimer timer;
+		for ( uint32_t i = 0; i < iterations; ++i ) {
+			system.RecordSate( state );
+		}
+		results.push_back( { "RecordSate", "state", iterations, timer.ElapsedNs(), timer.Allocs() } );
+	}
+
+	{
+		wtBenchTimer timer;
+		for ( uint32_t i = 0; i < iterations; ++i ) {
+			system.RestoreState( state );
+		}
+		results.push_back( { "RestoreState", "state", iterations, timer.ElapsedNs(), timer.Allocs() } );
+	}
+}
+
+
+// Compare against ns_per_frame; FRAME_HASH adds this once per frame
+void wtBenchmark::FrameHash( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	wtBenchTimer timer;
+	for ( uint32_t i = 0; i < iterations; ++i ) {
+		system.HashFrame();
+	}
+	results.push_back( { "HashFrame", "frame", iterations, timer.ElapsedNs(), timer.Allocs() } );
+	benchSink += static_cast<uint32_t>( system.frameHash.state );
+}
+
+
+// Clone allocates the machine once; CopyState is the per-branch cost and should not allocate
+void wtBenchmark::Fork( wtSystem& system, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	std::unique_ptr<wtSystem> fork( new wtSystem() );
+	{
+		wtBenchTimer timer;
+		fork->Clone( system );
+		results.push_back( { "Clone", "machine", 1, timer.ElapsedNs(), timer.Allocs() } );
+	}
+
+	wtBenchTimer timer;
+	for ( uint32_t i = 0; i < iterations; ++i ) {
+		fork->CopyState( system );
+	}
+	results.push_back( { "CopyState", "fork", iterations, timer.ElapsedNs(), timer.Allocs() } );
+}
+
+
+static bool ReadRom( const benchConfig_t& cfg, const std::string& rom, std::vector<uint8_t>& romData )
+{
+	const std::string path = cfg.romDir.empty() ? rom : ( cfg.romDir + "/" + rom );
+	FILE* file = fopen( path.c_str(), "rb" );
+	if ( file == nullptr ) {
+		return false;
+	}
+	uint8_t buffer[ 4096 ];
+	size_t readBytes;
+	while ( ( readBytes = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 ) {
+		romData.insert( romData.end(), buffer, buffer + readBytes );
+	}
+	fclose( file );
+	return true;
+}
+
+
+// Records cfg.frames from power-on, then seeks to scattered frames of the movie. The ROM boots
+// from memory so nothing is written beside it.
+void wtBenchmark::MovieSeek( const benchConfig_t& cfg, const std::string& rom, config_t& sysCfg, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	std::vector<uint8_t> romData;
+	if ( !ReadRom( cfg, rom, romData ) ) {
+		return;
+	}
+
+	std::unique_ptr<wtSystem> system( new wtSystem() );
+	if ( system->Init( romData.data(), static_cast<uint32_t>( romData.size() ) ) != 0 ) {
+		return;
+	}
+	system->AttachInputHandler( &benchInput );
+	system->SetConfig( sysCfg );
+
+	const uint32_t frames = ( cfg.frames > 1 ) ? cfg.frames : 2;
+
+	sysCmd_t cmd;
+	cmd.type = sysCmdType_t::RECORD;
+	cmd.parms[ 0 ].i = frames;
+	cmd.parms[ 1 ].u = 1;
+	cmd.parms[ 2 ].i = 0;
+	system->SubmitCommand( cmd );
+
+	wtFrameResult frameResult = {};
+	for ( uint32_t i = 0; i < ( frames + 16 ); ++i )
+	{
+		system->RunEpoch( FrameLatencyNs );
+		system->GetFrameResult( frameResult );
+		if ( frameResult.playbackState.replayState != replayStateCode_t::RECORD ) {
+			break;
+		}
+	}
+
+	uint32_t seed = 1;
+	wtBenchTimer timer;
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		seed = seed * 1664525u + 1013904223u;
+
+		// The paused REPLAY seeks inside RunEpoch, then holds on the target
+		cmd = sysCmd_t();
+		cmd.type = sysCmdType_t::REPLAY;
+		cmd.parms[ 0 ].i = ( seed >> 8 ) % frames;
+		cmd.parms[ 1 ].u = 1;
+		system->SubmitCommand( cmd );
+		system->RunEpoch( FrameLatencyNs );
+	}
+	results.push_back( { "MovieSeek", "seek", iterations, timer.ElapsedNs(), timer.Allocs() } );
+}
+
+
+// Batched steps at the default frame skip and observation, one env per core. Reported per env step.
+void wtBenchmark::VecEnvStep( const benchConfig_t& cfg, const std::string& rom, const uint32_t iterations, std::vector<benchResult_t>& results )
+{
+	std::vector<uint8_t> romData;
+	if ( !ReadRom( cfg, rom, romData ) ) {
+		return;
+	}
+
+	vecEnvConfig_t envCfg = DefaultVecEnvConfig();
+	envCfg.envCount = std::max( envCfg.envCount, std::thread::hardware_concurrency() );
+
+	std::unique_ptr<wtVecEnv> env( new wtVecEnv() );
+	if ( env->Init( romData.data(), static_cast<uint32_t>( romData.size() ), envCfg ) != 0 ) {
+		return;
+	}
+
+	const uint32_t envCount = env->GetEnvCount();
+	std::vector<uint32_t> seeds( envCount );
+	std::vector<ButtonFlags> actions( envCount );
+	std::vector<uint8_t> observations( envCount * env->GetObservationSize() );
+	std::vector<uint8_t> ram( envCount * env->GetRamSize() );
+	for ( uint32_t envIx = 0; envIx < envCount; ++envIx ) {
+		seeds[ envIx ] = envIx;
+	}
+	env->Reset( seeds.data(), nullptr, observations.data(), ram.data() );
+
+	uint32_t seed = 1;
+	wtBenchTimer timer;
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		for ( uint32_t envIx = 0; envIx < envCount; ++envIx )
+		{
+			seed = seed * 1664525u + 1013904223u;
+			actions[ envIx ] = static_cast<ButtonFlags>( seed >> 24 );
+		}
+		env->Step( actions.data(), observations.data(), ram.data() );
+	}
+	results.push_back( { "VecEnv.step", "env step", static_cast<uint64_t>( iterations ) * envCount, timer.ElapsedNs(), timer.Allocs() } );
+}
+
+
+void wtBenchmark::RunFrames( wtSystem& system, const benchConfig_t& cfg, frameBenchResult_t& result )
+{
+	wtFrameResult frameResult = {};
+
+	for ( uint32_t i = 0; i < cfg.warmupFrames; ++i )
+	{
+		system.RunEpoch( FrameLatencyNs );
+		system.GetFrameResult( frameResult );
+	}
+
+	const uint64_t startFrame = frameResult.currentFrame;
+	const uint64_t startInstr = system.cpu.instrCount;
+	const cpuCycle_t startCycle = system.cpu.cycle;
+
+	wtBenchTimer timer;
+	for ( uint32_t i = 0; i < cfg.frames; ++i )
+	{
+		system.RunEpoch( FrameLatencyNs );
+		system.GetFrameResult( frameResult );
+	}
+	result.ns = timer.ElapsedNs();
+	result.allocs = timer.Allocs();
+
+	result.frames = frameResult.currentFrame - startFrame;
+	result.instructions = system.cpu.instrCount - startInstr;
+	result.cpuCycles = static_cast<uint64_t>( ( system.cpu.cycle - startCycle ).count() );
+}
+
+
+static void WriteJsonString( FILE* file, const std::string& str )
+{
+	fputc( '"', file );
+	for ( const char c : str )
+	{
+		if ( ( c == '"' ) || ( c == '\\' ) ) {
+			fputc( '\\', file );
+		}
+		fputc( c, file );
+	}
+	fputc( '"', file );
+}
+
+
+static double PerOp( const double value, const uint64_t ops )
+{
+	return ( ops > 0 ) ? ( value / static_cast<double>( ops ) ) : 0.0;
+}
+
+
+static void WriteJson( FILE* file, const benchConfig_t& cfg, const std::vector<benchResult_t>& micro, const std::vector<frameBenchResult_t>& frames )
+{
+	fprintf( file, "{\n\t\"frames\": %u,\n\t\"warmup\": %u,\n\t\"iterations\": %u,\n", cfg.frames, cfg.warmupFrames, cfg.iterations );
+
+	fprintf( file, "\t\"micro\": [" );
+	for ( size_t i = 0; i < micro.size(); ++i )
+	{
+		const benchResult_t& r = micro[ i ];
+		fprintf( file, "%s\n\t\t{ \"name\": ", ( i > 0 ) ? "," : "" );
+		WriteJsonString( file, r.name );
+		fprintf( file, ", \"unit\": " );
+		WriteJsonString( file, r.unit );
+		fprintf( file, ", \"ops\": %llu, \"total_ns\": %.0f, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f }",
+			static_cast<unsigned long long>( r.ops ), r.ns, PerOp( r.ns, r.ops ), PerOp( static_cast<double>( r.allocs ), r.ops ) );
+	}
+	fprintf( file, "\n\t],\n" );
+
+	fprintf( file, "\t\"frame\": [" );
+	for ( size_t i = 0; i < frames.size(); ++i )
+	{
+		const frameBenchResult_t& r = frames[ i ];
+		fprintf( file, "%s\n\t\t{ \"rom\": ", ( i > 0 ) ? "," : "" );
+		WriteJsonString( file, r.rom );
+		if ( r.status != 0 ) {
+			fprintf( file, ", \"error\": \"load failed\" }" );
+			continue;
+		}
+		const double fps = ( r.ns > 0.0 ) ? ( 1e9 * r.frames / r.ns ) : 0.0;
+		fprintf( file, ", \"frames\": %llu, \"instructions\": %llu, \"cpu_cycles\": %llu, \"total_ns\": %.0f, \"fps\": %.2f, \"ns_per_frame\": %.1f, \"ns_per_instruction\": %.3f, \"allocs_per_frame\": %.3f }",
+			static_cast<unsigned long long>( r.frames ), static_cast<unsigned long long>( r.instructions ), static_cast<unsigned long long>( r.cpuCycles ),
+			r.ns, fps, PerOp( r.ns, r.frames ), PerOp( r.ns, r.instructions ), PerOp( static_cast<double>( r.allocs ), r.frames ) );
+	}
+	fprintf( file, "\n\t]\n}\n" );
+}
+
+
+static int BootRom( wtSystem& system, const benchConfig_t& cfg, const std::string& rom, config_t& sysCfg )
+{
+	const std::string path = cfg.romDir.empty() ? rom : ( cfg.romDir + "/" + rom );
+	if ( system.Init( std::wstring( path.begin(), path.end() ) ) != 0 ) {
+		return -1;
+	}
+	system.AttachInputHandler( &benchInput );
+	system.SetConfig( sysCfg );
+	return 0;
+}
+
+
+static bool ParseArgs( const int argc, char* argv[], benchConfig_t& cfg )
+{
+	cfg.frames = 600;
+	cfg.warmupFrames = 60;
+	cfg.iterations = 1000000;
+	cfg.romDir = "../wintendoCore/Tests";
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( ( strcmp( argv[ i ], "-frames" ) == 0 ) && hasValue ) {
+			cfg.frames = static_cast<uint32_t>( atoi( argv[ ++i ] ) );
+		} else if ( ( strcmp( argv[ i ], "-warmup" ) == 0 ) && hasValue ) {
+			cfg.warmupFrames = static_cast<uint32_t>( atoi( argv[ ++i ] ) );
+		} else if ( ( strcmp( argv[ i ], "-iters" ) == 0 ) && hasValue ) {
+			cfg.iterations = static_cast<uint32_t>( atoi( argv[ ++i ] ) );
+		} else if ( ( strcmp( argv[ i ], "-romdir" ) == 0 ) && hasValue ) {
+			cfg.romDir = argv[ ++i ];
+		} else if ( ( strcmp( argv[ i ], "-out" ) == 0 ) && hasValue ) {
+			cfg.outPath = argv[ ++i ];
+		} else if ( argv[ i ][ 0 ] == '-' ) {
+			fprintf( stderr, "Unknown option: %s\n", argv[ i ] );
+			return false;
+		} else {
+			cfg.roms.push_back( argv[ i ] );
+		}
+	}
+
+	if ( cfg.roms.empty() ) {
+		cfg.roms.assign( std::begin( DefaultRoms ), std::end( DefaultRoms ) );
+	}
+	return ( cfg.iterations > 0 );
+}
+
+
+int main( int argc, char* argv[] )
+{
+	benchConfig_t cfg;
+	if ( !ParseArgs( argc, argv, cfg ) ) {
+		fprintf( stderr, "Usage: wintendoBench [-frames N] [-warmup N] [-iters N] [-romdir dir] [-out file.json] [rom.nes ...]\n" );
+		return 1;
+	}
+
+	config_t sysCfg = DefaultConfig();
+	sysCfg.sys.flags = emulationFlags_t::HEADLESS;
+
+	std::vector<benchResult_t> micro;
+	std::vector<frameBenchResult_t> frames;
+
+	// wtSystem carries its frame buffers inline, keep it off the stack
+	std::unique_ptr<wtSystem> system( new wtSystem() );
+
+	if ( BootRom( *system, cfg, cfg.roms[ 0 ], sysCfg ) == 0 )
+	{
+		wtFrameResult frameResult = {};
+		for ( uint32_t i = 0; i < cfg.warmupFrames; ++i )
+		{
+			system->RunEpoch( FrameLatencyNs );
+			system->GetFrameResult( frameResult );
+		}
+
+		// Every component bench starts from the same snapshot
+		wtStateBlob snapshot;
+		wtBenchmark::Record( *system, snapshot );
+
+		wtBenchmark::ReadMemory( *system, "ReadMemory.ram", 0x0000, wtSystem::PhysicalMemorySize, cfg.iterations, micro );
+		wtBenchmark::ReadMemory( *system, "ReadMemory.prg", wtSystem::Bank0, wtSystem::MemoryWrap - wtSystem::Bank0, cfg.iterations, micro );
+		wtBenchmark::OpExec( *system, cfg.iterations, micro );
+		wtBenchmark::Restore( *system, snapshot );
+		wtBenchmark::PpuExec( *system, cfg.iterations, micro );
+		wtBenchmark::Restore( *system, snapshot );
+		wtBenchmark::ApuStep( *system, cfg.iterations, micro );
+		wtBenchmark::Restore( *system, snapshot );
+		wtBenchmark::SaveStates( *system, cfg.iterations / 1000 + 1, micro );
+		wtBenchmark::FrameHash( *system, cfg.iterations / 1000 + 1, micro );
+		wtBenchmark::Fork( *system, cfg.iterations / 1000 + 1, micro );
+		wtBenchmark::MovieSeek( cfg, cfg.roms[ 0 ], sysCfg, cfg.iterations / 100000 + 1, micro );
+		wtBenchmark::VecEnvStep( cfg, cfg.roms[ 0 ], cfg.iterations / 10000 + 1, micro );
+	}
+	else
+	{
+		fprintf( stderr, "Failed to load %s\n", cfg.roms[ 0 ].c_str() );
+	}
+
+	for ( const std::string& rom : cfg.roms )
+	{
+		frameBenchResult_t result = {};
+		result.rom = rom;
+
+		system.reset( new wtSystem() );
+		result.status = BootRom( *system, cfg, rom, sysCfg );
+		if ( result.status == 0 ) {
+			wtBenchmark::RunFrames( *system, cfg, result );
+		}
+		frames.push_back( result );
+	}
+	system.reset();
+
+	FILE* out = stdout;
+	if ( !cfg.outPath.empty() )
+	{
+		out = fopen( cfg.outPath.c_str(), "w" );
+		if ( out == nullptr )
+		{
+			fprintf( stderr, "Failed to open %s\n", cfg.outPath.c_str() );
+			return 1;
+		}
+	}
+
+	WriteJson( out, cfg, micro, frames );
+
+	if ( out != stdout ) {
+		fclose( out );
+	}
+
+	for ( const frameBenchResult_t& r : frames )
+	{
+		if ( r.status != 0 ) {
+			return 1;
+		}
+	}
+	return 0;
+}
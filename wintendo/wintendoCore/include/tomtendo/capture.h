@@ -0,0 +1,116 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include "util.h"
+#include "time.h"
+
+namespace Tomtendo
+{
+	struct wtFrameResult;
+
+	enum class captureFormat_t : uint8_t
+	{
+		Y4M_WAV,	// YUV4MPEG2 (I420) video and PCM16 WAV audio
+		RAW,		// Headerless RGBA frames and s16le PCM, for piping into ffmpeg
+	};
+
+	struct captureConfig_t
+	{
+		captureFormat_t	format;
+		std::string		videoPath;		// Empty disables video, "-" writes to stdout
+		std::string		audioPath;		// Empty disables audio, "-" writes to stdout
+		uint32_t		audioSampleRate;
+		bool			dropOnOverflow;	// Drop blocks instead of waiting when the writer falls behind
+	};
+
+	captureConfig_t DefaultCaptureConfig();
+
+	class wtCapture
+	{
+	public:
+		static const uint32_t FrameWidth		= 256;
+		static const uint32_t FrameHeight		= 240;
+		static const uint32_t QueueDepth		= 16;
+		static const uint32_t MaxBlockSamples	= 4096;
+
+		wtCapture();
+		~wtCapture();
+
+		wtCapture( const wtCapture& ) = delete;
+		wtCapture& operator=( const wtCapture& ) = delete;
+
+		bool		Open( const captureConfig_t& config );
+		void		Close();
+		bool		IsOpen() const;
+
+		// Call once per RunEpoch/GetFrameResult pair from the emulation thread.
+		void		Submit( const wtFrameResult& frameResult );
+
+		uint64_t	GetFrameCount() const;
+		uint64_t	GetSampleCount() const;
+		uint64_t	GetDroppedCount() const;
+
+	private:
+		struct block_t
+		{
+			uint32_t	videoFrames;	// Repeats cover frames finished inside a single epoch
+			uint32_t	sampleCnt;
+			uint32_t	pixels[ FrameWidth * FrameHeight ];
+			int16_t		samples[ MaxBlockSamples ];
+		};
+
+		using blockQueue_t = wtSpscQueue< block_t, QueueDepth >;
+
+		block_t*	AcquireBlock();
+		void		WriterThread();
+		void		WriteBlock( const block_t& block );
+		void		WriteY4mFrame( const uint32_t* pixels, const bool convert );
+		void		WriteWavHeader( const uint32_t dataBytes );
+
+		captureConfig_t					config;
+		std::unique_ptr<blockQueue_t>	queue;
+		std::unique_ptr<uint8_t[]>		yuv;
+		std::thread						writer;
+		std::atomic<bool>				running;
+		std::atomic<uint64_t>			droppedBlocks;
+
+		FILE*							videoFile;
+		FILE*							audioFile;
+		uint64_t						lastFrame;
+		uint64_t						frameCount;
+		uint64_t						sampleCount;
+
+		// Box-filter decimation state from ApuSamplesPerSec down to audioSampleRate
+		double							resamplePhase;
+		double							resampleAcc;
+		uint32_t						resampleTaps;
+	};
+};
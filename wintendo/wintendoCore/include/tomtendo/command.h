@@ -31,10 +31,17 @@ namespace Tomtendo
 	{
 		LOAD_STATE,
 		SAVE_STATE,
-		RECORD,
-		REPLAY,
+		RECORD,			// parms: frame count (-1 = until stopped), from power-on, keyframe interval (0 = default, -1 = none). Streams to <rom>.wtm
+		REPLAY,			// parms: frame, pause. Plays the last recording, or <rom>.wtm if there is none
 		START_TRACE,
 		STOP_TRACE,
+		START_PROFILE,	// parms: frame count (0 = until stopped), per-frame histograms, JSON instead of CSV
+		STOP_PROFILE,
+		START_CDL,		// Merges into an existing <rom>.cdl
+		STOP_CDL,
+		SET_BREAKPOINT,		// parms: address, breakpointType_t mask, PPU address space, disable
+		CLEAR_BREAKPOINTS,
+		RESUME,				// Continue after a breakpoint hit
 	};
 
 	struct sysCmd_t
@@ -49,6 +56,6 @@ namespace Tomtendo
 		};
 
 		sysCmdType_t	type;
-		parm_t			parms[ MaxParms ];
+		parm_t			parms[ MaxParms ] = {};
 	};
 };
\ No newline at end of file
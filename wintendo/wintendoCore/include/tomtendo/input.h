@@ -90,6 +90,7 @@ namespace Tomtendo
 
 		public:
 			ButtonFlags			GetKeyBuffer( const ControllerId controllerId ) const;
+			void				SetKeyBuffer( const ControllerId controllerId, const ButtonFlags buttons ); // Whole pad at once, for scripted input
 			mouse_t				GetMouse() const;
 			void				BindKey( const char key, const ControllerId controllerId, const ButtonFlags button );		
 			void				StoreKey( const uint32_t key );
@@ -32,6 +32,8 @@
 #include "image.h"
 #include "serializer.h"
 #include "log.h"
+#include "stateFile.h"
+#include "movie.h"
 
 #include <cstdint>
 
@@ -54,19 +56,32 @@ namespace Tomtendo
 		Input	input;
 
 		int		Boot( const std::wstring& filePath, const uint32_t resetVectorManual = 0x10000 );
+		int		Boot( const uint8_t* romData, const uint32_t romSize, const uint32_t resetVectorManual = 0x10000 ); // Buffer must outlive the emulator
+		Emulator*	Clone(); // Fork sharing this ROM and config, with its own copy of the running state. Caller deletes it
+		bool	CopyState( Emulator& source ); // Re-forks in place from a machine running the same ROM; no allocations once warm
 		int		RunEpoch( const std::chrono::nanoseconds& runCycles );
 		void	GetFrameResult( wtFrameResult& outFrameResult );
 		void	SetConfig( config_t& cfg );
 
 		void	SubmitCommand( const sysCmd_t& cmd );
 
+		void	GetCodeDataStats( cdlStats_t& stats ) const; // Coverage from the CDL, see START_CDL
+		bool	GetBreakpointHit( breakpointHit_t& hit ) const; // True while stopped at a breakpoint, see RESUME
 		void	UpdateDebugImages();
-		void	GenerateRomDissambly( std::string prgRomAsm[ 128 ] );
+		void	GenerateRomDissambly( std::string prgRomAsm[ 128 ] ); // Formats every bank; prefer the ranged calls below
+		uint32_t	GetDisassemblyLineCount( const uint32_t bankNum ) const; // These read the cart and CDL, call them from the emulation thread
+		void	GetDisassembly( const uint32_t bankNum, const uint32_t firstLine, const uint32_t lineCount, std::string& out ) const; // Appends to 'out'
 		void	GenerateChrRomTables( wtPatternTableImage chrRom[ 32 ] );
 	};
 
-	static const char* STATE_MEMORY_LABEL = "Memory";
-	static const char* STATE_VRAM_LABEL	= "VRAM";
+	static const char* STATE_SYSTEM_LABEL	= "System";
+	static const char* STATE_MEMORY_LABEL	= "Memory";
+	static const char* STATE_CPU_LABEL		= "CPU";
+	static const char* STATE_PPU_LABEL		= "PPU";
+	static const char* STATE_VRAM_LABEL		= "VRAM";
+	static const char* STATE_APU_LABEL		= "APU";
+	static const char* STATE_MAPPER_LABEL	= "Mapper";
+	static const char* STATE_SRAM_LABEL		= "SRAM";
 
 	uint32_t ScreenWidth();
 
@@ -89,6 +104,9 @@ namespace Tomtendo
 		CLAMP_FPS		= 1 << 1,
 		LIMIT_STALL		= 1 << 2,
 		HEADLESS		= 1 << 3,
+		REFERENCE		= 1 << 4, // Generic paths only: virtual mapper calls, instrumented CPU core. See wintendoTest -lockstep
+		FRAME_HASH		= 1 << 5, // Fill wtFrameResult::frameHash; replays also write them to <rom>.fhash
+		NO_AUDIO		= 1 << 6, // Skip the mixer, the channels still clock so $4015 and IRQs are unchanged
 		ALL				= 0xFFFFFFFF,
 	};
 
@@ -97,11 +115,17 @@ namespace Tomtendo
 		return ( static_cast<uint32_t>( lhs ) & static_cast<uint32_t>( rhs ) );
 	}
 
+	inline emulationFlags_t operator|( emulationFlags_t lhs, emulationFlags_t rhs )
+	{
+		return static_cast<emulationFlags_t>( static_cast<uint32_t>( lhs ) | static_cast<uint32_t>( rhs ) );
+	}
+
 	struct config_t
 	{
 		struct System
 		{
 			emulationFlags_t	flags;
+			uint32_t			seekIndexMB;	// Memory kept for movie seek states, 0 disables the index
 		} sys;
 
 		//struct CPU
@@ -132,8 +156,29 @@ namespace Tomtendo
 		} ppu;
 	};
 
+	enum perfCounter_t : uint32_t
+	{
+		PERF_CPU,
+		PERF_PPU,
+		PERF_APU,
+		PERF_MAPPER,		// Register writes and scanline clocks; also counted in CPU/PPU
+		PERF_STATE,			// Per-frame state capture
+		PERF_COMMANDS,
+		PERF_COUNTER_COUNT,
+	};
+
+	// Microseconds spent per RunEpoch, over a sliding window of recent epochs. Zero unless the core is built with PERF_COUNTERS=1
+	struct perfStat_t
+	{
+		float			lastUs;
+		float			minUs;
+		float			avgUs;
+		float			p99Us;
+	};
+
 	struct debugTiming_t
 	{
+		perfStat_t		perf[ PERF_COUNTER_COUNT ];
 		uint32_t		frameTimeUs;
 		uint32_t		totalTimeUs;
 		uint32_t		simulationTimeUs;
@@ -282,12 +327,37 @@ namespace Tomtendo
 		wtSampleQueue	mixed;
 	};
 
+	// xxHash64s of a finished frame, taken when its state is captured at the pre-render line
+	struct frameHash_t
+	{
+		uint64_t	frame;		// wtFrameResult::currentFrame at capture
+		uint64_t	video;		// Finished wtDisplayImage
+		uint64_t	ram;		// 2KB work RAM
+		uint64_t	state;		// Serialized machine, the bytes of wtFrameResult::frameState
+	};
+
+	// <rom>.fhash layout: frameHashFileHeader_t, then frameHash_t[ frameCount ] in playback order
+	static const uint32_t FrameHashFileMagic	= 0x48465457; // "WTFH"
+	static const uint32_t FrameHashFileVersion	= 1;
+
+	struct frameHashFileHeader_t
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint64_t	romHash;
+		uint64_t	frameCount;
+	};
+	static_assert( sizeof( frameHashFileHeader_t ) == 24, "Frame hash file header layout changed" );
+	static_assert( sizeof( frameHash_t ) == 32, "Frame hash record layout changed" );
+
 	struct stateHeader_t
 	{
 		uint8_t* memory;
 		uint8_t* vram;
+		uint8_t* sram;			// Null when the mapper has no PRG RAM
 		uint32_t memorySize;
 		uint32_t vramSize;
+		uint32_t sramSize;
 	};
 
 	class wtStateBlob
@@ -299,20 +369,26 @@ namespace Tomtendo
 			bytes = nullptr;
 			byteCount = 0;
 			cycle = masterCycle_t( 0 );
+			header = {};
 		}
 
+		wtStateBlob( const wtStateBlob& blob );
+		wtStateBlob& operator=( const wtStateBlob& blob );
+
 		~wtStateBlob()
 		{
 			Reset();
 		}
 
-		bool		IsValid() const;
-		uint32_t	GetBufferSize() const;
+		bool			IsValid() const;
+		uint32_t		GetBufferSize() const;
 
-		uint8_t*	GetPtr();
-		void		Set( Serializer& s, const masterCycle_t sysCycle );
-		void		WriteTo( Serializer& s ) const;
-		void		Reset();
+		uint8_t*		GetPtr();
+		const uint8_t*	GetPtr() const;
+		void			Resize( const uint32_t sizeInBytes );
+		void			Set( Serializer& s, const masterCycle_t sysCycle );
+		void			WriteTo( Serializer& s ) const;
+		void			Reset();
 
 		stateHeader_t	header;
 	private:
@@ -358,11 +434,12 @@ namespace Tomtendo
 	struct wtFrameResult
 	{
 		uint64_t					currentFrame;
-		uint64_t					stateCount;
+		uint64_t					movieFrameCount;
 		playbackState_t				playbackState;
 		wtDisplayImage*				frameBuffer;
 		apuOutput_t*				soundOutput;
 		wtStateBlob*				frameState;
+		frameHash_t					frameHash;	// Zero unless emulationFlags_t::FRAME_HASH is set
 
 		// Debug
 		debugTiming_t				dbgInfo;
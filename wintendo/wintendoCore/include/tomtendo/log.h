@@ -22,8 +22,10 @@
 */
 
 #include <cstdint>
+#include <cstdio>
 #include <vector>
 #include <string>
+#include <memory>
 
 namespace Tomtendo
 {
@@ -38,6 +40,81 @@ namespace Tomtendo
 	};
 
 
+	// Packed per-instruction trace entry. Everything else shown in a trace line is
+	// derived from the opcode tables and operands when the log is read back.
+	struct traceRecord_t
+	{
+		uint16_t		pc;
+		uint16_t		address;			// Effective address resolved by the addressing mode
+		uint8_t			opCode;
+		uint8_t			op0;
+		uint8_t			op1;
+		uint8_t			A;
+		uint8_t			X;
+		uint8_t			Y;
+		uint8_t			P;
+		uint8_t			SP;
+		uint32_t		scanline	: 9;	// Biased by one so the pre-render line fits
+		uint32_t		dot			: 9;
+		uint32_t		cycleDelta	: 12;	// CPU cycles since the previous record, saturating
+		uint32_t		nmi			: 1;
+		uint32_t		irq			: 1;
+	};
+	static_assert( sizeof( traceRecord_t ) == 16, "Trace records must stay packed" );
+
+
+	// Byte counts over the Code/Data Logger's PRG and CHR maps
+	struct cdlStats_t
+	{
+		uint32_t		prgSize;
+		uint32_t		prgCode;
+		uint32_t		prgData;
+		uint32_t		prgUnused;
+		uint32_t		chrSize;
+		uint32_t		chrRendered;
+		uint32_t		chrRead;
+		uint32_t		chrUnused;
+	};
+
+
+	enum breakpointType_t : uint8_t
+	{
+		BREAK_NONE		= 0,
+		BREAK_EXEC		= ( 1 << 0 ),
+		BREAK_READ		= ( 1 << 1 ),
+		BREAK_WRITE		= ( 1 << 2 ),
+	};
+
+
+	enum class breakpointSpace_t : uint8_t
+	{
+		CPU,
+		PPU,	// VRAM accesses made by the CPU through PPUDATA
+	};
+
+
+	// Where emulation stopped. For reads and writes, pc is the instruction that made the access.
+	struct breakpointHit_t
+	{
+		uint64_t			cpuCycle;
+		uint64_t			frameNumber;
+		uint16_t			address;
+		uint16_t			pc;
+		breakpointType_t	type;
+		breakpointSpace_t	space;
+	};
+
+
+	struct traceOpInfo_t
+	{
+		const char*		mnemonic;
+		uint8_t			opType;
+		uint8_t			addrMode;
+		uint8_t			operands;
+		bool			illegal;
+	};
+
+
 	class OpDebugInfo
 	{
 	public:
@@ -47,10 +124,6 @@ namespace Tomtendo
 		int32_t			curScanline;
 		uint64_t		cpuCycles;
 		uint64_t		ppuCycles;
-		uint64_t		instrCycles;
-
-		uint32_t		loadCnt;
-		uint32_t		storeCnt;
 
 		uint16_t		instrBegin;
 		uint16_t		address;
@@ -59,7 +132,6 @@ namespace Tomtendo
 
 		uint8_t			opType;
 		uint8_t			addrMode;
-		uint8_t			memValue;
 		uint8_t			byteCode;
 
 		uint8_t			operands;
@@ -69,16 +141,13 @@ namespace Tomtendo
 		bool			isIllegal;
 		bool			irq;
 		bool			nmi;
-		bool			oam;
+
+		static const uint32_t MaxLineLength = 160;
 
 		OpDebugInfo()
 		{
-			loadCnt = 0;
-			storeCnt = 0;
-
 			opType = 0;
 			addrMode = 0;
-			memValue = 0;
 			address = 0;
 			offset = 0;
 			targetAddress = 0;
@@ -86,7 +155,6 @@ namespace Tomtendo
 			curScanline = 0;
 			cpuCycles = 0;
 			ppuCycles = 0;
-			instrCycles = 0;
 
 			op0 = 0;
 			op1 = 0;
@@ -94,7 +162,6 @@ namespace Tomtendo
 			isIllegal = false;
 			irq = false;
 			nmi = false;
-			oam = false;
 
 			mnemonic = "";
 			operands = 0;
@@ -106,30 +173,59 @@ namespace Tomtendo
 		void ToString( std::string& buffer, const bool registerDebug = true, const bool cycleDebug = true ) const;
 	};
 
-	using logFrame_t = std::vector<OpDebugInfo>;
-	using logRecords_t = std::vector<logFrame_t>;
 
+	// Fixed-size ring of trace records. When a spill path is given, each completed
+	// half of the ring is appended to that file so arbitrarily long traces keep
+	// every line while memory use stays bounded.
 	class wtLog
 	{
-	private:
-		logRecords_t		log;
-		uint32_t			frameIx;
-		uint32_t			totalCount;
-
 	public:
-		wtLog() : frameIx( 0 ), totalCount( 0 )
-		{
-			Reset( 1 );
-		}
+		static const uint32_t	RecordsPerFrame	= ( 1 << 15 );
+		static const uint32_t	MaxRingRecords	= ( 1 << 22 );
+
+		wtLog();
+		~wtLog();
+
+		wtLog( const wtLog& ) = delete;
+		wtLog& operator=( const wtLog& ) = delete;
 
-		void				Reset( const uint32_t targetCount );
+		void				Reset( const uint32_t targetCount, const std::string& spillPath = "" );
+		void				SetOpInfo( const uint8_t opCode, const traceOpInfo_t& info );
 		void				NewFrame();
-		OpDebugInfo&		NewLine();
-		const logFrame_t&	GetLogFrame( const uint32_t frameIx ) const;
-		OpDebugInfo&		GetLogLine();
+		traceRecord_t&		NewLine( const uint64_t cpuCycle );
+		traceRecord_t&		GetLogLine();
 		uint32_t			GetRecordCount() const;
+		uint64_t			GetLineCount() const;
 		bool				IsFull() const;
 		bool				IsFinished() const;
+		void				Unpack( const traceRecord_t& record, const uint64_t cpuCycle, OpDebugInfo& outInfo ) const;
 		void				ToString( std::string& buffer, const uint32_t frameBegin, const uint32_t frameEnd, const bool registerDebug = true ) const;
+		void				LinesToString( std::string& buffer, const uint64_t lineBegin, const uint64_t lineEnd, const bool registerDebug = true ) const; // Absolute line numbers, see GetLineCount
+		bool				ToFile( const std::string& path, const uint32_t frameBegin, const uint32_t frameEnd, const bool registerDebug = true ) const;
+
+	private:
+		static const uint64_t	FormatChunkLines = 16384;
+
+		template<class Fn>
+		void				ForEachLine( const uint64_t lineBegin, const uint64_t lineEnd, Fn&& fn ) const;
+		template<class Sink>
+		void				FormatLines( const uint64_t lineBegin, const uint64_t lineEnd, const bool registerDebug, Sink&& sink ) const;
+		void				ReadLines( const uint64_t firstLine, const uint64_t count, traceRecord_t* outRecords, FILE* file ) const;
+		void				GetLineRange( const uint32_t frameBegin, const uint32_t frameEnd, uint64_t& outLineBegin, uint64_t& outLineEnd ) const;
+		uint64_t			GetFirstLine() const;
+		void				Spill( const uint64_t lineBegin, const uint64_t lineEnd );
+
+		std::unique_ptr<traceRecord_t[]>	ring;
+		uint64_t							ringMask;
+		uint64_t							lineCount;
+		uint64_t							firstCycle;		// Cycle of the oldest retained line
+		uint64_t							lastCycle;
+		std::vector<uint64_t>				frameStart;
+		uint32_t							frameIx;
+		uint32_t							totalCount;
+		FILE*								spillFile;
+		std::string							spillPath;
+		uint64_t							spilledCount;
+		traceOpInfo_t						opInfo[ 256 ];
 	};
-};
\ No newline at end of file
+};
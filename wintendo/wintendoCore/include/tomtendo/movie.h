@@ -0,0 +1,114 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Tomtendo
+{
+	// On-disk input movie, <rom>.wtm (little endian):
+	//   movieFileHeader_t
+	//   movieChunk_t + payload, repeated until end of file
+	// INPUT chunks carry one byte per controller per frame, starting at chunk.frame.
+	// STATE chunks carry a wtStateFile image taken during chunk.frame, before any of that
+	// frame's input is needed. The one at frame 0 is the start state; MOVIE_POWER_ON
+	// movies have none and begin from a freshly booted machine instead.
+	// Chunks are only ever appended, so a truncated tail just shortens the movie.
+	static const uint32_t MovieFileMagic	= 0x4D545457; // "WTTM"
+	static const uint16_t MovieFileVersion	= 1;
+	static const uint32_t MovieControllers	= 2;
+
+	enum movieFlags_t : uint32_t
+	{
+		MOVIE_POWER_ON		= ( 1 << 0 ),
+	};
+
+	enum movieChunkType_t : uint32_t
+	{
+		MOVIE_CHUNK_INPUT	= 0x54504E49, // "INPT"
+		MOVIE_CHUNK_STATE	= 0x54415453, // "STAT"
+	};
+
+	struct movieFileHeader_t
+	{
+		uint32_t	magic;
+		uint16_t	version;
+		uint16_t	headerSize;
+		uint32_t	flags;
+		uint32_t	keyframeInterval;	// Frames between STATE chunks, 0 for start state only
+		uint64_t	romHash;
+	};
+	static_assert( sizeof( movieFileHeader_t ) == 24, "Movie file header layout changed" );
+
+	struct movieChunk_t
+	{
+		uint32_t	type;
+		uint32_t	size;
+		uint64_t	frame;
+	};
+	static_assert( sizeof( movieChunk_t ) == 16, "Movie chunk layout changed" );
+
+	struct movieKeyframe_t
+	{
+		uint64_t				frame;
+		std::vector<uint8_t>	image;	// wtStateFile image
+	};
+
+	// A recording in memory. Frames are appended while recording and drained to disk
+	// in chunks by EncodePending(), so the file grows alongside the recording.
+	class wtMovie
+	{
+	public:
+		wtMovie();
+
+		void					Begin( const uint64_t romHash, const uint32_t flags, const uint32_t keyframeInterval );
+		void					Clear();
+		bool					IsEmpty() const;
+
+		void					AddFrame( const uint8_t input[ MovieControllers ] );
+		void					AddKeyframe( const uint64_t frame, std::vector<uint8_t>&& image );
+
+		uint64_t				GetFrameCount() const;
+		uint64_t				GetPendingFrameCount() const; // Recorded but not yet encoded
+		uint8_t					GetInput( const uint64_t frame, const uint32_t controller ) const;
+		const movieKeyframe_t*	FindKeyframe( const uint64_t frame ) const; // Closest at or before 'frame'
+		const movieFileHeader_t& GetHeader() const;
+
+		// Appends everything recorded since the last call. Returns true when the output
+		// starts with the file header, i.e. the file should be rewritten rather than appended to.
+		bool					EncodePending( std::vector<uint8_t>& outData );
+		bool					Parse( const uint8_t* data, const size_t sizeInBytes );
+
+	private:
+		movieFileHeader_t				header;
+		std::vector<uint8_t>			input;
+		std::vector<movieKeyframe_t>	keyframes;
+		uint64_t						encodedFrames;
+		uint32_t						encodedKeyframes;
+		bool							encodedHeader;
+	};
+};
@@ -0,0 +1,93 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Tomtendo
+{
+	class wtStateBlob;
+
+	// How each byte compares with the same byte in the previous snapshot
+	enum class ramSearchFilter_t : uint8_t
+	{
+		EQUAL,
+		CHANGED,
+		INCREASED,
+		DECREASED,
+		DELTA,		// Grew by 'operand' (mod 256); use 256 - n for a decrease of n
+		VALUE,		// Equals 'operand', ignoring the previous snapshot
+	};
+
+	struct ramSearchResult_t
+	{
+		uint16_t	address;	// CPU address: $0000-$07FF work RAM, $6000-$7FFF cart SRAM
+		uint8_t		value;		// As of the latest snapshot
+	};
+
+	// Narrows a set of candidate bytes across savestate snapshots, e.g. to find
+	// where a game keeps its lives counter. Snapshots are read from the blobs'
+	// memory and SRAM sections so searches can run off the emulation thread on
+	// copies of wtFrameResult::frameState.
+	//
+	// Several instances can be searched at once: each keeps its own previous
+	// snapshot and a byte stays a candidate only if every instance passes.
+	class wtRamSearch
+	{
+	public:
+		static const uint32_t	MemorySize		= 0x0800;
+		static const uint32_t	SramSize		= 0x2000;
+		static const uint32_t	SramBase		= 0x6000;
+		static const uint32_t	SnapshotSize	= MemorySize + SramSize;
+		static const uint32_t	LaneBytes		= 32;
+		static const uint32_t	LaneCount		= SnapshotSize / LaneBytes;
+
+		wtRamSearch();
+
+		void		Reset( const wtStateBlob& state );
+		void		Reset( const wtStateBlob* const* states, const uint32_t instanceCount );
+		uint32_t	Filter( const wtStateBlob& state, const ramSearchFilter_t filter, const uint32_t operand = 0 );
+		uint32_t	Filter( const wtStateBlob* const* states, const uint32_t instanceCount, const ramSearchFilter_t filter, const uint32_t operand = 0 );
+		uint32_t	FilterSequence( const wtStateBlob* const* frames, const uint32_t frameCount, const ramSearchFilter_t filter, const uint32_t operand = 0 );
+		uint32_t	GetCandidateCount() const;
+		uint32_t	GetCandidates( std::vector<ramSearchResult_t>& results, const uint32_t maxCount = ~0u, const uint32_t instance = 0 ) const;
+
+	private:
+		struct snapshot_t
+		{
+			uint8_t		bytes[ SnapshotSize ];
+		};
+
+		static bool	Capture( const wtStateBlob& state, snapshot_t& snapshot );
+		void		Intersect( const snapshot_t& cur, const snapshot_t& prev, const ramSearchFilter_t filter, const uint8_t operand );
+		uint32_t	CountCandidates() const;
+
+		std::vector<snapshot_t>	previous;
+		uint32_t				candidates[ LaneCount ];	// Bit i of lane n covers snapshot byte 32n + i
+		uint32_t				candidateCount;
+		bool					hasSram;
+	};
+};
@@ -23,12 +23,19 @@
 
 #pragma once
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <string>
-#include <sstream>
+#include "assert.h"
+#include "util.h"
 
 #define DBG_SERIALIZER 0
 #define _SAVE_
 
+#if DBG_SERIALIZER
+#include <sstream>
+#endif
+
 namespace Tomtendo
 {
 	enum class serializeMode_t
@@ -65,7 +72,7 @@ namespace Tomtendo
 
 		struct section_t
 		{
-			char		name[ MaxNameLength ];
+			uint32_t	tag;	// HashString32() of the label name
 			uint32_t	offset;
 			uint32_t	size;
 		};
@@ -83,15 +90,30 @@ namespace Tomtendo
 		{
 			bytes = new uint8_t[ _sizeInBytes ];
 			byteCount = _sizeInBytes;
+			ownsBytes = true;
 			mode = _mode;
+			index = 0;
+			header.sectionCount = 0;
 			Clear();
 		}
 
+		// Wraps caller memory, e.g. a state blob, so capture and restore need no staging copy
+		Serializer( uint8_t* _bytes, const uint32_t _sizeInBytes, serializeMode_t _mode )
+		{
+			bytes = _bytes;
+			byteCount = _sizeInBytes;
+			ownsBytes = false;
+			mode = _mode;
+			index = 0;
+			header.sectionCount = 0;
+		}
+
 		~Serializer()
 		{
-			if( bytes != nullptr ) {
+			if( ownsBytes && ( bytes != nullptr ) ) {
 				delete[] bytes;
 			}
+			bytes = nullptr;
 			byteCount = 0;
 			mode = serializeMode_t::LOAD;
 			SetPosition( 0 );
@@ -110,9 +132,12 @@ namespace Tomtendo
 		void				SetMode( serializeMode_t mode );
 		serializeMode_t		GetMode() const;
 
-		uint32_t			NewLabel( const char name[ serializerHeader_t::MaxNameLength ] );
-		void				EndLabel( const char name[ serializerHeader_t::MaxNameLength ] );
-		bool				FindLabel( const char name[ serializerHeader_t::MaxNameLength ], serializerHeader_t::section_t** outSection );
+		uint32_t			NewLabel( const char* name );
+		void				EndLabel( const char* name );
+		bool				FindLabel( const char* name, serializerHeader_t::section_t** outSection );
+		bool				FindSection( const uint32_t tag, serializerHeader_t::section_t** outSection );
+		uint32_t			GetSectionCount() const;
+		const serializerHeader_t::section_t& GetSection( const uint32_t sectionIx ) const;
 
 		bool				NextBool( bool& v );
 		bool				NextChar( int8_t& v );
@@ -133,12 +158,133 @@ namespace Tomtendo
 		bool				NextArray( uint8_t* b8, uint32_t sizeInBytes );
 
 	private:
+		bool				NextBytes( void* v, const uint32_t sizeInBytes );
+
 		serializerHeader_t	header;
 		uint8_t*			bytes;
 		uint32_t			byteCount;
 		uint32_t			index;
 		serializeMode_t		mode;
-	public: // FIXME: temp
+		bool				ownsBytes;
+#if DBG_SERIALIZER
+	public:
 		std::stringstream	dbgText;
+#endif
 	};
+
+
+	// Compile-time state visitors. Each machine component lists its fields once in a
+	// templated Visit() and the visitor type picks the direction, so a capture or restore
+	// is straight-line copies. Bounds are validated once by the caller using wtStateSizer.
+	class wtStateSizer
+	{
+	public:
+		static const bool Loading = false;
+
+		wtStateSizer()
+		{
+			size = 0;
+		}
+
+		template< typename T >
+		inline void Field( T& /*v*/ )
+		{
+			size += sizeof( T );
+		}
+
+		inline void Array( void* /*v*/, const uint32_t sizeInBytes )
+		{
+			size += sizeInBytes;
+		}
+
+		inline void BeginLabel( const char* /*name*/ ) {}
+		inline void EndLabel( const char* /*name*/ ) {}
+
+		uint32_t Size() const
+		{
+			return size;
+		}
+
+	private:
+		uint32_t size;
+	};
+
+
+	template< serializeMode_t MODE >
+	struct wtStateCopy;
+
+	template<>
+	struct wtStateCopy< serializeMode_t::STORE >
+	{
+		static inline void Copy( uint8_t* stream, void* field, const uint32_t sizeInBytes )
+		{
+			memcpy( stream, field, sizeInBytes );
+		}
+	};
+
+	template<>
+	struct wtStateCopy< serializeMode_t::LOAD >
+	{
+		static inline void Copy( uint8_t* stream, void* field, const uint32_t sizeInBytes )
+		{
+			memcpy( field, stream, sizeInBytes );
+		}
+	};
+
+
+	template< serializeMode_t MODE >
+	class wtStateVisitor
+	{
+	public:
+		static const bool Loading = ( MODE == serializeMode_t::LOAD );
+
+		wtStateVisitor( Serializer& s ) : serializer( s )
+		{
+			assert( s.GetMode() == MODE );
+			bytes = s.GetPtr();
+			index = s.CurrentSize();
+		}
+
+		~wtStateVisitor()
+		{
+			assert( index <= serializer.BufferSize() );
+			serializer.SetPosition( index );
+		}
+
+		wtStateVisitor( const wtStateVisitor& ) = delete;
+		wtStateVisitor& operator=( const wtStateVisitor& ) = delete;
+
+		template< typename T >
+		inline void Field( T& v )
+		{
+			wtStateCopy< MODE >::Copy( bytes + index, &v, sizeof( T ) );
+			index += sizeof( T );
+		}
+
+		inline void Array( void* v, const uint32_t sizeInBytes )
+		{
+			wtStateCopy< MODE >::Copy( bytes + index, v, sizeInBytes );
+			index += sizeInBytes;
+		}
+
+		void BeginLabel( const char* name )
+		{
+			serializer.SetPosition( index );
+			serializer.NewLabel( name );
+		}
+
+		void EndLabel( const char* name )
+		{
+			serializer.SetPosition( index );
+			serializer.EndLabel( name );
+		}
+
+	private:
+		Serializer&	serializer;
+		uint8_t*	bytes;
+		uint32_t	index;
+	};
+
+	using wtStateWriter = wtStateVisitor< serializeMode_t::STORE >;
+	using wtStateReader = wtStateVisitor< serializeMode_t::LOAD >;
 };
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "util.h"
+#include "serializer.h"
+
+namespace Tomtendo
+{
+	// On-disk savestate layout (little endian):
+	//   stateFileHeader_t
+	//   stateFileSection_t[ sectionCount ]	- offsets are relative to the payload
+	//   payload							- raw visitor output, see wtSystem::Visit()
+	// Each section carries its own layout version. Versions 1 and 2 wrote 12 byte entries without one,
+	// their System section is at the file version and every other section at 1.
+	static const uint32_t StateFileMagic		= 0x54535457; // "WTST"
+	static const uint16_t StateFileVersion		= 3;
+	static const uint32_t StateSystemVersion	= 2; // 2: mirroring, overflow cycles and DMC transfer
+	static const uint32_t StateSectionVersion	= 1; // Every other section
+
+	struct stateFileHeader_t
+	{
+		uint32_t	magic;
+		uint16_t	version;
+		uint16_t	headerSize;
+		uint32_t	sectionCount;
+		uint32_t	sectionOffset;
+		uint32_t	payloadOffset;
+		uint32_t	payloadSize;
+		uint32_t	payloadChecksum;
+		uint32_t	sectionEntrySize;	// Zero before version 3
+		uint64_t	romHash;
+		uint64_t	cycle;
+	};
+	static_assert( sizeof( stateFileHeader_t ) == 48, "State file header layout changed" );
+
+	struct stateFileSection_t
+	{
+		uint32_t	tag;
+		uint32_t	offset;
+		uint32_t	size;
+		uint32_t	version;
+	};
+	static_assert( sizeof( stateFileSection_t ) == 16, "State file section layout changed" );
+	static const uint32_t StateLegacySectionSize = 12;
+
+	enum stateSectionBits_t : uint32_t
+	{
+		STATE_SECTION_SYSTEM	= ( 1 << 0 ),
+		STATE_SECTION_MEMORY	= ( 1 << 1 ),
+		STATE_SECTION_CPU		= ( 1 << 2 ),
+		STATE_SECTION_PPU		= ( 1 << 3 ),
+		STATE_SECTION_APU		= ( 1 << 4 ),
+		STATE_SECTION_MAPPER	= ( 1 << 5 ),
+		STATE_SECTION_ALL		= 0xFFFFFFFF,
+	};
+
+	// Read-only view over a state file image; the bytes can come from a file read or a mapping
+	class wtStateFile
+	{
+	public:
+		wtStateFile();
+
+		bool						Parse( const uint8_t* data, const uint32_t sizeInBytes );
+		bool						IsValid() const;
+		const stateFileHeader_t&	GetHeader() const;
+		const uint8_t*				GetPayload() const;
+		uint32_t					GetPayloadSize() const;
+		bool						FindSection( const uint32_t tag, const uint8_t** outData, uint32_t* outSize, uint32_t* outVersion = nullptr ) const;
+		bool						FindSection( const char* name, const uint8_t** outData, uint32_t* outSize, uint32_t* outVersion = nullptr ) const;
+
+		static uint32_t				CurrentVersion( const uint32_t tag );
+		static void					Build( Serializer& serializer, const uint64_t romHash, const uint64_t cycle, std::vector<uint8_t>& outImage );
+
+	private:
+		stateFileSection_t			GetSection( const uint32_t sectionIx ) const;
+
+		const uint8_t*				image;
+		uint32_t					imageSize;
+		stateFileHeader_t			header;
+		const uint8_t*				sections;
+		uint32_t					sectionStride;
+	};
+};
@@ -0,0 +1,74 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Tomtendo
+{
+	// Scoped timeline events for chrome://tracing or Perfetto. Each thread writes
+	// complete events into its own ring, so recording takes no locks; Export()
+	// merges the rings into Chrome trace-event JSON. Rings keep the most recent
+	// EventsPerThread events, so a capture covers the last few seconds.
+	class wtTimeline
+	{
+	public:
+		static const uint32_t	EventsPerThread = ( 1 << 16 );
+
+		static void			Enable( const bool enable );
+		static bool			IsEnabled();
+		static void			SetThreadName( const char* name );
+		static uint64_t		NowNs();
+		static void			Record( const char* name, const uint64_t beginNs, const uint64_t endNs );
+		static void			Clear();
+		static bool			Export( const std::string& path );
+	};
+
+
+	class wtTimelineScope
+	{
+	public:
+		wtTimelineScope( const char* eventName ) : name( eventName ), beginNs( wtTimeline::IsEnabled() ? wtTimeline::NowNs() : 0 ) {}
+
+		~wtTimelineScope()
+		{
+			if ( beginNs != 0 ) {
+				wtTimeline::Record( name, beginNs, wtTimeline::NowNs() );
+			}
+		}
+
+		wtTimelineScope( const wtTimelineScope& ) = delete;
+		wtTimelineScope& operator=( const wtTimelineScope& ) = delete;
+
+	private:
+		const char*	name;		// Must outlive the export; string literals only
+		uint64_t	beginNs;
+	};
+};
+
+#define TIMELINE_CONCAT_( a, b )	a##b
+#define TIMELINE_CONCAT( a, b )		TIMELINE_CONCAT_( a, b )
+#define TIMELINE_SCOPE( name )		Tomtendo::wtTimelineScope TIMELINE_CONCAT( timelineScope_, __LINE__ )( name )
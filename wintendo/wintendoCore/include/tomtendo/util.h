@@ -23,10 +23,133 @@
 
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
 #include "assert.h"
 
 namespace Tomtendo
 {
+	static const uint32_t Fnv32Basis	= 0x811C9DC5u;
+	static const uint32_t Fnv32Prime	= 0x01000193u;
+	static const uint64_t Fnv64Basis	= 0xCBF29CE484222325ull;
+	static const uint64_t Fnv64Prime	= 0x00000100000001B3ull;
+
+	// FNV-1a, usable at compile time for tag names
+	static constexpr uint32_t HashString32( const char* str, const uint32_t hash = Fnv32Basis )
+	{
+		return ( *str == '\0' ) ? hash : HashString32( str + 1, ( hash ^ static_cast<uint8_t>( *str ) ) * Fnv32Prime );
+	}
+
+	static inline uint32_t Hash32( const void* data, const size_t sizeInBytes, uint32_t hash = Fnv32Basis )
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>( data );
+		for ( size_t i = 0; i < sizeInBytes; ++i ) {
+			hash = ( hash ^ bytes[ i ] ) * Fnv32Prime;
+		}
+		return hash;
+	}
+
+	static inline uint64_t Hash64( const void* data, const size_t sizeInBytes, uint64_t hash = Fnv64Basis )
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>( data );
+		for ( size_t i = 0; i < sizeInBytes; ++i ) {
+			hash = ( hash ^ bytes[ i ] ) * Fnv64Prime;
+		}
+		return hash;
+	}
+
+	static const uint64_t XxPrime1		= 0x9E3779B185EBCA87ull;
+	static const uint64_t XxPrime2		= 0xC2B2AE3D27D4EB4Full;
+	static const uint64_t XxPrime3		= 0x165667B19E3779F9ull;
+	static const uint64_t XxPrime4		= 0x85EBCA77C2B2AE63ull;
+	static const uint64_t XxPrime5		= 0x27D4EB2F165667C5ull;
+
+	static inline uint64_t Rotl64( const uint64_t x, const uint32_t r )
+	{
+		return ( x << r ) | ( x >> ( 64 - r ) );
+	}
+
+	static inline uint64_t XxRound( uint64_t acc, const uint64_t input )
+	{
+		acc += input * XxPrime2;
+		return Rotl64( acc, 31 ) * XxPrime1;
+	}
+
+	static inline uint64_t XxMerge( uint64_t acc, const uint64_t value )
+	{
+		acc ^= XxRound( 0, value );
+		return acc * XxPrime1 + XxPrime4;
+	}
+
+	// xxHash64. Four independent lanes over 32-byte blocks, several times the throughput
+	// of the byte-wise Hash64 above; used where whole frames are hashed every frame.
+	static inline uint64_t FastHash64( const void* data, const size_t sizeInBytes, const uint64_t seed = 0 )
+	{
+		const uint8_t* p = static_cast<const uint8_t*>( data );
+		const uint8_t* const end = p + sizeInBytes;
+
+		auto Read64 = []( const uint8_t* ptr ) { uint64_t v; memcpy( &v, ptr, sizeof( v ) ); return v; };
+		auto Read32 = []( const uint8_t* ptr ) { uint32_t v; memcpy( &v, ptr, sizeof( v ) ); return v; };
+
+		uint64_t h;
+		if ( sizeInBytes >= 32 )
+		{
+			uint64_t v1 = seed + XxPrime1 + XxPrime2;
+			uint64_t v2 = seed + XxPrime2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - XxPrime1;
+
+			const uint8_t* const limit = end - 32;
+			do
+			{
+				v1 = XxRound( v1, Read64( p ) );
+				v2 = XxRound( v2, Read64( p + 8 ) );
+				v3 = XxRound( v3, Read64( p + 16 ) );
+				v4 = XxRound( v4, Read64( p + 24 ) );
+				p += 32;
+			} while ( p <= limit );
+
+			h = Rotl64( v1, 1 ) + Rotl64( v2, 7 ) + Rotl64( v3, 12 ) + Rotl64( v4, 18 );
+			h = XxMerge( h, v1 );
+			h = XxMerge( h, v2 );
+			h = XxMerge( h, v3 );
+			h = XxMerge( h, v4 );
+		}
+		else
+		{
+			h = seed + XxPrime5;
+		}
+
+		h += static_cast<uint64_t>( sizeInBytes );
+
+		for ( ; ( p + 8 ) <= end; p += 8 )
+		{
+			h ^= XxRound( 0, Read64( p ) );
+			h = Rotl64( h, 27 ) * XxPrime1 + XxPrime4;
+		}
+
+		if ( ( p + 4 ) <= end )
+		{
+			h ^= static_cast<uint64_t>( Read32( p ) ) * XxPrime1;
+			h = Rotl64( h, 23 ) * XxPrime2 + XxPrime3;
+			p += 4;
+		}
+
+		for ( ; p < end; ++p )
+		{
+			h ^= ( *p ) * XxPrime5;
+			h = Rotl64( h, 11 ) * XxPrime1;
+		}
+
+		h ^= h >> 33;
+		h *= XxPrime2;
+		h ^= h >> 29;
+		h *= XxPrime3;
+		h ^= h >> 32;
+		return h;
+	}
+
 	template < uint16_t B >
 	class BitCounter
 	{
@@ -130,7 +253,7 @@ namespace Tomtendo
 
 		static const uint32_t Mask = CalcMask();
 		static const uint32_t LMask = ( Mask >> 1 );
-		static const uint32_t RMask = ~0x01ul;
+		static const uint32_t RMask = ~0x01u;
 	};
 
 
@@ -285,4 +408,62 @@ namespace Tomtendo
 		int32_t	begin;
 		int32_t	end;
 	};
+
+
+	// Bounded single-producer/single-consumer ring. Slots are written and read in place
+	// so large payloads (frames, audio blocks) never get copied through the queue itself.
+	template< typename T, uint32_t SIZE >
+	class wtSpscQueue
+	{
+		static_assert( ( SIZE & ( SIZE - 1 ) ) == 0, "Queue size must be a power of two" );
+	public:
+		wtSpscQueue()
+		{
+			Reset();
+		}
+
+		T* BeginWrite()
+		{
+			const uint32_t w = writeIx.load( std::memory_order_relaxed );
+			if ( ( w - readIx.load( std::memory_order_acquire ) ) >= SIZE ) {
+				return nullptr;
+			}
+			return &slots[ w % SIZE ];
+		}
+
+		void EndWrite()
+		{
+			writeIx.store( writeIx.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+		}
+
+		T* BeginRead()
+		{
+			const uint32_t r = readIx.load( std::memory_order_relaxed );
+			if ( r == writeIx.load( std::memory_order_acquire ) ) {
+				return nullptr;
+			}
+			return &slots[ r % SIZE ];
+		}
+
+		void EndRead()
+		{
+			readIx.store( readIx.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+		}
+
+		bool IsEmpty() const
+		{
+			return ( readIx.load( std::memory_order_acquire ) == writeIx.load( std::memory_order_acquire ) );
+		}
+
+		void Reset()
+		{
+			readIx.store( 0 );
+			writeIx.store( 0 );
+		}
+
+	private:
+		T						slots[ SIZE ];
+		std::atomic<uint32_t>	readIx;
+		std::atomic<uint32_t>	writeIx;
+	};
 };
\ No newline at end of file
@@ -0,0 +1,123 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "interface.h"
+
+namespace Tomtendo
+{
+	struct vecEnvConfig_t
+	{
+		uint32_t	envCount;
+		uint32_t	frameSkip;	// Frames emulated per step, the action is held for all of them
+		bool		maxPool;	// Per-pixel max of the last two frames, hides sprite flicker
+		bool		grayscale;	// One luma byte per pixel instead of RGB
+		uint32_t	downsample;	// 1, 2 or 4, box filtered
+		uint32_t	ramBytes;	// Leading bytes of work RAM copied out per step, up to 2KB
+		uint32_t	noopMax;	// Reset idles seed % ( noopMax + 1 ) extra frames so episodes start apart
+		uint32_t	threads;	// 0 for one per core, the calling thread is one of them
+	};
+
+	vecEnvConfig_t DefaultVecEnvConfig();
+
+	// Steps N copies of one ROM in lockstep for batched agents. Every machine forks from a stopped
+	// power-on root, observations and RAM go straight into caller buffers laid out env after env,
+	// and once Init returns neither Reset nor Step allocates.
+	class wtVecEnv
+	{
+	public:
+		static const uint32_t FrameWidth	= 256;
+		static const uint32_t FrameHeight	= 240;
+
+		wtVecEnv();
+		~wtVecEnv();
+
+		wtVecEnv( const wtVecEnv& ) = delete;
+		wtVecEnv& operator=( const wtVecEnv& ) = delete;
+
+		int			Init( const uint8_t* romData, const uint32_t romSize, const vecEnvConfig_t& vecConfig ); // Buffer must outlive the environment
+		void		Shutdown();
+
+		uint32_t	GetEnvCount() const;
+		uint32_t	GetObservationWidth() const;
+		uint32_t	GetObservationHeight() const;
+		uint32_t	GetObservationChannels() const;
+		uint32_t	GetObservationSize() const; // Bytes per env, rows of width * channels
+		uint32_t	GetRamSize() const;
+
+		// 'observations' holds GetEnvCount() * GetObservationSize() bytes and 'ram' GetEnvCount() * GetRamSize(), or is null.
+		// With a mask only envs with a non-zero entry reset, the rest keep their state and their slots are left alone.
+		void		Reset( const uint32_t* seeds, const uint8_t* mask, uint8_t* observations, uint8_t* ram );
+		void		Step( const ButtonFlags* actions, uint8_t* observations, uint8_t* ram ); // One pad 0 state per env
+
+	private:
+		enum class job_t : uint8_t
+		{
+			RESET,
+			STEP,
+		};
+
+		void		Dispatch( const job_t nextJob );
+		void		WorkerThread();
+		void		RunShare();
+		void		RunEnv( const uint32_t envIx );
+		void		WriteObservation( const wtSystem& system, uint8_t* out ) const;
+
+		vecEnvConfig_t				config;
+		config_t					sysConfig;
+		wtSystem*					root;
+		std::vector<wtSystem*>		systems;
+		std::vector<Input>			inputs;
+		uint32_t					renderFrames;
+		uint32_t					obsWidth;
+		uint32_t					obsHeight;
+		uint32_t					obsChannels;
+		uint32_t					ramSize;
+
+		// Arguments of the job in flight, published to the workers under 'lock'
+		job_t						job;
+		const uint32_t*				jobSeeds;
+		const uint8_t*				jobMask;
+		const ButtonFlags*			jobActions;
+		uint8_t*					jobObservations;
+		uint8_t*					jobRam;
+
+		std::vector<std::thread>	workers;
+		std::mutex					lock;
+		std::condition_variable		wake;
+		std::condition_variable		done;
+		uint64_t					generation;
+		uint32_t					pending;
+		bool						running;
+		std::atomic<uint32_t>		nextEnv;
+	};
+};
@@ -0,0 +1,109 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include <cstring>
+#include "breakpoint.h"
+
+wtBreakpoints::wtBreakpoints()
+{
+	Clear();
+}
+
+
+void wtBreakpoints::Set( const breakpointSpace_t space, const uint8_t typeMask, const uint16_t address, const bool enable )
+{
+	const breakpointType_t types[] = { BREAK_EXEC, BREAK_READ, BREAK_WRITE };
+	for ( const breakpointType_t type : types )
+	{
+		if ( ( typeMask & type ) == 0 ) {
+			continue;
+		}
+
+		uint64_t& word = bitmaps[ MapIndex( space, type ) ][ address >> 6 ];
+		const uint64_t bit = ( 1ull << ( address & 63 ) );
+		const bool wasSet = ( word & bit ) != 0;
+		if ( enable && !wasSet )
+		{
+			word |= bit;
+			++armedCount;
+		}
+		else if ( !enable && wasSet )
+		{
+			word &= ~bit;
+			--armedCount;
+		}
+	}
+}
+
+
+void wtBreakpoints::Clear()
+{
+	memset( bitmaps, 0, sizeof( bitmaps ) );
+	memset( &hit, 0, sizeof( hit ) );
+	armedCount = 0;
+	hasHit = false;
+	resuming = false;
+}
+
+
+bool wtBreakpoints::IsArmed() const
+{
+	return ( armedCount > 0 );
+}
+
+
+bool wtBreakpoints::HasHit() const
+{
+	return hasHit;
+}
+
+
+const breakpointHit_t& wtBreakpoints::GetHit() const
+{
+	return hit;
+}
+
+
+void wtBreakpoints::Resume()
+{
+	resuming = hasHit && ( hit.type == BREAK_EXEC );
+	hasHit = false;
+}
+
+
+void wtBreakpoints::Hit( const breakpointSpace_t space, const breakpointType_t type, const uint16_t address, const uint16_t pc, const uint64_t cpuCycle, const uint64_t frameNumber )
+{
+	// Keep the first access of an instruction that touches several armed addresses
+	if ( hasHit ) {
+		return;
+	}
+
+	hit.cpuCycle	= cpuCycle;
+	hit.frameNumber	= frameNumber;
+	hit.address		= address;
+	hit.pc			= pc;
+	hit.type		= type;
+	hit.space		= space;
+	hasHit			= true;
+}
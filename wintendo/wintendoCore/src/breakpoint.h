@@ -0,0 +1,75 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include "common.h"
+
+// Execution, read and write breakpoints over the 64K CPU and PPU address spaces.
+// Each kind of access has its own bitmap so a check is one shift and mask.
+class wtBreakpoints
+{
+public:
+	static const uint32_t	AddressCount	= 0x10000;
+	static const uint32_t	WordCount		= AddressCount / 64;
+	static const uint32_t	MapCount		= 6; // { CPU, PPU } x { EXEC, READ, WRITE }
+
+	wtBreakpoints();
+
+	void					Set( const breakpointSpace_t space, const uint8_t typeMask, const uint16_t address, const bool enable );
+	void					Clear();
+	bool					IsArmed() const;
+	bool					HasHit() const;
+	const breakpointHit_t&	GetHit() const;
+	void					Resume();
+	void					Hit( const breakpointSpace_t space, const breakpointType_t type, const uint16_t address, const uint16_t pc, const uint64_t cpuCycle, const uint64_t frameNumber );
+
+	FORCE_INLINE bool Test( const breakpointSpace_t space, const breakpointType_t type, const uint16_t address ) const
+	{
+		const uint64_t* bits = bitmaps[ MapIndex( space, type ) ];
+		return ( ( bits[ address >> 6 ] >> ( address & 63 ) ) & 1 ) != 0;
+	}
+
+	// The instruction a resume starts on ran into its own execution breakpoint; let it through once
+	FORCE_INLINE bool ConsumeResume()
+	{
+		const bool skip = resuming;
+		resuming = false;
+		return skip;
+	}
+
+private:
+	FORCE_INLINE static uint32_t MapIndex( const breakpointSpace_t space, const breakpointType_t type )
+	{
+		const uint32_t typeIx = ( type == BREAK_EXEC ) ? 0 : ( ( type == BREAK_READ ) ? 1 : 2 );
+		return 3 * static_cast<uint32_t>( space ) + typeIx;
+	}
+
+	uint64_t				bitmaps[ MapCount ][ WordCount ];
+	uint32_t				armedCount;
+	breakpointHit_t			hit;
+	bool					hasHit;
+	bool					resuming;
+};
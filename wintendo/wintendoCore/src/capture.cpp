@@ -0,0 +1,399 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "../include/tomtendo/capture.h"
+#include "../include/tomtendo/interface.h"
+#include "assert.h"
+#include <cstring>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace Tomtendo
+{
+	// NTSC frames average 89341.5 PPU dots once the odd-frame skipped dot is accounted for
+	static const uint64_t Y4mRateNum = 2 * MasterClockHz;
+	static const uint64_t Y4mRateDen = PpuClockDivide * ( 2 * PpuCyclesPerScanline * 262 - 1 );
+
+	static FILE* OpenStream( const std::string& path )
+	{
+		if ( path.empty() ) {
+			return nullptr;
+		}
+
+		if ( path == "-" )
+		{
+#ifdef _WIN32
+			_setmode( _fileno( stdout ), _O_BINARY );
+#endif
+			return stdout;
+		}
+		return fopen( path.c_str(), "wb" );
+	}
+
+
+	static void CloseStream( FILE* file )
+	{
+		if ( file == nullptr ) {
+			return;
+		}
+
+		if ( file == stdout ) {
+			fflush( file );
+		} else {
+			fclose( file );
+		}
+	}
+
+
+	static void Write16( uint8_t*& dest, const uint16_t value )
+	{
+		*dest++ = static_cast<uint8_t>( value & 0xFF );
+		*dest++ = static_cast<uint8_t>( ( value >> 8 ) & 0xFF );
+	}
+
+
+	static void Write32( uint8_t*& dest, const uint32_t value )
+	{
+		Write16( dest, static_cast<uint16_t>( value & 0xFFFF ) );
+		Write16( dest, static_cast<uint16_t>( ( value >> 16 ) & 0xFFFF ) );
+	}
+
+
+	captureConfig_t DefaultCaptureConfig()
+	{
+		captureConfig_t config;
+		config.format			= captureFormat_t::Y4M_WAV;
+		config.audioSampleRate	= 48000;
+		config.dropOnOverflow	= false;
+		return config;
+	}
+
+
+	wtCapture::wtCapture()
+	{
+		running			= false;
+		droppedBlocks	= 0;
+		videoFile		= nullptr;
+		audioFile		= nullptr;
+		lastFrame		= 0;
+		frameCount		= 0;
+		sampleCount		= 0;
+		resamplePhase	= 0.0;
+		resampleAcc		= 0.0;
+		resampleTaps	= 0;
+	}
+
+
+	wtCapture::~wtCapture()
+	{
+		Close();
+	}
+
+
+	bool wtCapture::Open( const captureConfig_t& captureConfig )
+	{
+		Close();
+
+		config = captureConfig;
+		if ( config.audioSampleRate == 0 ) {
+			config.audioSampleRate = 48000;
+		}
+
+		videoFile = OpenStream( config.videoPath );
+		audioFile = OpenStream( config.audioPath );
+
+		const bool videoFailed = !config.videoPath.empty() && ( videoFile == nullptr );
+		const bool audioFailed = !config.audioPath.empty() && ( audioFile == nullptr );
+		if ( videoFailed || audioFailed || ( ( videoFile == nullptr ) && ( audioFile == nullptr ) ) )
+		{
+			CloseStream( videoFile );
+			CloseStream( audioFile );
+			videoFile = nullptr;
+			audioFile = nullptr;
+			return false;
+		}
+
+		if ( queue == nullptr ) {
+			queue.reset( new blockQueue_t() );
+		}
+		queue->Reset();
+
+		if ( ( videoFile != nullptr ) && ( config.format == captureFormat_t::Y4M_WAV ) )
+		{
+			yuv.reset( new uint8_t[ FrameWidth * FrameHeight * 3 / 2 ] );
+			fprintf( videoFile, "YUV4MPEG2 W%u H%u F%llu:%llu Ip A1:1 C420jpeg\n", FrameWidth, FrameHeight,
+				static_cast<unsigned long long>( Y4mRateNum ), static_cast<unsigned long long>( Y4mRateDen ) );
+		}
+
+		if ( ( audioFile != nullptr ) && ( config.format == captureFormat_t::Y4M_WAV ) ) {
+			WriteWavHeader( 0xFFFFFFFF - 36 ); // Patched on close when the stream is seekable
+		}
+
+		lastFrame		= ~0ull;
+		frameCount		= 0;
+		sampleCount		= 0;
+		droppedBlocks	= 0;
+		resamplePhase	= 0.0;
+		resampleAcc		= 0.0;
+		resampleTaps	= 0;
+
+		running = true;
+		writer = std::thread( &wtCapture::WriterThread, this );
+		return true;
+	}
+
+
+	void wtCapture::Close()
+	{
+		if ( !IsOpen() ) {
+			return;
+		}
+
+		running = false;
+		writer.join();
+
+		if ( ( audioFile != nullptr ) && ( config.format == captureFormat_t::Y4M_WAV ) && ( audioFile != stdout ) )
+		{
+			const uint64_t dataBytes = sampleCount * sizeof( int16_t );
+			if ( ( dataBytes <= ( 0xFFFFFFFF - 36 ) ) && ( fseek( audioFile, 0, SEEK_SET ) == 0 ) ) {
+				WriteWavHeader( static_cast<uint32_t>( dataBytes ) );
+			}
+		}
+
+		CloseStream( videoFile );
+		CloseStream( audioFile );
+		videoFile = nullptr;
+		audioFile = nullptr;
+		yuv.reset();
+	}
+
+
+	bool wtCapture::IsOpen() const
+	{
+		return writer.joinable();
+	}
+
+
+	uint64_t wtCapture::GetFrameCount() const
+	{
+		return frameCount;
+	}
+
+
+	uint64_t wtCapture::GetSampleCount() const
+	{
+		return sampleCount;
+	}
+
+
+	uint64_t wtCapture::GetDroppedCount() const
+	{
+		return droppedBlocks;
+	}
+
+
+	wtCapture::block_t* wtCapture::AcquireBlock()
+	{
+		while ( true )
+		{
+			block_t* block = queue->BeginWrite();
+			if ( block != nullptr )
+			{
+				block->videoFrames = 0;
+				block->sampleCnt = 0;
+				return block;
+			}
+
+			if ( config.dropOnOverflow )
+			{
+				++droppedBlocks;
+				return nullptr;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+
+	void wtCapture::Submit( const wtFrameResult& frameResult )
+	{
+		if ( !IsOpen() ) {
+			return;
+		}
+
+		block_t* block = AcquireBlock();
+
+		if ( ( videoFile != nullptr ) && ( frameResult.frameBuffer != nullptr ) && ( frameResult.currentFrame != lastFrame ) )
+		{
+			if ( block != nullptr )
+			{
+				assert( frameResult.frameBuffer->GetBufferLength() == ( FrameWidth * FrameHeight ) );
+				const uint64_t elapsed = ( lastFrame == ~0ull ) ? 1 : ( frameResult.currentFrame - lastFrame );
+				memcpy( block->pixels, frameResult.frameBuffer->GetRawBuffer(), sizeof( block->pixels ) );
+				block->videoFrames = static_cast<uint32_t>( elapsed );
+				frameCount += elapsed;
+			}
+			lastFrame = frameResult.currentFrame;
+		}
+
+		if ( ( audioFile != nullptr ) && ( frameResult.soundOutput != nullptr ) )
+		{
+			const wtSampleQueue& mixed = frameResult.soundOutput->mixed;
+			const double step = ApuSamplesPerSec / static_cast<double>( config.audioSampleRate );
+			const uint32_t sampleCnt = mixed.GetSampleCnt();
+
+			for ( uint32_t i = 0; i < sampleCnt; ++i )
+			{
+				resampleAcc += mixed.Peek( i );
+				++resampleTaps;
+				resamplePhase += 1.0;
+				if ( resamplePhase < step ) {
+					continue;
+				}
+				resamplePhase -= step;
+
+				const double sample = std::min( 32767.0, std::max( -32768.0, resampleAcc / resampleTaps ) );
+				resampleAcc = 0.0;
+				resampleTaps = 0;
+
+				if ( block == nullptr ) {
+					continue;
+				}
+
+				block->samples[ block->sampleCnt++ ] = static_cast<int16_t>( sample );
+				++sampleCount;
+
+				if ( block->sampleCnt == MaxBlockSamples )
+				{
+					queue->EndWrite();
+					block = AcquireBlock();
+				}
+			}
+		}
+
+		if ( block != nullptr ) {
+			queue->EndWrite();
+		}
+	}
+
+
+	void wtCapture::WriterThread()
+	{
+		while ( running || !queue->IsEmpty() )
+		{
+			block_t* block = queue->BeginRead();
+			if ( block == nullptr )
+			{
+				std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+				continue;
+			}
+
+			WriteBlock( *block );
+			queue->EndRead();
+		}
+	}
+
+
+	void wtCapture::WriteBlock( const block_t& block )
+	{
+		for ( uint32_t i = 0; i < block.videoFrames; ++i )
+		{
+			if ( config.format == captureFormat_t::Y4M_WAV ) {
+				WriteY4mFrame( block.pixels, ( i == 0 ) );
+			} else {
+				fwrite( block.pixels, sizeof( block.pixels[ 0 ] ), FrameWidth * FrameHeight, videoFile );
+			}
+		}
+
+		if ( block.sampleCnt > 0 ) {
+			fwrite( block.samples, sizeof( block.samples[ 0 ] ), block.sampleCnt, audioFile );
+		}
+	}
+
+
+	void wtCapture::WriteY4mFrame( const uint32_t* pixels, const bool convert )
+	{
+		// BT.601 limited range, chroma averaged over each 2x2 quad
+		uint8_t* yPlane = yuv.get();
+		uint8_t* uPlane = yPlane + FrameWidth * FrameHeight;
+		uint8_t* vPlane = uPlane + ( FrameWidth / 2 ) * ( FrameHeight / 2 );
+
+		for ( uint32_t y = 0; convert && ( y < FrameHeight ); y += 2 )
+		{
+			for ( uint32_t x = 0; x < FrameWidth; x += 2 )
+			{
+				int32_t sumU = 0;
+				int32_t sumV = 0;
+				for ( uint32_t i = 0; i < 4; ++i )
+				{
+					const uint32_t index = ( x + ( i & 1 ) ) + ( y + ( i >> 1 ) ) * FrameWidth;
+					const uint32_t abgr = pixels[ index ];
+					const int32_t r = static_cast<int32_t>( abgr & 0xFF );
+					const int32_t g = static_cast<int32_t>( ( abgr >> 8 ) & 0xFF );
+					const int32_t b = static_cast<int32_t>( ( abgr >> 16 ) & 0xFF );
+
+					yPlane[ index ] = static_cast<uint8_t>( ( ( 66 * r + 129 * g + 25 * b + 128 ) >> 8 ) + 16 );
+					sumU += ( -38 * r - 74 * g + 112 * b + 128 ) >> 8;
+					sumV += ( 112 * r - 94 * g - 18 * b + 128 ) >> 8;
+				}
+
+				const uint32_t chromaIx = ( x / 2 ) + ( y / 2 ) * ( FrameWidth / 2 );
+				uPlane[ chromaIx ] = static_cast<uint8_t>( ( sumU / 4 ) + 128 );
+				vPlane[ chromaIx ] = static_cast<uint8_t>( ( sumV / 4 ) + 128 );
+			}
+		}
+
+		fputs( "FRAME\n", videoFile );
+		fwrite( yuv.get(), 1, FrameWidth * FrameHeight * 3 / 2, videoFile );
+	}
+
+
+	void wtCapture::WriteWavHeader( const uint32_t dataBytes )
+	{
+		static const uint16_t Channels = 1;
+		static const uint16_t BitsPerSample = 16;
+
+		uint8_t header[ 44 ];
+		uint8_t* dest = header;
+
+		memcpy( dest, "RIFF", 4 );
+		dest += 4;
+		Write32( dest, 36 + dataBytes );
+		memcpy( dest, "WAVEfmt ", 8 );
+		dest += 8;
+		Write32( dest, 16 );
+		Write16( dest, 1 ); // PCM
+		Write16( dest, Channels );
+		Write32( dest, config.audioSampleRate );
+		Write32( dest, config.audioSampleRate * Channels * ( BitsPerSample / 8 ) );
+		Write16( dest, Channels * ( BitsPerSample / 8 ) );
+		Write16( dest, BitsPerSample );
+		memcpy( dest, "data", 4 );
+		dest += 4;
+		Write32( dest, dataBytes );
+
+		fwrite( header, 1, sizeof( header ), audioFile );
+	}
+};
@@ -0,0 +1,140 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <cstring>
+#include "cdl.h"
+
+using namespace std;
+
+wtCdl::wtCdl()
+{
+	prgSize = 0;
+	chrSize = 0;
+	logging = false;
+	paused = false;
+}
+
+
+void wtCdl::Start( const uint32_t prgRomSize, const uint32_t chrRomSize )
+{
+	// Keep what's already been gathered for this cart so sessions accumulate
+	if ( ( prgRomSize != prgSize ) || ( chrRomSize != chrSize ) )
+	{
+		prgSize = prgRomSize;
+		chrSize = chrRomSize;
+		flagMap.assign( prgSize + chrSize, 0 );
+		bankCodeBytes.assign( ( prgSize + CodeBankSize - 1 ) / CodeBankSize, 0 );
+	}
+	logging = true;
+	paused = false;
+}
+
+
+void wtCdl::Stop()
+{
+	logging = false;
+}
+
+
+void wtCdl::SetPaused( const bool pause )
+{
+	paused = pause;
+}
+
+
+bool wtCdl::IsLogging() const
+{
+	return logging && !paused;
+}
+
+
+bool wtCdl::HasCode() const
+{
+	for ( const uint32_t count : bankCodeBytes )
+	{
+		if ( count != 0 ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+uint32_t wtCdl::GetBankCodeBytes( const uint32_t romOffset ) const
+{
+	const uint32_t bank = romOffset / CodeBankSize;
+	return ( bank < bankCodeBytes.size() ) ? bankCodeBytes[ bank ] : 0;
+}
+
+
+void wtCdl::CountBankCode()
+{
+	bankCodeBytes.assign( bankCodeBytes.size(), 0 );
+	for ( uint32_t i = 0; i < prgSize; ++i ) {
+		bankCodeBytes[ i / CodeBankSize ] += ( ( flagMap[ i ] & CDL_PRG_CODE ) != 0 ) ? 1 : 0;
+	}
+}
+
+
+bool wtCdl::Load( const std::vector<uint8_t>& file )
+{
+	if ( file.size() != flagMap.size() ) {
+		return false;
+	}
+
+	for ( size_t i = 0; i < file.size(); ++i ) {
+		flagMap[ i ] |= file[ i ];
+	}
+	CountBankCode();
+	return true;
+}
+
+
+void wtCdl::Save( std::vector<uint8_t>& file ) const
+{
+	file = flagMap;
+}
+
+
+void wtCdl::GetStats( cdlStats_t& stats ) const
+{
+	memset( &stats, 0, sizeof( stats ) );
+	stats.prgSize = prgSize;
+	stats.chrSize = chrSize;
+
+	for ( uint32_t i = 0; i < prgSize; ++i )
+	{
+		const uint8_t flags = flagMap[ i ];
+		stats.prgCode += ( flags & CDL_PRG_CODE ) ? 1 : 0;
+		stats.prgData += ( flags & ( CDL_PRG_DATA | CDL_PRG_PCM ) ) ? 1 : 0;
+		stats.prgUnused += ( ( flags & ( CDL_PRG_CODE | CDL_PRG_DATA | CDL_PRG_PCM ) ) == 0 ) ? 1 : 0;
+	}
+
+	for ( uint32_t i = 0; i < chrSize; ++i )
+	{
+		const uint8_t flags = flagMap[ prgSize + i ];
+		stats.chrRendered += ( flags & CDL_CHR_RENDERED ) ? 1 : 0;
+		stats.chrRead += ( flags & CDL_CHR_READ ) ? 1 : 0;
+		stats.chrUnused += ( flags == 0 ) ? 1 : 0;
+	}
+}
@@ -0,0 +1,106 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "common.h"
+
+// Flag layout matches the .cdl files other NES debuggers read and write
+enum cdlPrgBits_t : uint8_t
+{
+	CDL_PRG_CODE			= ( 1 << 0 ),
+	CDL_PRG_DATA			= ( 1 << 1 ),
+	CDL_PRG_BANK_SHIFT		= 2,		// 2 bits: which 8K CPU window ($8000-$E000) the byte was seen through
+	CDL_PRG_INDIRECT_CODE	= ( 1 << 4 ),
+	CDL_PRG_INDIRECT_DATA	= ( 1 << 5 ),
+	CDL_PRG_PCM				= ( 1 << 6 ),
+};
+
+enum cdlChrBits_t : uint8_t
+{
+	CDL_CHR_RENDERED		= ( 1 << 0 ),
+	CDL_CHR_READ			= ( 1 << 1 ),
+};
+
+// Code/Data Logger: one flag byte per PRG and CHR ROM byte, laid out
+// PRG first then CHR just like the file. Marking is a single OR.
+class wtCdl
+{
+public:
+	wtCdl();
+
+	void					Start( const uint32_t prgRomSize, const uint32_t chrRomSize );
+	void					Stop();
+	void					SetPaused( const bool pause );
+	bool					IsLogging() const;
+	bool					HasCode() const;
+	bool					Load( const std::vector<uint8_t>& file );
+	void					Save( std::vector<uint8_t>& file ) const;
+	void					GetStats( cdlStats_t& stats ) const;
+
+	FORCE_INLINE static uint8_t BankBits( const uint16_t address )
+	{
+		return static_cast<uint8_t>( ( ( address >> 13 ) & 0x03 ) << CDL_PRG_BANK_SHIFT );
+	}
+
+	FORCE_INLINE void MarkPrg( const uint32_t romOffset, const uint8_t flags )
+	{
+		if ( romOffset < prgSize )
+		{
+			uint8_t& entry = flagMap[ romOffset ];
+			if ( ( flags & ~entry & CDL_PRG_CODE ) != 0 ) {
+				++bankCodeBytes[ romOffset / CodeBankSize ];
+			}
+			entry |= flags;
+		}
+	}
+
+	FORCE_INLINE void MarkChr( const uint32_t romOffset, const uint8_t flags )
+	{
+		if ( romOffset < chrSize ) {
+			flagMap[ prgSize + romOffset ] |= flags;
+		}
+	}
+
+	FORCE_INLINE uint8_t GetPrg( const uint32_t romOffset ) const
+	{
+		return ( romOffset < prgSize ) ? flagMap[ romOffset ] : 0;
+	}
+
+	// Bytes marked as code in the 16K PRG bank holding 'romOffset'
+	uint32_t				GetBankCodeBytes( const uint32_t romOffset ) const;
+
+private:
+	static const uint32_t	CodeBankSize = 0x4000;
+
+	void					CountBankCode();
+
+	std::vector<uint8_t>	flagMap;
+	std::vector<uint32_t>	bankCodeBytes;	// Kept current by MarkPrg so listings can check coverage without a scan
+	uint32_t				prgSize;
+	uint32_t				chrSize;
+	bool					logging;
+	bool					paused;
+};
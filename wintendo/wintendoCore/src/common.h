@@ -37,20 +37,35 @@ using namespace Tomtendo;
 #define DEBUG_MODE			(0)
 #define DEBUG_ADDR			(1)
 #define MIRROR_OPTIMIZATION	(1)
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS		(0) // TSC laps around every CPU step and mapper call; build with -DPERF_COUNTERS=1 to profile
+#endif
 
 const uint32_t KB_1		= 1024;
 const uint32_t MB_1		= 1024 * KB_1;
 
+const uint32_t InvalidRomOffset = ~0u; // CPU address isn't backed by PRG ROM
+
 #define KB(n) ( n * KB_1 )
 #define BIT_MASK(n)	( 1 << n )
 #define SELECT_BIT( word, bit ) ( (word) & (BIT_MASK_##bit) ) >> (BIT_##bit)
 
-#ifdef _MSC_BUILD
+#if defined( _MSC_VER )
 #define FORCE_INLINE __forceinline
+#elif defined( __GNUC__ ) || defined( __clang__ )
+#define FORCE_INLINE inline __attribute__( ( always_inline ) )
 #else
 #define FORCE_INLINE inline
 #endif
 
+#if defined( _MSC_VER )
+#define NO_INLINE __declspec( noinline )
+#elif defined( __GNUC__ ) || defined( __clang__ )
+#define NO_INLINE __attribute__( ( noinline ) )
+#else
+#define NO_INLINE
+#endif
+
 #define DEFINE_ENUM_OPERATORS( enumType, intType )														\
 																										\
 inline intType operator&( enumType lhs, enumType rhs )													\
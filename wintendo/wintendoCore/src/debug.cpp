@@ -25,219 +25,324 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <atomic>
 #include "debug.h"
 #include "processors/mos6502.h"
 
 using namespace std;
 
-static void PrintHex( std::stringstream& debugStream, const uint32_t value, const uint32_t charCount, const bool markup )
+static const char HexDigits[] = "0123456789ABCDEF";
+
+// Hand-rolled writers; trace logs run to millions of lines so iostreams are avoided.
+static inline char* WriteHex( char* out, const uint32_t value, const uint32_t minDigits, const bool markup )
 {
-	std::ios_base::fmtflags flags = debugStream.flags();
 	if( markup ) {
-		debugStream << "$";
+		*out++ = '$';
+	}
+
+	uint32_t digits = 1;
+	while ( ( digits < 8 ) && ( ( value >> ( 4 * digits ) ) != 0 ) ) {
+		++digits;
 	}
-	debugStream << setfill( '0' ) << setw( charCount ) << uppercase << hex << right << value << left;
-	debugStream.setf( flags );
+	digits = ( digits < minDigits ) ? minDigits : digits;
+
+	for ( int32_t i = digits - 1; i >= 0; --i ) {
+		*out++ = HexDigits[ ( value >> ( 4 * i ) ) & 0xF ];
+	}
+	return out;
 }
 
 
-static std::string GetOpName( const Tomtendo::OpDebugInfo& info )
+static inline char* WriteDec( char* out, uint64_t value, const uint32_t width )
 {
-	std::string name;
-	if( info.isIllegal ) {
-		name += "*";
-	} else {
-		name += " ";
+	char digits[ 20 ];
+	uint32_t count = 0;
+	do
+	{
+		digits[ count++ ] = static_cast<char>( '0' + ( value % 10 ) );
+		value /= 10;
+	} while ( value != 0 );
+
+	for ( uint32_t i = count; i < width; ++i ) {
+		*out++ = ' ';
 	}
+	while ( count > 0 ) {
+		*out++ = digits[ --count ];
+	}
+	return out;
+}
 
-	if( ( info.opType == (uint8_t)opType_t::SKB ) || ( info.opType == (uint8_t)opType_t::SKW ) )
-	{
-		name += "NOP";
+
+static inline char* WriteSignedDec( char* out, const int64_t value, const uint32_t width )
+{
+	if ( value >= 0 ) {
+		return WriteDec( out, static_cast<uint64_t>( value ), width );
 	}
-	else
-	{
-		name += info.mnemonic[ 0 ];
-		name += info.mnemonic[ 1 ];
-		name += info.mnemonic[ 2 ];
+
+	char digits[ 24 ];
+	char* end = WriteDec( digits, static_cast<uint64_t>( -value ), 0 );
+	const uint32_t count = static_cast<uint32_t>( end - digits ) + 1;
+	for ( uint32_t i = count; i < width; ++i ) {
+		*out++ = ' ';
 	}
-	return name;
+	*out++ = '-';
+	memcpy( out, digits, count - 1 );
+	return out + count - 1;
 }
 
-namespace Tomtendo
+
+static inline char* WriteText( char* out, const char* text )
 {
-	void OpDebugInfo::ToString( std::string& buffer, const bool registerDebug, const bool cycleDebug ) const
+	while ( *text != '\0' ) {
+		*out++ = *text++;
+	}
+	return out;
+}
+
+
+static char* WriteOpName( char* out, const Tomtendo::OpDebugInfo& info )
+{
+	*out++ = info.isIllegal ? '*' : ' ';
+
+	if( ( info.opType == (uint8_t)opType_t::SKB ) || ( info.opType == (uint8_t)opType_t::SKW ) ) {
+		return WriteText( out, "NOP" );
+	}
+
+	*out++ = info.mnemonic[ 0 ];
+	*out++ = info.mnemonic[ 1 ];
+	*out++ = info.mnemonic[ 2 ];
+	return out;
+}
+
+
+// Writes one trace line without a terminator and returns the end of it
+static char* FormatLine( char* out, const Tomtendo::OpDebugInfo& info, const bool registerDebug, const bool cycleDebug )
+{
+	if( info.nmi || info.irq )
 	{
-		std::stringstream debugStream;
+		out = WriteText( out, info.nmi ? "[NMI - Cycle:" : "[IRQ - Cycle:" );
+		out = WriteDec( out, info.cpuCycles, 0 );
+		*out++ = ']';
+		return out;
+	}
 
-		if( nmi )
-		{
-			debugStream << "[NMI - Cycle:" << cpuCycles << "]";
-			buffer +=  debugStream.str();
-			return;
-		}
+	char* const lineBegin = out;
 
-		if ( irq )
-		{
-			debugStream << "[IRQ - Cycle:" << cpuCycles << "]";
-			buffer += debugStream.str();
-			return;
-		}
+	out = WriteHex( out, info.instrBegin, 4, false );
+	out = WriteText( out, "  " );
 
-		int disassemblyBytes[6] = { byteCode, op0, op1,'\0' };
-		stringstream hexString;
+	char* const bytesBegin = out;
+	out = WriteHex( out, info.byteCode, 2, false );
+	if ( info.operands >= 1 )
+	{
+		*out++ = ' ';
+		out = WriteHex( out, info.op0, 2, false );
+	}
+	if ( info.operands >= 2 )
+	{
+		*out++ = ' ';
+		out = WriteHex( out, info.op1, 2, false );
+	}
+	while ( ( out - bytesBegin ) < 9 ) {
+		*out++ = ' ';
+	}
 
-		if ( operands == 1 )
-		{
-			PrintHex( hexString, disassemblyBytes[ 0 ], 2, false );
-			hexString << " ";
-			PrintHex( hexString, disassemblyBytes[ 1 ], 2, false );
-		}
-		else if ( operands == 2 )
-		{
-			PrintHex( hexString, disassemblyBytes[ 0 ], 2, false );
-			hexString << " ";
-			PrintHex( hexString, disassemblyBytes[ 1 ], 2, false );
-			hexString << " ";
-			PrintHex( hexString, disassemblyBytes[ 2 ], 2, false );
-		}
-		else
-		{
-			PrintHex( hexString, disassemblyBytes[ 0 ], 2, false );
-		}
+	out = WriteOpName( out, info );
+	*out++ = ' ';
 
-		PrintHex( debugStream, instrBegin, 4, false );
-		debugStream << setfill( ' ' ) << "  " << setw( 9 ) << left << hexString.str();
-		debugStream << GetOpName( *this ) << " ";
-	
-		const addrMode_t mode = static_cast<addrMode_t>( addrMode );
+	const addrMode_t mode = static_cast<addrMode_t>( info.addrMode );
+	const bool isXReg = ( mode == addrMode_t::IndexedAbsoluteX ) || ( mode == addrMode_t::IndexedZeroX );
 
-		const bool isXReg = ( mode == addrMode_t::IndexedAbsoluteX ) || ( mode == addrMode_t::IndexedZeroX );
+	switch ( mode )
+	{
+	default: break;
+	case addrMode_t::Absolute:
+		out = WriteHex( out, info.address, 4, true );
+		break;
+
+	case addrMode_t::Zero:
+		out = WriteHex( out, info.address, 2, true );
+		break;
+
+	case addrMode_t::IndexedAbsoluteX:
+	case addrMode_t::IndexedAbsoluteY:
+		out = WriteHex( out, info.targetAddress, 4, true );
+		out = WriteText( out, isXReg ? ",X @ " : ",Y @ " );
+		out = WriteHex( out, info.address, 4, false );
+		break;
+
+	case addrMode_t::IndexedZeroX:
+	case addrMode_t::IndexedZeroY:
+		out = WriteHex( out, info.targetAddress, 2, true );
+		out = WriteText( out, isXReg ? ",X @ " : ",Y @ " );
+		out = WriteHex( out, info.address, 2, false );
+		break;
+
+	case addrMode_t::Immediate:
+		*out++ = '#';
+		out = WriteHex( out, info.op0, 2, true );
+		break;
+
+	case addrMode_t::IndirectIndexed:
+		*out++ = '(';
+		out = WriteHex( out, info.op0, 2, true );
+		out = WriteText( out, "),Y = " );
+		out = WriteHex( out, info.address, 4, false );
+		out = WriteText( out, " @ " );
+		out = WriteHex( out, info.targetAddress, 4, false );
+		break;
+
+	case addrMode_t::IndexedIndirect:
+		*out++ = '(';
+		out = WriteHex( out, info.op0, 2, true );
+		out = WriteText( out, ",X) @ " );
+		out = WriteHex( out, info.targetAddress, 2, false );
+		out = WriteText( out, " = " );
+		out = WriteHex( out, info.address, 4, false );
+		break;
+
+	case addrMode_t::Accumulator:
+		*out++ = 'A';
+		break;
+
+	case addrMode_t::Jmp:
+	case addrMode_t::Branch:
+		out = WriteHex( out, info.address, 2, true );
+		break;
+
+	case addrMode_t::JmpIndirect:
+		*out++ = '(';
+		out = WriteHex( out, info.offset, 4, true );
+		out = WriteText( out, ") = " );
+		out = WriteHex( out, info.address, 4, false );
+		break;
+
+	case addrMode_t::Jsr:
+		out = WriteHex( out, info.address, 4, true );
+		break;
+	}
 
-		switch ( mode )
-		{
-		default: break;
-		case addrMode_t::Absolute:
-			PrintHex( debugStream, address, 4, true );
-			debugStream << " = ";
-			PrintHex( debugStream, static_cast<uint32_t>( memValue ), 2, false );
-			break;
+	if ( registerDebug )
+	{
+		const ptrdiff_t alignment = 48;
+		while ( ( out - lineBegin ) < alignment ) {
+			*out++ = ' ';
+		}
 
-		case addrMode_t::Zero:
-			PrintHex( debugStream, address, 2, true );
-			debugStream << " = ";
-			PrintHex( debugStream, static_cast<uint32_t>( memValue ), 2, false );
-			break;
+		out = WriteText( out, "A:" );
+		out = WriteHex( out, info.regInfo.A, 2, false );
+		out = WriteText( out, " X:" );
+		out = WriteHex( out, info.regInfo.X, 2, false );
+		out = WriteText( out, " Y:" );
+		out = WriteHex( out, info.regInfo.Y, 2, false );
+		out = WriteText( out, " P:" );
+		out = WriteHex( out, info.regInfo.P, 2, false );
+		out = WriteText( out, " SP:" );
+		out = WriteHex( out, info.regInfo.SP, 2, false );
+	}
 
-		case addrMode_t::IndexedAbsoluteX:
-		case addrMode_t::IndexedAbsoluteY:
-			PrintHex( debugStream, targetAddress, 4, true );
-			debugStream << "," << ( isXReg ? "X" : "Y" ) << " @ ";
-			PrintHex( debugStream, address, 4, false );
-			debugStream << " = ";
-			PrintHex( debugStream, static_cast<uint32_t>( memValue ), 2, false );
-			break;
+	if( cycleDebug )
+	{
+		out = WriteText( out, " PPU:" );
+		out = WriteSignedDec( out, info.curScanline, 3 );
+		*out++ = ',';
+		out = WriteDec( out, info.ppuCycles, 3 );
+		out = WriteText( out, " CYC:" );
+		out = WriteDec( out, info.cpuCycles, 0 );
+	}
+	return out;
+}
 
-		case addrMode_t::IndexedZeroX:
-		case addrMode_t::IndexedZeroY:
-			PrintHex( debugStream, targetAddress, 2, true );
-			debugStream << "," << ( isXReg ? "X" : "Y" ) << " @ ";
-			PrintHex( debugStream, address, 2, false );
-			debugStream << " = ";
-			PrintHex( debugStream, static_cast<uint32_t>( memValue ), 2, false );
-			break;
+namespace Tomtendo
+{
+	void OpDebugInfo::ToString( std::string& buffer, const bool registerDebug, const bool cycleDebug ) const
+	{
+		char line[ MaxLineLength ];
+		const char* end = FormatLine( line, *this, registerDebug, cycleDebug );
+		buffer.append( line, end - line );
+	}
 
-		case addrMode_t::Immediate:
-			debugStream << "#";
-			PrintHex( debugStream, static_cast<uint32_t>( memValue ), 2, true );
-			break;
 
-		case addrMode_t::IndirectIndexed:
-			debugStream << "(";
-			PrintHex( debugStream, static_cast<uint32_t>( op0 ), 2, true );
-			debugStream << "),Y = ";
-			PrintHex( debugStream, address, 4, false );
-			debugStream << " @ ";
-			PrintHex( debugStream, targetAddress, 4, false );
-			debugStream << " = ";
-			PrintHex( debugStream, static_cast<uint32_t>( memValue ), 2, false );
-			break;
+	static bool SeekFile( FILE* file, const uint64_t offset )
+	{
+#ifdef _WIN32
+		return ( _fseeki64( file, static_cast<int64_t>( offset ), SEEK_SET ) == 0 );
+#else
+		return ( fseeko( file, static_cast<off_t>( offset ), SEEK_SET ) == 0 );
+#endif
+	}
 
-		case addrMode_t::IndexedIndirect:
-			debugStream << "(";
-			PrintHex( debugStream, static_cast<uint32_t>( op0 ), 2, true );
-			debugStream << ",X) @ ";
-			PrintHex( debugStream, static_cast<uint32_t>( targetAddress ), 2, false );
-			debugStream << " = ";
-			PrintHex( debugStream, address, 4, false );
-			debugStream << " = ";
-			PrintHex( debugStream, static_cast<uint32_t>( memValue ), 2, false );
-			break;
 
-		case addrMode_t::Accumulator:
-			debugStream << "A";
-			break;
+	static uint64_t RingCapacity( const uint32_t frameCount )
+	{
+		const uint64_t target = static_cast<uint64_t>( frameCount ) * wtLog::RecordsPerFrame;
+		uint64_t capacity = 4096;
+		while ( ( capacity < target ) && ( capacity < wtLog::MaxRingRecords ) ) {
+			capacity <<= 1;
+		}
+		return capacity;
+	}
 
-		case addrMode_t::Jmp:
-			PrintHex( debugStream, address, 2, true );
-			break;
 
-		case addrMode_t::JmpIndirect:
-			debugStream << "(";
-			PrintHex( debugStream, offset, 4, true );
-			debugStream << ") = ";
-			PrintHex( debugStream, address, 4, false );
-			break;
+	wtLog::wtLog()
+	{
+		ringMask = 0;
+		lineCount = 0;
+		firstCycle = 0;
+		lastCycle = 0;
+		frameIx = 0;
+		totalCount = 0;
+		spillFile = nullptr;
+		spilledCount = 0;
+		memset( opInfo, 0, sizeof( opInfo ) );
+		Reset( 1 );
+	}
 
-		case addrMode_t::Jsr:
-			PrintHex( debugStream, address, 4, true );
-			break;
 
-		case addrMode_t::Branch:
-			PrintHex( debugStream, address, 2, true );
-			break;
+	wtLog::~wtLog()
+	{
+		if ( spillFile != nullptr ) {
+			fclose( spillFile );
 		}
+	}
 
-		if ( registerDebug )
-		{
-			debugStream.seekg( 0, ios::end );
-			const size_t alignment = 50;
-			const size_t width = ( alignment - debugStream.tellg() );
-			debugStream.seekg( 0, std::ios::beg );
-
-			debugStream << setfill( ' ' ) << setw( width ) << right;
-			debugStream << uppercase << "A:";
-			PrintHex( debugStream, static_cast<int>( regInfo.A ), 2, false );
-			debugStream << uppercase << " X:";
-			PrintHex( debugStream, static_cast<int>( regInfo.X ), 2, false );
-			debugStream << uppercase << " Y:";
-			PrintHex( debugStream, static_cast<int>( regInfo.Y ), 2, false );
-			debugStream << uppercase << " P:";
-			PrintHex( debugStream, static_cast<int>( regInfo.P ), 2, false );
-			debugStream << uppercase << " SP:";
-			PrintHex( debugStream, static_cast<int>( regInfo.SP ), 2, false );
+
+	void wtLog::Reset( const uint32_t targetCount, const std::string& path )
+	{
+		// The ring is allocated on first use so idle CPUs don't hold trace memory
+		const uint64_t capacity = RingCapacity( targetCount );
+		if ( ( capacity - 1 ) != ringMask ) {
+			ring.reset();
 		}
+		ringMask = capacity - 1;
 
-		if( cycleDebug )
+		if ( spillFile != nullptr )
 		{
-			debugStream << uppercase << " PPU:" << setfill( ' ' ) << setw( 3 ) <<  dec << right << curScanline;
-			debugStream << uppercase << "," << setfill( ' ' ) << setw( 3 ) << dec << ppuCycles;
-			debugStream << uppercase << " CYC:" << dec << cpuCycles << "\0";
+			fclose( spillFile );
+			spillFile = nullptr;
+		}
+		spillPath = path;
+		if ( !spillPath.empty() ) {
+			spillFile = fopen( spillPath.c_str(), "w+b" );
 		}
 
-		buffer += debugStream.str();
+		lineCount = 0;
+		spilledCount = 0;
+		firstCycle = 0;
+		lastCycle = 0;
+		totalCount = ( 1 + targetCount );
+		frameIx = 0;
+		frameStart.assign( totalCount + 1, 0 );
+		NewFrame();
 	}
 
 
-	void wtLog::Reset( const uint32_t targetCount )
+	void wtLog::SetOpInfo( const uint8_t opCode, const traceOpInfo_t& info )
 	{
-		log.clear();
-		totalCount = ( 1 + targetCount );
-		frameIx = 0;
-		log.resize( totalCount );
-		for ( size_t frameIndex = 0; frameIndex < totalCount; ++frameIndex ) {
-			log[ frameIndex ].reserve( 10000 );
-		}
-		NewFrame();
+		opInfo[ opCode ] = info;
 	}
 
 
@@ -248,27 +353,47 @@ namespace Tomtendo
 		}
 
 		++frameIx;
-		log[ frameIx ].reserve( 10000 );
+		frameStart[ frameIx ] = lineCount;
 	}
 
 
-	OpDebugInfo& wtLog::NewLine()
+	traceRecord_t& wtLog::NewLine( const uint64_t cpuCycle )
 	{
-		log[ frameIx ].resize( log[ frameIx ].size() + 1 );
-		return GetLogLine();
-	}
+		const uint64_t capacity = ringMask + 1;
+		if ( ring == nullptr ) {
+			ring.reset( new traceRecord_t[ capacity ] );
+		}
+
+		uint64_t delta = 0;
+		if ( lineCount == 0 ) {
+			firstCycle = cpuCycle;
+		} else {
+			delta = cpuCycle - lastCycle;
+		}
+		lastCycle = cpuCycle;
+
+		// Once the oldest line is overwritten the next one becomes the cycle base
+		if ( ( spillFile == nullptr ) && ( lineCount >= capacity ) ) {
+			firstCycle += ring[ ( lineCount + 1 ) & ringMask ].cycleDelta;
+		}
 
+		traceRecord_t& record = ring[ lineCount & ringMask ];
+		record = {};
+		record.cycleDelta = static_cast<uint32_t>( ( delta < 0xFFF ) ? delta : 0xFFF );
+		++lineCount;
 
-	const logFrame_t& wtLog::GetLogFrame( const uint32_t frameNum ) const
-	{
-		const uint32_t frameIndex = ( frameNum >= totalCount ) ? 0 : frameNum;
-		return log[ frameIndex ];
+		const uint64_t half = ( capacity >> 1 );
+		if ( ( spillFile != nullptr ) && ( ( lineCount - spilledCount ) >= half ) ) {
+			Spill( spilledCount, lineCount );
+		}
+		return record;
 	}
 
 
-	OpDebugInfo& wtLog::GetLogLine()
+	traceRecord_t& wtLog::GetLogLine()
 	{
-		return log[ frameIx ].back();
+		assert( lineCount > 0 );
+		return ring[ ( lineCount - 1 ) & ringMask ];
 	}
 
 
@@ -278,6 +403,12 @@ namespace Tomtendo
 	}
 
 
+	uint64_t wtLog::GetLineCount() const
+	{
+		return lineCount;
+	}
+
+
 	bool wtLog::IsFull() const
 	{
 		assert( totalCount > 0 );
@@ -289,19 +420,298 @@ namespace Tomtendo
 	{
 		// This needs to be improved, but sufficient for now
 		// Right now it's a weak condition
-		return ( IsFull() && log[ frameIx ].size() > 0 );
+		return ( IsFull() && ( lineCount > frameStart[ frameIx ] ) );
 	}
 
 
-	void wtLog::ToString( std::string& buffer, const uint32_t frameBegin, const uint32_t frameEnd, const bool registerDebug ) const
+	uint64_t wtLog::GetFirstLine() const
 	{
-		for( uint32_t i = ( frameBegin + 1 ); i <= frameEnd; ++i )
+		const uint64_t capacity = ringMask + 1;
+		if ( ( spillFile != nullptr ) || ( lineCount <= capacity ) ) {
+			return 0;
+		}
+		return ( lineCount - capacity );
+	}
+
+
+	void wtLog::Spill( const uint64_t lineBegin, const uint64_t lineEnd )
+	{
+		fseek( spillFile, 0, SEEK_END );
+		for ( uint64_t line = lineBegin; line < lineEnd; )
 		{
-			for ( const OpDebugInfo& dbgInfo : GetLogFrame( i ) )
+			// Split at the physical end of the ring
+			const uint64_t ringIx = ( line & ringMask );
+			const uint64_t runEnd = std::min( lineEnd, line + ( ringMask + 1 - ringIx ) );
+			fwrite( &ring[ ringIx ], sizeof( traceRecord_t ), static_cast<size_t>( runEnd - line ), spillFile );
+			line = runEnd;
+		}
+		spilledCount = lineEnd;
+	}
+
+
+	template<class Fn>
+	void wtLog::ForEachLine( const uint64_t lineBegin, const uint64_t lineEnd, Fn&& fn ) const
+	{
+		static const uint32_t ChunkSize = 4096;
+		traceRecord_t chunk[ ChunkSize ];
+
+		if ( spillFile != nullptr ) {
+			fflush( spillFile );
+		}
+
+		// Cycles are stored as deltas, so walk forward from the oldest retained line
+		uint64_t cycle = firstCycle;
+		uint64_t line = GetFirstLine();
+		bool first = true;
+		while ( line < lineEnd )
+		{
+			const traceRecord_t* records;
+			uint64_t count;
+			if ( line < spilledCount )
 			{
-				dbgInfo.ToString( buffer, true, false );
-				buffer += "\n";
+				count = std::min<uint64_t>( ChunkSize, spilledCount - line );
+				if ( !SeekFile( spillFile, line * sizeof( traceRecord_t ) ) ) {
+					return;
+				}
+				count = fread( chunk, sizeof( traceRecord_t ), static_cast<size_t>( count ), spillFile );
+				if ( count == 0 ) {
+					return;
+				}
+				records = chunk;
 			}
+			else
+			{
+				const uint64_t ringIx = ( line & ringMask );
+				count = std::min( lineEnd - line, ringMask + 1 - ringIx );
+				records = &ring[ ringIx ];
+			}
+
+			for ( uint64_t i = 0; ( i < count ) && ( line < lineEnd ); ++i, ++line )
+			{
+				if ( !first ) {
+					cycle += records[ i ].cycleDelta;
+				}
+				first = false;
+
+				if ( line >= lineBegin ) {
+					fn( records[ i ], cycle );
+				}
+			}
+		}
+	}
+
+
+	void wtLog::Unpack( const traceRecord_t& record, const uint64_t cpuCycle, OpDebugInfo& outInfo ) const
+	{
+		outInfo = OpDebugInfo();
+		outInfo.cpuCycles = cpuCycle;
+		outInfo.nmi = ( record.nmi != 0 );
+		outInfo.irq = ( record.irq != 0 );
+
+		if ( outInfo.nmi || outInfo.irq ) {
+			return;
+		}
+
+		const traceOpInfo_t& op = opInfo[ record.opCode ];
+		outInfo.regInfo		= { record.X, record.Y, record.A, record.SP, record.P, record.pc };
+		outInfo.instrBegin	= record.pc;
+		outInfo.byteCode	= record.opCode;
+		outInfo.op0			= record.op0;
+		outInfo.op1			= record.op1;
+		outInfo.mnemonic	= ( op.mnemonic != nullptr ) ? op.mnemonic : "???";
+		outInfo.operands	= op.operands;
+		outInfo.isIllegal	= op.illegal;
+		outInfo.opType		= op.opType;
+		outInfo.addrMode	= op.addrMode;
+		outInfo.curScanline	= static_cast<int32_t>( record.scanline ) - 1;
+		outInfo.ppuCycles	= record.dot;
+		outInfo.address		= record.address;
+
+		const uint16_t operandAddr = Combine( record.op0, record.op1 );
+		switch ( static_cast<addrMode_t>( op.addrMode ) )
+		{
+		default: break;
+		case addrMode_t::IndexedAbsoluteX:
+		case addrMode_t::IndexedAbsoluteY:
+			outInfo.targetAddress = operandAddr;
+			break;
+		case addrMode_t::IndexedZeroX:
+		case addrMode_t::IndexedZeroY:
+			outInfo.targetAddress = record.op0;
+			break;
+		case addrMode_t::IndexedIndirect:
+			outInfo.targetAddress = static_cast<uint8_t>( record.op0 + record.X );
+			break;
+		case addrMode_t::IndirectIndexed:
+			outInfo.targetAddress = static_cast<uint16_t>( record.address + record.Y );
+			break;
+		case addrMode_t::JmpIndirect:
+			outInfo.offset = operandAddr;
+			break;
 		}
 	}
+
+
+	void wtLog::GetLineRange( const uint32_t frameBegin, const uint32_t frameEnd, uint64_t& outLineBegin, uint64_t& outLineEnd ) const
+	{
+		outLineBegin = ( ( frameBegin + 1 ) <= frameIx ) ? frameStart[ frameBegin + 1 ] : lineCount;
+		outLineEnd = ( frameEnd < frameIx ) ? frameStart[ frameEnd + 1 ] : lineCount;
+		outLineBegin = std::max( outLineBegin, GetFirstLine() );
+		outLineEnd = std::max( outLineBegin, outLineEnd );
+	}
+
+
+	void wtLog::ReadLines( const uint64_t firstLine, const uint64_t count, traceRecord_t* outRecords, FILE* file ) const
+	{
+		uint64_t line = firstLine;
+		const uint64_t lineEnd = firstLine + count;
+
+		if ( ( line < spilledCount ) && ( file != nullptr ) && SeekFile( file, line * sizeof( traceRecord_t ) ) )
+		{
+			const uint64_t fileLines = std::min( lineEnd, spilledCount ) - line;
+			const size_t readLines = fread( outRecords, sizeof( traceRecord_t ), static_cast<size_t>( fileLines ), file );
+			memset( outRecords + readLines, 0, static_cast<size_t>( fileLines - readLines ) * sizeof( traceRecord_t ) );
+			outRecords += fileLines;
+			line += fileLines;
+		}
+
+		while ( line < lineEnd )
+		{
+			const uint64_t ringIx = ( line & ringMask );
+			const uint64_t runLines = std::min( lineEnd - line, ringMask + 1 - ringIx );
+			memcpy( outRecords, &ring[ ringIx ], static_cast<size_t>( runLines ) * sizeof( traceRecord_t ) );
+			outRecords += runLines;
+			line += runLines;
+		}
+	}
+
+
+	template<class Sink>
+	void wtLog::FormatLines( const uint64_t lineBegin, const uint64_t lineEnd, const bool registerDebug, Sink&& sink ) const
+	{
+		struct chunk_t
+		{
+			uint64_t	firstLine;
+			uint64_t	lineCount;
+			uint64_t	firstCycle;
+		};
+
+		// Cycles are delta coded, so one cheap serial pass finds where each chunk starts
+		std::vector<chunk_t> chunks;
+		uint64_t line = lineBegin;
+		ForEachLine( lineBegin, lineEnd, [&]( const traceRecord_t& /*record*/, const uint64_t cycle )
+		{
+			if ( ( ( line - lineBegin ) % FormatChunkLines ) == 0 ) {
+				chunks.push_back( { line, std::min( static_cast<uint64_t>( FormatChunkLines ), lineEnd - line ), cycle } );
+			}
+			++line;
+		} );
+
+		const uint32_t threadCount = std::max( 1u, std::thread::hardware_concurrency() );
+		const size_t batchSize = 4 * threadCount;
+		std::vector<std::string> text( std::min( batchSize, chunks.size() ) );
+
+		for ( size_t batchBegin = 0; batchBegin < chunks.size(); batchBegin += batchSize )
+		{
+			const size_t batchEnd = std::min( chunks.size(), batchBegin + batchSize );
+			std::atomic<size_t> nextChunk( batchBegin );
+
+			auto worker = [&]()
+			{
+				FILE* file = ( spilledCount > 0 ) ? fopen( spillPath.c_str(), "rb" ) : nullptr;
+				std::vector<traceRecord_t> records( FormatChunkLines );
+				OpDebugInfo info;
+
+				for ( size_t i = nextChunk++; i < batchEnd; i = nextChunk++ )
+				{
+					const chunk_t& chunk = chunks[ i ];
+					ReadLines( chunk.firstLine, chunk.lineCount, records.data(), file );
+
+					std::string& out = text[ i - batchBegin ];
+					out.resize( static_cast<size_t>( chunk.lineCount ) * ( OpDebugInfo::MaxLineLength + 1 ) );
+
+					char* const outBegin = &out[ 0 ];
+					char* outEnd = outBegin;
+					uint64_t cycle = chunk.firstCycle;
+					for ( uint64_t j = 0; j < chunk.lineCount; ++j )
+					{
+						if ( j > 0 ) {
+							cycle += records[ j ].cycleDelta;
+						}
+						Unpack( records[ j ], cycle, info );
+						outEnd = FormatLine( outEnd, info, registerDebug, false );
+						*outEnd++ = '\n';
+					}
+					out.resize( outEnd - outBegin );
+				}
+
+				if ( file != nullptr ) {
+					fclose( file );
+				}
+			};
+
+			std::vector<std::thread> threads;
+			const size_t helperCount = std::min<size_t>( threadCount, batchEnd - batchBegin ) - 1;
+			for ( size_t i = 0; i < helperCount; ++i ) {
+				threads.emplace_back( worker );
+			}
+			worker();
+			for ( std::thread& thread : threads ) {
+				thread.join();
+			}
+
+			for ( size_t i = batchBegin; i < batchEnd; ++i ) {
+				sink( text[ i - batchBegin ] );
+			}
+		}
+	}
+
+
+	void wtLog::ToString( std::string& buffer, const uint32_t frameBegin, const uint32_t frameEnd, const bool registerDebug ) const
+	{
+		uint64_t lineBegin;
+		uint64_t lineEnd;
+		GetLineRange( frameBegin, frameEnd, lineBegin, lineEnd );
+
+		buffer.reserve( buffer.size() + static_cast<size_t>( lineEnd - lineBegin ) * 80 );
+		FormatLines( lineBegin, lineEnd, registerDebug, [&]( const std::string& text )
+		{
+			buffer += text;
+		} );
+	}
+
+
+	void wtLog::LinesToString( std::string& buffer, const uint64_t lineBegin, const uint64_t lineEnd, const bool registerDebug ) const
+	{
+		const uint64_t end = std::min( lineEnd, lineCount );
+		const uint64_t begin = std::min( std::max( lineBegin, GetFirstLine() ), end );
+
+		buffer.reserve( buffer.size() + static_cast<size_t>( end - begin ) * 80 );
+		FormatLines( begin, end, registerDebug, [&]( const std::string& text )
+		{
+			buffer += text;
+		} );
+	}
+
+
+	bool wtLog::ToFile( const std::string& path, const uint32_t frameBegin, const uint32_t frameEnd, const bool registerDebug ) const
+	{
+		FILE* file = fopen( path.c_str(), "wb" );
+		if ( file == nullptr ) {
+			return false;
+		}
+
+		uint64_t lineBegin;
+		uint64_t lineEnd;
+		GetLineRange( frameBegin, frameEnd, lineBegin, lineEnd );
+
+		bool success = true;
+		FormatLines( lineBegin, lineEnd, registerDebug, [&]( const std::string& text )
+		{
+			success = success && ( fwrite( text.data(), 1, text.size(), file ) == text.size() );
+		} );
+
+		success = ( fclose( file ) == 0 ) && success;
+		return success;
+	}
 };
\ No newline at end of file
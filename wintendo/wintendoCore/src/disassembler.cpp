@@ -0,0 +1,296 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include "disassembler.h"
+#include "cdl.h"
+#include "processors/mos6502.h"
+
+using namespace std;
+
+using DisasmKey = pair<uint64_t, uint32_t>;
+using DisasmCache = map< DisasmKey, shared_ptr<const wtDisassembler::bank_t> >;
+
+static mutex		cacheLock;
+static DisasmCache	cache;
+
+enum byteKind_t : uint8_t
+{
+	BYTE_UNKNOWN,
+	BYTE_OPCODE,
+	BYTE_OPERAND,
+};
+
+
+shared_ptr<const wtDisassembler::bank_t> wtDisassembler::GetBank( const uint8_t* prgRom, const uint32_t prgRomSize, const uint64_t romHash, const uint32_t bankNum, const opInfo_t* opLUT, const wtCdl* cdl )
+{
+	assert( prgRomSize >= BankSize );
+
+	const uint32_t cdlCodeBytes = ( cdl != nullptr ) ? cdl->GetBankCodeBytes( ( bankNum * BankSize ) % prgRomSize ) : 0;
+	const DisasmKey key( romHash, bankNum );
+	{
+		lock_guard<mutex> guard( cacheLock );
+		auto it = cache.find( key );
+		if ( ( it != cache.end() ) && ( it->second->cdlCodeBytes == cdlCodeBytes ) ) {
+			return it->second;
+		}
+	}
+
+	// Built outside the lock; a racing rebuild only replaces an identical listing
+	shared_ptr<bank_t> bank = make_shared<bank_t>();
+	bank->cdlCodeBytes = cdlCodeBytes;
+	Analyze( *bank, prgRom, prgRomSize, bankNum, opLUT, cdl );
+
+	lock_guard<mutex> guard( cacheLock );
+	cache[ key ] = bank;
+	return bank;
+}
+
+
+void wtDisassembler::Analyze( bank_t& bank, const uint8_t* prgRom, const uint32_t prgRomSize, const uint32_t bankNum, const opInfo_t* opLUT, const wtCdl* cdl )
+{
+	const uint32_t bankCount = prgRomSize / BankSize;
+	const uint32_t bankOffset = ( bankNum * BankSize ) % prgRomSize;
+	const uint8_t* mem = prgRom + bankOffset;
+
+	// Assume the power-on layout: last bank fixed at $C000, the rest swapped in at $8000
+	const bool isLastBank = ( bankNum == ( bankCount - 1 ) );
+	const bool isMirrored = ( bankCount == 1 );
+	const uint16_t baseAddr = isLastBank ? 0xC000 : 0x8000;
+
+	auto InBank = [ & ]( const uint16_t addr ) {
+		return ( addr >= 0x8000 ) && ( isMirrored || ( ( addr & 0xC000 ) == baseAddr ) );
+	};
+	auto IsCdlCode = [ & ]( const uint32_t offset ) {
+		return ( cdl != nullptr ) && ( offset < BankSize ) && ( ( cdl->GetPrg( bankOffset + offset ) & CDL_PRG_CODE ) != 0 );
+	};
+
+	vector<uint8_t> kind( BankSize, BYTE_UNKNOWN );
+	vector<uint32_t> pending;
+
+	if ( isLastBank )
+	{
+		for ( uint32_t vectorAddr = 0x3FFA; vectorAddr < BankSize; vectorAddr += 2 )
+		{
+			const uint16_t target = Combine( mem[ vectorAddr ], mem[ vectorAddr + 1 ] );
+			if ( InBank( target ) ) {
+				pending.push_back( target & ( BankSize - 1 ) );
+			}
+		}
+	}
+
+	// CDL marks operands as code too, so only the start of each run is a safe entry
+	for ( uint32_t i = 0; i < BankSize; ++i )
+	{
+		if ( IsCdlCode( i ) && ( ( i == 0 ) || !IsCdlCode( i - 1 ) ) ) {
+			pending.push_back( i );
+		}
+	}
+
+	// Nothing to start from, so fall back to a linear sweep rather than show only data
+	const bool linearSweep = pending.empty();
+	if ( linearSweep ) {
+		pending.push_back( 0 );
+	}
+
+	while ( !pending.empty() )
+	{
+		uint32_t offset = pending.back();
+		pending.pop_back();
+
+		while ( offset < BankSize )
+		{
+			if ( kind[ offset ] != BYTE_UNKNOWN ) {
+				break;
+			}
+
+			const opInfo_t& op = opLUT[ mem[ offset ] ];
+			const uint32_t size = 1 + op.operands;
+			const bool undefined = ( op.type == opType_t::Illegal ) || ( op.illegal && !IsCdlCode( offset ) );
+			if ( ( offset + size > BankSize ) || ( undefined && !linearSweep ) ) {
+				break;
+			}
+
+			bool overlaps = false;
+			for ( uint32_t i = 1; i < size; ++i ) {
+				overlaps |= ( kind[ offset + i ] != BYTE_UNKNOWN );
+			}
+			if ( overlaps ) {
+				break;
+			}
+
+			kind[ offset ] = BYTE_OPCODE;
+			for ( uint32_t i = 1; i < size; ++i ) {
+				kind[ offset + i ] = BYTE_OPERAND;
+			}
+
+			const uint16_t operand = ( size == 3 ) ? Combine( mem[ offset + 1 ], mem[ offset + 2 ] ) : 0;
+			bool endsFlow = false;
+
+			switch ( op.addrMode )
+			{
+			case addrMode_t::Branch:
+			{
+				const uint16_t target = static_cast<uint16_t>( baseAddr + offset + 2 + static_cast<int8_t>( mem[ offset + 1 ] ) );
+				if ( InBank( target ) ) {
+					pending.push_back( target & ( BankSize - 1 ) );
+				}
+			}
+			break;
+
+			case addrMode_t::Jsr:
+			case addrMode_t::Jmp:
+				if ( InBank( operand ) ) {
+					pending.push_back( operand & ( BankSize - 1 ) );
+				}
+				endsFlow = ( op.addrMode == addrMode_t::Jmp );
+			break;
+
+			case addrMode_t::JmpIndirect:
+			case addrMode_t::Return:
+				endsFlow = true;
+			break;
+
+			default: break;
+			}
+
+			offset += size;
+
+			if ( ( endsFlow || ( op.type == opType_t::BRK ) ) && !linearSweep )
+			{
+				if ( IsCdlCode( offset ) ) {
+					pending.push_back( offset );
+				}
+				break;
+			}
+		}
+	}
+
+	uint32_t offset = 0;
+	while ( offset < BankSize )
+	{
+		disasmLine_t line;
+		line.offset = static_cast<uint16_t>( offset );
+		line.isCode = ( kind[ offset ] == BYTE_OPCODE );
+
+		if ( line.isCode )
+		{
+			line.size = 1 + opLUT[ mem[ offset ] ].operands;
+		}
+		else
+		{
+			uint32_t size = 1;
+			while ( ( size < MaxDataBytesPerLine ) && ( ( offset + size ) < BankSize ) && ( kind[ offset + size ] != BYTE_OPCODE ) ) {
+				++size;
+			}
+			line.size = static_cast<uint8_t>( size );
+		}
+
+		bank.lines.push_back( line );
+		offset += line.size;
+	}
+}
+
+
+int wtDisassembler::FormatInstruction( char* out, const size_t outSize, const uint8_t bytes[ 3 ], const opInfo_t& op, const uint32_t address )
+{
+	const uint16_t word = Combine( bytes[ 1 ], bytes[ 2 ] );
+	const char* name = op.mnemonic;
+	if ( ( op.type == opType_t::SKB ) || ( op.type == opType_t::SKW ) ) {
+		name = "NOP";
+	}
+	const char* illegal = op.illegal ? "*" : "";
+
+	switch ( op.addrMode )
+	{
+	default:							return snprintf( out, outSize, "%s%s", illegal, name );
+	case addrMode_t::Accumulator:		return snprintf( out, outSize, "%s%s A", illegal, name );
+	case addrMode_t::Immediate:			return snprintf( out, outSize, "%s%s #$%02X", illegal, name, bytes[ 1 ] );
+	case addrMode_t::Zero:				return snprintf( out, outSize, "%s%s $%02X", illegal, name, bytes[ 1 ] );
+	case addrMode_t::IndexedZeroX:		return snprintf( out, outSize, "%s%s $%02X,X", illegal, name, bytes[ 1 ] );
+	case addrMode_t::IndexedZeroY:		return snprintf( out, outSize, "%s%s $%02X,Y", illegal, name, bytes[ 1 ] );
+	case addrMode_t::IndexedIndirect:	return snprintf( out, outSize, "%s%s ($%02X,X)", illegal, name, bytes[ 1 ] );
+	case addrMode_t::IndirectIndexed:	return snprintf( out, outSize, "%s%s ($%02X),Y", illegal, name, bytes[ 1 ] );
+	case addrMode_t::Absolute:
+	case addrMode_t::Jmp:
+	case addrMode_t::Jsr:				return snprintf( out, outSize, "%s%s $%04X", illegal, name, word );
+	case addrMode_t::IndexedAbsoluteX:	return snprintf( out, outSize, "%s%s $%04X,X", illegal, name, word );
+	case addrMode_t::IndexedAbsoluteY:	return snprintf( out, outSize, "%s%s $%04X,Y", illegal, name, word );
+	case addrMode_t::JmpIndirect:		return snprintf( out, outSize, "%s%s ($%04X)", illegal, name, word );
+	case addrMode_t::Branch:
+	{
+		// Same address space as 'address': CPU address for RAM, bank offset for ROM
+		const uint32_t target = ( address + 2 + static_cast<int8_t>( bytes[ 1 ] ) ) & 0xFFFF;
+		return snprintf( out, outSize, "%s%s $%04X", illegal, name, target );
+	}
+	}
+}
+
+
+void wtDisassembler::FormatLines( std::string& out, const bank_t& bank, const uint8_t* bankMem, const opInfo_t* opLUT, const uint32_t firstLine, const uint32_t lineCount )
+{
+	const uint32_t endLine = min( static_cast<uint32_t>( bank.lines.size() ), firstLine + lineCount );
+
+	for ( uint32_t i = firstLine; i < endLine; ++i )
+	{
+		const disasmLine_t& line = bank.lines[ i ];
+		const uint8_t* bytes = &bankMem[ line.offset ];
+
+		char text[ MaxLineLength ];
+		int len = snprintf( text, sizeof( text ), "0x%04X  ", line.offset );
+
+		if ( line.isCode )
+		{
+			const int bytesBegin = len;
+			for ( uint32_t b = 0; b < line.size; ++b ) {
+				len += snprintf( text + len, sizeof( text ) - len, ( b == 0 ) ? "%02X" : " %02X", bytes[ b ] );
+			}
+			while ( ( len - bytesBegin ) < 10 ) {
+				text[ len++ ] = ' ';
+			}
+
+			const uint8_t operands[ 3 ] = { bytes[ 0 ], ( line.size > 1 ) ? bytes[ 1 ] : uint8_t( 0 ), ( line.size > 2 ) ? bytes[ 2 ] : uint8_t( 0 ) };
+			len += FormatInstruction( text + len, sizeof( text ) - len, operands, opLUT[ bytes[ 0 ] ], line.offset );
+		}
+		else
+		{
+			len += snprintf( text + len, sizeof( text ) - len, ".db" );
+			for ( uint32_t b = 0; b < line.size; ++b ) {
+				len += snprintf( text + len, sizeof( text ) - len, ( b == 0 ) ? " $%02X" : ", $%02X", bytes[ b ] );
+			}
+		}
+
+		out.append( text, len );
+		out += '\n';
+	}
+}
+
+
+void wtDisassembler::PurgeCache()
+{
+	lock_guard<mutex> guard( cacheLock );
+	cache.clear();
+}
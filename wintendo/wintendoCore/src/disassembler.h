@@ -0,0 +1,64 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+struct opInfo_t;
+class wtCdl;
+
+struct disasmLine_t
+{
+	uint16_t	offset;		// Bank relative
+	uint8_t		size;
+	bool		isCode;
+};
+
+// Static PRG disassembly by recursive descent from the interrupt vectors,
+// jump and branch targets, and any code the CDL has seen run. Decoded banks
+// are cached per (ROM hash, bank); text is only produced for the lines asked for.
+class wtDisassembler
+{
+public:
+	static const uint32_t BankSize				= 0x4000;
+	static const uint32_t MaxDataBytesPerLine	= 8;
+	static const uint32_t MaxLineLength			= 64;
+
+	struct bank_t
+	{
+		std::vector<disasmLine_t>	lines;
+		uint32_t					cdlCodeBytes;	// CDL coverage the listing was built from
+	};
+
+	static std::shared_ptr<const bank_t>	GetBank( const uint8_t* prgRom, const uint32_t prgRomSize, const uint64_t romHash, const uint32_t bankNum, const opInfo_t* opLUT, const wtCdl* cdl );
+	static void								FormatLines( std::string& out, const bank_t& bank, const uint8_t* bankMem, const opInfo_t* opLUT, const uint32_t firstLine, const uint32_t lineCount );
+	static int								FormatInstruction( char* out, const size_t outSize, const uint8_t bytes[ 3 ], const opInfo_t& op, const uint32_t address );
+	static void								PurgeCache();
+
+private:
+	static void								Analyze( bank_t& bank, const uint8_t* prgRom, const uint32_t prgRomSize, const uint32_t bankNum, const opInfo_t* opLUT, const wtCdl* cdl );
+};
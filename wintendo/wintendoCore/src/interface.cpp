@@ -23,6 +23,7 @@
 
 #include "../include/tomtendo/interface.h"
 #include "system/NesSystem.h"
+#include "disassembler.h"
 
 namespace Tomtendo
 {
@@ -32,6 +33,7 @@ namespace Tomtendo
 
 		// System
 		config.sys.flags = (emulationFlags_t)( (uint32_t)emulationFlags_t::CLAMP_FPS | (uint32_t)emulationFlags_t::LIMIT_STALL );
+		config.sys.seekIndexMB = 64;
 
 		// PPU
 		config.ppu.chrPalette = 0;
@@ -82,8 +84,9 @@ namespace Tomtendo
 		if( system != nullptr ) {
 			delete system;
 		}
+		wtDisassembler::PurgeCache(); // Listings are keyed by ROM hash, the old cart's are dead weight now
 		system = new wtSystem();
-		const int ret = system->Init( filePath );
+		const int ret = system->Init( filePath, resetVectorManual );
 		if( ret == 0 )
 		{
 			system->AttachInputHandler( &input );
@@ -92,6 +95,48 @@ namespace Tomtendo
 		return false;
 	}
 
+	int Emulator::Boot( const uint8_t* romData, const uint32_t romSize, const uint32_t resetVectorManual )
+	{
+		if( system != nullptr ) {
+			delete system;
+		}
+		wtDisassembler::PurgeCache(); // Listings are keyed by ROM hash, the old cart's are dead weight now
+		system = new wtSystem();
+		const int ret = system->Init( romData, romSize, resetVectorManual );
+		if( ret == 0 )
+		{
+			system->AttachInputHandler( &input );
+			return true;
+		}
+		return false;
+	}
+
+	Emulator* Emulator::Clone()
+	{
+		if ( system == nullptr ) {
+			return nullptr;
+		}
+
+		Emulator* clone = new Emulator();
+		clone->input = input;
+		clone->system = new wtSystem();
+		if ( clone->system->Clone( *system ) != 0 )
+		{
+			delete clone;
+			return nullptr;
+		}
+		clone->system->AttachInputHandler( &clone->input );
+		return clone;
+	}
+
+	bool Emulator::CopyState( Emulator& source )
+	{
+		if ( ( system == nullptr ) || ( source.system == nullptr ) ) {
+			return false;
+		}
+		return system->CopyState( *source.system );
+	}
+
 	int Emulator::RunEpoch( const std::chrono::nanoseconds& runCycles )
 	{
 		return system->RunEpoch( runCycles );
@@ -112,6 +157,16 @@ namespace Tomtendo
 		system->SubmitCommand( cmd );
 	}
 
+	void Emulator::GetCodeDataStats( cdlStats_t& stats ) const
+	{
+		system->GetCdlStats( stats );
+	}
+
+	bool Emulator::GetBreakpointHit( breakpointHit_t& hit ) const
+	{
+		return system->GetBreakpointHit( hit );
+	}
+
 	void Emulator::UpdateDebugImages()
 	{
 		system->UpdateDebugImages();
@@ -122,10 +177,21 @@ namespace Tomtendo
 		assert( system->cart->h.prgRomBanks <= 128 );
 		for ( uint32_t bankNum = 0; bankNum < system->cart->h.prgRomBanks; ++bankNum )
 		{
-			prgRomAsm[ bankNum ] = system->GetPrgBankDissambly( bankNum );
+			prgRomAsm[ bankNum ].clear();
+			system->GetDisassembly( bankNum, 0, system->GetDisassemblyLineCount( bankNum ), prgRomAsm[ bankNum ] );
 		}
 	}
 
+	uint32_t Emulator::GetDisassemblyLineCount( const uint32_t bankNum ) const
+	{
+		return system->GetDisassemblyLineCount( bankNum );
+	}
+
+	void Emulator::GetDisassembly( const uint32_t bankNum, const uint32_t firstLine, const uint32_t lineCount, std::string& out ) const
+	{
+		system->GetDisassembly( bankNum, firstLine, lineCount, out );
+	}
+
 	void Emulator::GenerateChrRomTables( wtPatternTableImage chrRom[ 32 ] )
 	{
 		assert( system->cart->GetChrBankCount() <= 32 );
@@ -139,9 +205,11 @@ namespace Tomtendo
 		}
 
 		assert( system->cart->h.chrRomBanks <= 32 );
+		system->SetCdlPaused( true );
 		for ( uint32_t bankNum = 0; bankNum < system->cart->h.chrRomBanks; ++bankNum ) {
 			system->GetPPU().DrawDebugPatternTables( chrRom[ bankNum ], palette, bankNum, true );
 		}
+		system->SetCdlPaused( false );
 	}
 		
 	ButtonFlags Input::GetKeyBuffer( const ControllerId controllerId ) const
@@ -150,6 +218,12 @@ namespace Tomtendo
 		return keyBuffer[ mapKey ];
 	}
 
+	void Input::SetKeyBuffer( const ControllerId controllerId, const ButtonFlags buttons )
+	{
+		const uint32_t mapKey = static_cast<uint32_t>( controllerId );
+		keyBuffer[ mapKey ] = buttons;
+	}
+
 	mouse_t Input::GetMouse() const
 	{
 		return mousePoint;
@@ -26,7 +26,7 @@
 #include "../common.h"
 #include "../system/NesSystem.h"
 
-class MMC1 : public wtMapper
+class MMC1 final : public wtMapper
 {
 private:
 	union ctrlReg_t
@@ -163,6 +163,8 @@ private:
 	}
 
 public:
+	static const mapperType_t Type = mapperType_t::MMC1;
+
 
 	MMC1( const uint32_t _mapperId ) :
 		chrBank0Reg( 0 ),
@@ -191,7 +193,7 @@ public:
 
 	uint8_t OnLoadPpu() override
 	{
-		memset( chrRam, 0, sizeof( PPU::PatternTableMemorySize ) );
+		memset( chrRam, 0, sizeof( chrRam ) );
 		return 0;
 	}
 
@@ -217,6 +219,26 @@ public:
 		return 0;
 	}
 
+	uint32_t GetPrgRomOffset( const uint16_t addr ) const override
+	{
+		if ( InRange( addr, wtSystem::Bank0, wtSystem::Bank0End ) ) {
+			return system->cart->GetPrgRomOffset( bank0 | bank256 ) + ( addr - wtSystem::Bank0 );
+		}
+		else if ( InRange( addr, wtSystem::Bank1, wtSystem::Bank1End ) ) {
+			return system->cart->GetPrgRomOffset( bank1 | bank256 ) + ( addr - wtSystem::Bank1 );
+		}
+		return InvalidRomOffset;
+	}
+
+	uint32_t GetChrRomOffset( const uint16_t addr ) const override
+	{
+		if ( system->cart->HasChrRam() || ( addr > 0x1FFF ) ) {
+			return InvalidRomOffset;
+		}
+		const uint8_t bank = ( addr < 0x1000 ) ? chrBank0 : chrBank1;
+		return system->cart->GetChrRomOffset( bank, KB( 4 ) ) + ( addr & 0x0FFF );
+	}
+
 	uint8_t	ReadChrRom( const uint16_t addr ) const override
 	{
 		if ( InRange( addr, 0x0000, 0x1FFF ) && system->cart->HasChrRam() ) {
@@ -241,10 +263,14 @@ public:
 		return 0;
 	}
 
-	bool InWriteWindow( const uint16_t addr, const uint16_t offset ) const override
+	bool InWriteWindow( const uint16_t addr, const uint16_t /*offset*/ ) const override
 	{
-		const uint16_t address = ( addr + offset );
-		return ( system->cart->GetMapperId() == mapperId ) && InRange( address, wtSystem::ExpansionRomBase, wtSystem::Bank1End );
+		return ( system->cart->GetMapperId() == mapperId ) && InRange( addr, wtSystem::ExpansionRomBase, wtSystem::Bank1End );
+	}
+
+	uint8_t* GetSaveRam() override
+	{
+		return prgRamBank;
 	}
 
 	uint8_t Write( const uint16_t address, const uint8_t value ) override
@@ -275,30 +301,31 @@ public:
 		return 0;
 	}
 
-	void Serialize( Serializer& serializer ) override
+	MAPPER_STATE_VISITORS()
+
+	template<class V>
+	void Visit( V& visitor )
 	{
-		serializer.Next8b( ctrlReg.byte );
-		serializer.Next8b( chrBank0Reg );
-		serializer.Next8b( chrBank1Reg );
-		serializer.Next8b( bank0 );
-		serializer.Next8b( bank1 );
-		serializer.NextBool( ramEnabled );
-		serializer.Next8b( chrBank0 );
-		serializer.Next8b( chrBank1 );
-		serializer.Next8b( bank256 );
-		serializer.Next8b( ramDisable );
-
-		if ( serializer.GetMode() == serializeMode_t::STORE ) {
-			uint8_t shift = shiftRegister.GetValue();
-			serializer.Next8b( shift );
-		}
-		else if ( serializer.GetMode() == serializeMode_t::LOAD ) {
-			uint8_t shift;
-			serializer.Next8b( shift );
+		visitor.Field( ctrlReg.byte );
+		visitor.Field( chrBank0Reg );
+		visitor.Field( chrBank1Reg );
+		visitor.Field( bank0 );
+		visitor.Field( bank1 );
+		visitor.Field( ramEnabled );
+		visitor.Field( chrBank0 );
+		visitor.Field( chrBank1 );
+		visitor.Field( bank256 );
+		visitor.Field( ramDisable );
+
+		uint8_t shift = static_cast<uint8_t>( shiftRegister.GetValue() );
+		visitor.Field( shift );
+		if ( V::Loading ) {
 			shiftRegister.Set( shift );
 		}
 
-		serializer.NextArray( reinterpret_cast<uint8_t*>( &prgRamBank[ 0 ] ), KB( 8 ) );
-		serializer.NextArray( reinterpret_cast<uint8_t*>( &chrRam[ 0 ] ), PPU::PatternTableMemorySize );
+		visitor.BeginLabel( STATE_SRAM_LABEL );
+		visitor.Array( &prgRamBank[ 0 ], KB( 8 ) );
+		visitor.EndLabel( STATE_SRAM_LABEL );
+		visitor.Array( &chrRam[ 0 ], PPU::PatternTableMemorySize );
 	}
 };
\ No newline at end of file
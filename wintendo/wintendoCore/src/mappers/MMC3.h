@@ -27,7 +27,7 @@
 #include "../common.h"
 #include "../system/NesSystem.h"
 
-class MMC3 : public wtMapper
+class MMC3 final : public wtMapper
 {
 private:
 
@@ -120,6 +120,8 @@ private:
 	}
 
 public:
+	static const mapperType_t Type = mapperType_t::MMC3;
+
 
 	MMC3( const uint32_t _mapperId ) :
 		irqLatch( 0x00 ),
@@ -150,14 +152,18 @@ public:
 
 	uint8_t OnLoadPpu() override
 	{
-		memset( chrRam, 0, sizeof( PPU::PatternTableMemorySize ) );
+		memset( chrRam, 0, sizeof( chrRam ) );
 		return 0;
 	}
 
-	bool InWriteWindow( const uint16_t addr, const uint16_t offset ) const override
+	bool InWriteWindow( const uint16_t addr, const uint16_t /*offset*/ ) const override
+	{
+		return ( system->cart->GetMapperId() == mapperId ) && InRange( addr, wtSystem::ExpansionRomBase, 0xFFFF );
+	}
+
+	uint8_t* GetSaveRam() override
 	{
-		const uint16_t address = ( addr + offset );
-		return ( system->cart->GetMapperId() == mapperId ) && InRange( address, wtSystem::ExpansionRomBase, 0xFFFF );
+		return prgRamBank;
 	}
 
 	void Clock() override
@@ -219,6 +225,27 @@ public:
 		return 0;
 	}
 
+	uint32_t GetPrgRomOffset( const uint16_t addr ) const override
+	{
+		if ( addr < 0x8000 ) {
+			return InvalidRomOffset;
+		}
+
+		const uint8_t banks[ 4 ] = { bank0, bank1, bank2, bank3 };
+		const uint8_t window = ( addr >> 13 ) & 0x03;
+		return system->cart->GetPrgRomOffset( banks[ window ], KB( 8 ) ) + ( addr & 0x1FFF );
+	}
+
+	uint32_t GetChrRomOffset( const uint16_t addr ) const override
+	{
+		if ( system->cart->HasChrRam() || ( addr > 0x1FFF ) ) {
+			return InvalidRomOffset;
+		}
+
+		const uint8_t banks[ 8 ] = { chrBank0, chrBank1, chrBank2, chrBank3, chrBank4, chrBank5, chrBank6, chrBank7 };
+		return system->cart->GetChrRomOffset( banks[ addr >> 10 ], KB_1 ) + ( addr & 0x03FF );
+	}
+
 	uint8_t	ReadChrRom( const uint16_t addr ) const override
 	{
 		if ( system->cart->HasChrRam() && InRange( addr, 0x0000, 0x1FFF ) ) {
@@ -327,26 +354,31 @@ public:
 		return 0;
 	}
 
-	void Serialize( Serializer& serializer ) override
+	MAPPER_STATE_VISITORS()
+
+	template<class V>
+	void Visit( V& visitor )
 	{
-		serializer.Next8b( irqLatch );
-		serializer.Next8b( irqCounter );
-		serializer.Next8b( bankSelect.byte );
-		serializer.Next8b( bank0 );
-		serializer.Next8b( bank1 );
-		serializer.Next8b( bank2 );
-		serializer.Next8b( bank3 );
-		serializer.Next8b( chrBank0 );
-		serializer.Next8b( chrBank1 );
-		serializer.Next8b( chrBank2 );
-		serializer.Next8b( chrBank3 );
-		serializer.Next8b( chrBank4 );
-		serializer.Next8b( chrBank5 );
-		serializer.Next8b( chrBank6 );
-		serializer.Next8b( chrBank7 );
-		serializer.NextBool( irqEnable );
-		serializer.NextArray( reinterpret_cast<uint8_t*>( &R[ 0 ] ), 8 * sizeof( R[ 0 ] ) );
-		serializer.NextArray( reinterpret_cast<uint8_t*>( &prgRamBank[ 0 ] ), KB(8) );
-		serializer.NextArray( reinterpret_cast<uint8_t*>( &chrRam[ 0 ] ), PPU::PatternTableMemorySize );
+		visitor.Field( irqLatch );
+		visitor.Field( irqCounter );
+		visitor.Field( bankSelect.byte );
+		visitor.Field( bank0 );
+		visitor.Field( bank1 );
+		visitor.Field( bank2 );
+		visitor.Field( bank3 );
+		visitor.Field( chrBank0 );
+		visitor.Field( chrBank1 );
+		visitor.Field( chrBank2 );
+		visitor.Field( chrBank3 );
+		visitor.Field( chrBank4 );
+		visitor.Field( chrBank5 );
+		visitor.Field( chrBank6 );
+		visitor.Field( chrBank7 );
+		visitor.Field( irqEnable );
+		visitor.Array( &R[ 0 ], 8 * sizeof( R[ 0 ] ) );
+		visitor.BeginLabel( STATE_SRAM_LABEL );
+		visitor.Array( &prgRamBank[ 0 ], KB(8) );
+		visitor.EndLabel( STATE_SRAM_LABEL );
+		visitor.Array( &chrRam[ 0 ], PPU::PatternTableMemorySize );
 	}
 };
\ No newline at end of file
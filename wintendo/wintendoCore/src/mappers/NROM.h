@@ -26,12 +26,16 @@
 #include "../common.h"
 #include "../system/NesSystem.h"
 
-class NROM : public wtMapper
+class NROM final : public wtMapper
 {
 private:
-	uint8_t*	prgBanks[2];
-	uint8_t*	chrBank;
+	const uint8_t*	prgBanks[2];
+	const uint8_t*	chrBank;
+	uint8_t			chrRam[ PPU::PatternTableMemorySize ];
+	uint8_t			prgRam[ KB( 8 ) ]; // Family Basic style $6000-$7FFF, blargg's test ROMs report through it
 public:
+	static const mapperType_t Type = mapperType_t::NROM;
+
 	NROM( const uint32_t _mapperId )
 	{
 		mapperId = _mapperId;
@@ -45,25 +49,81 @@ public:
 		const uint8_t bank1 = ( system->cart->GetPrgBankCount() == 1 ) ? 0 : 1;
 		prgBanks[ 0 ] = system->cart->GetPrgRomBank( 0 );
 		prgBanks[ 1 ] = system->cart->GetPrgRomBank( bank1 );
+		memset( prgRam, 0, sizeof( prgRam ) );
 		return 0;
 	};
 
 	uint8_t OnLoadPpu() override
 	{
-		chrBank = system->cart->GetChrRomBank( 0 );
+		if( system->cart->HasChrRam() ) {
+			chrBank = chrRam;
+		} else {
+			chrBank = system->cart->GetChrRomBank( 0 );
+		}
+		memset( chrRam, 0, sizeof( chrRam ) );
 		return 0;
 	};
 
 	uint8_t	ReadRom( const uint16_t addr ) const override
 	{
+		if ( InRange( addr, wtSystem::SramBase, wtSystem::SramEnd ) ) {
+			return prgRam[ addr - wtSystem::SramBase ];
+		}
+
 		const uint8_t bank = ( addr >> 14 ) & 0x01;
 		const uint16_t offset = ( addr & ( wtSystem::BankSize - 1 ) );
 
 		return prgBanks[ bank ][ offset ];
 	}
 
+	uint32_t GetPrgRomOffset( const uint16_t addr ) const override
+	{
+		if ( addr < wtSystem::Bank0 ) {
+			return InvalidRomOffset;
+		}
+		const uint8_t bank = ( addr >> 14 ) & 0x01;
+		return system->cart->GetPrgRomOffset( bank ) + ( addr & ( wtSystem::BankSize - 1 ) );
+	}
+
+	uint32_t GetChrRomOffset( const uint16_t addr ) const override
+	{
+		return system->cart->HasChrRam() ? InvalidRomOffset : ( addr & 0x1FFF );
+	}
+
 	uint8_t	ReadChrRom( const uint16_t addr ) const override
 	{
 		return chrBank[ addr ];
 	}
+
+	uint8_t	 WriteChrRam( const uint16_t addr, const uint8_t value ) override
+	{
+		if ( InRange( addr, 0x0000, 0x1FFF ) && system->cart->HasChrRam() ) {
+			chrRam[ addr ] = value;
+			return 1;
+		}
+		return 0;
+	}
+
+	uint8_t Write( const uint16_t addr, const uint8_t value ) override
+	{
+		prgRam[ ( addr - wtSystem::SramBase ) & ( KB( 8 ) - 1 ) ] = value;
+		return 0;
+	}
+
+	// 'addr' already has the index register added
+	bool InWriteWindow( const uint16_t addr, const uint16_t /*offset*/ ) const override
+	{
+		return InRange( addr, wtSystem::SramBase, wtSystem::SramEnd );
+	}
+
+	MAPPER_STATE_VISITORS()
+
+	template<class V>
+	void Visit( V& visitor )
+	{
+		visitor.Array( prgRam, KB( 8 ) );
+		if( system->cart->HasChrRam() ) {
+			visitor.Array( chrRam, PPU::PatternTableMemorySize );
+		}
+	}
 };
\ No newline at end of file
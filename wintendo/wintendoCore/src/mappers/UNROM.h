@@ -26,14 +26,16 @@
 #include "../common.h"
 #include "../system/NesSystem.h"
 
-class UNROM : public wtMapper
+class UNROM final : public wtMapper
 {
 private:
 	uint8_t		bank;
 	uint8_t		chrRam[ PPU::PatternTableMemorySize ];
-	uint8_t*	prgBanks[ 2 ];
-	uint8_t*	chrBank;
+	const uint8_t*	prgBanks[ 2 ];
+	const uint8_t*	chrBank;
 public:
+	static const mapperType_t Type = mapperType_t::UNROM;
+
 	UNROM( const uint32_t _mapperId )
 	{
 		mapperId = _mapperId;
@@ -59,7 +61,7 @@ public:
 		} else {
 			chrBank = system->cart->GetChrRomBank( 0 );
 		}
-		memset( chrRam, 0, sizeof( PPU::PatternTableMemorySize ) );
+		memset( chrRam, 0, sizeof( chrRam ) );
 		return 0;
 	};
 
@@ -71,6 +73,21 @@ public:
 		return prgBanks[ bank ][ offset ];
 	}
 
+	uint32_t GetPrgRomOffset( const uint16_t addr ) const override
+	{
+		if ( addr < wtSystem::Bank0 ) {
+			return InvalidRomOffset;
+		}
+		const uint8_t lastBank = ( system->cart->h.prgRomBanks - 1 );
+		const uint8_t romBank = ( addr >= wtSystem::Bank1 ) ? lastBank : bank;
+		return system->cart->GetPrgRomOffset( romBank ) + ( addr & ( wtSystem::BankSize - 1 ) );
+	}
+
+	uint32_t GetChrRomOffset( const uint16_t addr ) const override
+	{
+		return system->cart->HasChrRam() ? InvalidRomOffset : ( addr & 0x1FFF );
+	}
+
 	uint8_t	ReadChrRom( const uint16_t addr ) const override
 	{
 		return chrBank[ addr ];
@@ -92,21 +109,23 @@ public:
 		return 0;
 	};
 
-	bool InWriteWindow( const uint16_t addr, const uint16_t offset ) const override
+	bool InWriteWindow( const uint16_t addr, const uint16_t /*offset*/ ) const override
 	{
-		const uint16_t address = ( addr + offset );
-		return InRange( address, wtSystem::ExpansionRomBase, wtSystem::Bank1End );
+		return InRange( addr, wtSystem::ExpansionRomBase, wtSystem::Bank1End );
 	}
 
-	void Serialize( Serializer& serializer ) override
+	MAPPER_STATE_VISITORS()
+
+	template<class V>
+	void Visit( V& visitor )
 	{
-		serializer.Next8b( bank );
+		visitor.Field( bank );
 
 		if( system->cart->HasChrRam() ) {
-			serializer.NextArray( chrRam, PPU::PatternTableMemorySize );
+			visitor.Array( chrRam, PPU::PatternTableMemorySize );
 		}
 
-		if( serializer.GetMode() == serializeMode_t::LOAD )
+		if( V::Loading )
 		{
 			prgBanks[ 0 ] = system->cart->GetPrgRomBank( bank );
 			if ( !system->cart->HasChrRam() ) {
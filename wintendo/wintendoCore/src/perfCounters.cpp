@@ -0,0 +1,76 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <cstring>
+#include "perfCounters.h"
+
+wtPerfCounters::wtPerfCounters()
+{
+	memset( epochTicks, 0, sizeof( epochTicks ) );
+	memset( window, 0, sizeof( window ) );
+	windowIx = 0;
+	windowCount = 0;
+	calibrationTicks = Now();
+	calibrationTime = std::chrono::steady_clock::now();
+}
+
+
+void wtPerfCounters::EndEpoch( perfStat_t stats[ PERF_COUNTER_COUNT ] )
+{
+	// The tick rate is re-derived from the whole run so far, which settles quickly and needs no startup stall
+	const uint64_t ticks = Now() - calibrationTicks;
+	const double elapsedUs = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - calibrationTime ).count();
+	const double usPerTick = ( ticks > 0 ) ? ( elapsedUs / ticks ) : 0.0;
+
+	windowCount = ( windowCount < WindowSize ) ? ( windowCount + 1 ) : WindowSize;
+
+	for ( uint32_t i = 0; i < PERF_COUNTER_COUNT; ++i )
+	{
+		const float us = static_cast<float>( epochTicks[ i ] * usPerTick );
+		window[ i ][ windowIx ] = us;
+		epochTicks[ i ] = 0;
+
+		float sorted[ WindowSize ] = {};
+		std::copy( window[ i ], window[ i ] + windowCount, sorted );
+
+		const uint32_t p99Ix = ( windowCount * 99 ) / 100;
+		std::nth_element( sorted, sorted + p99Ix, sorted + windowCount );
+
+		float sum = 0.0f;
+		float minUs = window[ i ][ 0 ];
+		for ( uint32_t s = 0; s < windowCount; ++s )
+		{
+			sum += window[ i ][ s ];
+			minUs = std::min( minUs, window[ i ][ s ] );
+		}
+
+		stats[ i ].lastUs	= us;
+		stats[ i ].minUs	= minUs;
+		stats[ i ].avgUs	= sum / windowCount;
+		stats[ i ].p99Us	= sorted[ p99Ix ];
+	}
+
+	windowIx = ( windowIx + 1 ) % WindowSize;
+}
@@ -0,0 +1,106 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include "common.h"
+
+#if defined( _M_X64 ) || defined( _M_IX86 )
+#include <intrin.h>
+#elif defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+// Per-subsystem time accumulators read from the TSC, or steady_clock where there
+// is none. Ticks are summed over a RunEpoch and converted to microseconds once,
+// so the hot paths only ever read the counter and add.
+class wtPerfCounters
+{
+public:
+	static const uint32_t WindowSize = 128;
+
+	wtPerfCounters();
+
+	FORCE_INLINE static uint64_t Now()
+	{
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __x86_64__ ) || defined( __i386__ )
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>( std::chrono::steady_clock::now().time_since_epoch().count() );
+#endif
+	}
+
+	FORCE_INLINE void Add( const perfCounter_t counter, const uint64_t ticks )
+	{
+		epochTicks[ counter ] += ticks;
+	}
+
+	// Charges the time since 'lap' to counter and restarts it; back-to-back stages share one read
+	FORCE_INLINE void Lap( const perfCounter_t counter, uint64_t& lap )
+	{
+		const uint64_t now = Now();
+		epochTicks[ counter ] += now - lap;
+		lap = now;
+	}
+
+	void EndEpoch( perfStat_t stats[ PERF_COUNTER_COUNT ] );
+
+private:
+	uint64_t								epochTicks[ PERF_COUNTER_COUNT ];
+	float									window[ PERF_COUNTER_COUNT ][ WindowSize ];
+	uint32_t								windowIx;
+	uint32_t								windowCount;
+	uint64_t								calibrationTicks;
+	std::chrono::steady_clock::time_point	calibrationTime;
+};
+
+
+class wtPerfScope
+{
+public:
+	FORCE_INLINE wtPerfScope( wtPerfCounters& perfCounters, const perfCounter_t perfCounter ) :
+		counters( perfCounters ), counter( perfCounter ), start( wtPerfCounters::Now() ) {}
+
+	FORCE_INLINE ~wtPerfScope()
+	{
+		counters.Add( counter, wtPerfCounters::Now() - start );
+	}
+
+private:
+	wtPerfCounters&	counters;
+	perfCounter_t	counter;
+	uint64_t		start;
+};
+
+#if PERF_COUNTERS == 1
+#define PERF_SCOPE( counters, counter )		wtPerfScope perfScope_##counter( counters, counter )
+#define PERF_LAP_BEGIN( lap )				uint64_t lap = wtPerfCounters::Now()
+#define PERF_LAP( counters, counter, lap )	counters.Lap( counter, lap )
+#else
+#define PERF_SCOPE( counters, counter )
+#define PERF_LAP_BEGIN( lap )
+#define PERF_LAP( counters, counter, lap )
+#endif
@@ -24,6 +24,7 @@
 #include "../../stdafx.h"
 #include "apu.h"
 #include "../system/NesSystem.h"
+#include "../system/mapperDispatch.h"
 #include <algorithm>
 
 //#pragma optimize("", off)
@@ -409,6 +410,9 @@ void APU::SampleDmcBuffer()
 
 	if ( dmc.emptyBuffer && ( dmc.bytesRemaining > 0 ) ) {
 		dmc.sampleBuffer = system->ReadMemory( dmc.addr );
+		if ( system->IsCdlLogging() ) {
+			system->LogCdlPrg( dmc.addr, CDL_PRG_PCM );
+		}
 		dmc.emptyBuffer = false;
 
 		if ( dmc.addr == 0xFFFF ) {
@@ -579,6 +583,12 @@ void APU::RunFrameClock( const bool halfClk, const bool quarterClk, const bool i
 }
 
 
+cpuCycle_t APU::GetCycle() const
+{
+	return cpuCycle;
+}
+
+
 bool APU::Step( const cpuCycle_t& nextCpuCycle )
 {
 	const apuCycle_t nextApuCycle = CpuToApuCycle( nextCpuCycle );
@@ -602,7 +612,9 @@ bool APU::Step( const cpuCycle_t& nextCpuCycle )
 			ExecChannelNoise();
 		}
 
-		Mixer();
+		if ( mixerEnabled ) {
+			Mixer();
+		}
 
 		++cpuCycle;
 		++frameSeqTick;
@@ -677,6 +689,8 @@ void APU::GetDebugInfo( apuDebug_t& apuDebug )
 
 void APU::Begin()
 {
+	const bool noAudio = ( system->GetConfig()->sys.flags & emulationFlags_t::NO_AUDIO ) != 0;
+	mixerEnabled = !system->IsOutputSuppressed() && !noAudio;
 }
 
 
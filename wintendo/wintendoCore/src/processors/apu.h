@@ -295,7 +295,7 @@ public:
 		dbgInfo.sweepNegate		= regRamp.sem.negate;
 	}
 
-	void Serialize( Serializer& serializer );
+	template<class V> void Visit( V& visitor );
 };
 
 
@@ -339,7 +339,7 @@ public:
 		dbgInfo.reg400B_counter	= regTimer.sem0.counter;
 	}
 
-	void Serialize( Serializer& serializer );
+	template<class V> void Visit( V& visitor );
 };
 
 
@@ -388,7 +388,7 @@ public:
 		dbgInfo.reg400E_length	= regFreq2.sem.length;
 	}
 
-	void Serialize( Serializer& serializer );
+	template<class V> void Visit( V& visitor );
 };
 
 
@@ -464,7 +464,7 @@ public:
 		dbgInfo.reg4013_length	= regLength;
 	}
 
-	void Serialize( Serializer& serializer );
+	template<class V> void Visit( V& visitor );
 };
 
 
@@ -552,6 +552,7 @@ private:
 	apuOutput_t*	soundOutput;
 	apuOutput_t		soundOutputBuffers[ SoundBufferCnt ];
 	wtSystem*		system;
+	bool			mixerEnabled;	// Latched per run in Begin, off while a seek fast-forwards or with NO_AUDIO
 
 public:	
 	apuOutput_t*	frameOutput; // TODO: make private
@@ -590,6 +591,7 @@ public:
 
 		frameSeqTick		= cpuCycle_t( 0 );
 		frameOutput			= nullptr;
+		mixerEnabled		= true;
 
 		for ( uint32_t i = 0; i < SoundBufferCnt; ++i )
 		{
@@ -610,6 +612,7 @@ public:
 	void		RegisterSystem( wtSystem* system );
 
 	bool		Step( const cpuCycle_t& nextCpuCycle );
+	cpuCycle_t	GetCycle() const;
 	void		End();
 	void		WriteReg( const uint16_t addr, const uint8_t value );
 	uint8_t		ReadReg( const uint16_t addr );
@@ -619,7 +622,8 @@ public:
 	void		GetDebugInfo( apuDebug_t& apuDebug );
 	void		SampleDmcBuffer();
 
-	void		Serialize( Serializer& serializer );
+	template<class V>
+	void		Visit( V& visitor );
 
 private:
 	void		ExecPulseChannel( PulseChannel& pulse );
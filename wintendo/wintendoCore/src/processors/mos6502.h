@@ -29,6 +29,7 @@
 #include <vector>
 #include "../common.h"
 #include "../debug.h"
+#include "../profiler.h"
 
 class	Cpu6502;
 struct	OpCodeMap;
@@ -90,7 +91,7 @@ struct opInfo_t
 
 #define ADDR_MODE_DECL( name )							struct addrMode##name													\
 														{																		\
-															static const addrMode_t addrMode = addrMode_t::##name;				\
+															static const addrMode_t addrMode = addrMode_t::name;				\
 															Cpu6502& cpu;														\
 															addrMode##name( Cpu6502& _cpu ) : cpu( _cpu ) {};					\
 															inline void operator()( struct opState_t& opState );				\
@@ -101,12 +102,12 @@ struct opInfo_t
 #define _OP_ADDR( num, name, addrFunc, addrressMode, ops, advance, cycles, hasExtraCycle, isIllegal )							\
 														{																		\
 															opLUT[num].mnemonic		= #name;									\
-															opLUT[num].type			= opType_t::##name;							\
-															opLUT[num].addrMode		= addrMode_t::##addrressMode;				\
+															opLUT[num].type			= opType_t::name;							\
+															opLUT[num].addrMode		= addrMode_t::addrressMode;				\
 															opLUT[num].operands		= ops;										\
 															opLUT[num].baseCycles	= cycles;									\
 															opLUT[num].pcInc		= advance;									\
-															opLUT[num].func			= &Cpu6502::##name<addrMode##addrFunc>;		\
+															opLUT[num].func			= &Cpu6502::name<addrMode##addrFunc>;		\
 															opLUT[num].illegal		= isIllegal;								\
 															opLUT[num].extraCycle	= hasExtraCycle;							\
 														}
@@ -130,6 +131,18 @@ enum statusBit_t
 };
 
 
+// Optional per-instruction work compiled into its own core instantiation
+enum cpuHookBits_t : uint32_t
+{
+	CPU_HOOK_NONE		= 0,
+	CPU_HOOK_TRACE		= ( 1 << 0 ),
+	CPU_HOOK_PROFILE	= ( 1 << 1 ),
+	CPU_HOOK_CDL		= ( 1 << 2 ),
+	CPU_HOOK_BREAK		= ( 1 << 3 ),
+	CPU_HOOK_ALL		= CPU_HOOK_TRACE | CPU_HOOK_PROFILE | CPU_HOOK_CDL | CPU_HOOK_BREAK,
+};
+
+
 union statusReg_t
 {
 	struct semantic
@@ -196,6 +209,7 @@ public:
 #endif
 	bool				resetLog;
 	wtLog				dbgLog;
+	wtProfiler			profiler;
 
 	// TODO: move to system
 	mutable uint16_t	irqAddr;
@@ -211,6 +225,8 @@ public:
 	statusReg_t			P;
 	uint16_t			PC;
 
+	uint64_t			instrCount;
+
 	opInfo_t			opLUT[NumInstructions];
 
 private:
@@ -232,31 +248,30 @@ public:
 
 		cycle = cpuCycle_t( 7 ); // FIXME: +7 is a hack to match test log, +21 on PPU
 
+		irqAddr = 0;
 		interruptRequestNMI = false;
 		interruptRequest = false;
 		oamInProcess = false;
 		dmcTransfer = false;
 
 		halt = false;
+		instrCount = 0;
 
 		resetLog = false;
 		dbgLog.Reset( 1 );
 	}
 
-	Cpu6502()
-	{
-		resetLog = false;
-		Reset();
-		BuildOpLUT();
-	}
+	// Out of line so the op table, and the Read/Write templates it instantiates, stay in mos6502.cpp
+	Cpu6502();
 
+	template<uint32_t Hooks>
 	bool Step( const cpuCycle_t& nextCycle );
 	void RegisterSystem( wtSystem* sys );
 	bool IsTraceLogOpen() const;
-	void StartTraceLog( const uint32_t frameCount );
+	void StartTraceLog( const uint32_t frameCount, const std::string& spillPath = "" );
 	void StopTraceLog();
 
-	void Serialize( Serializer& serializer );
+	template<class V> void Visit( V& visitor );
 
 private:
 	// All ops included here
@@ -277,6 +292,7 @@ private:
 	ADDR_MODE_DECL( JmpIndirect )
 	uint16_t	JumpImmediateAddr( const uint16_t addr );
 
+	template<uint32_t Hooks>
 	cpuCycle_t	Exec();
 
 	static bool	CheckSign( const uint16_t checkValue );
@@ -312,5 +328,9 @@ private:
 	template <class AddrFunctor>
 	void		Write( opState_t& opState, const uint8_t value );
 
+	void		LogDataAccess( const opInfo_t& op, const opState_t& opState );
+	void		CheckDataBreakpoints( const opInfo_t& op, const opState_t& opState, const uint16_t instrAddr );
+
+	template<uint32_t Hooks>
 	cpuCycle_t	OpExec( const uint16_t instrAddr, const uint8_t opCode );
 };
\ No newline at end of file
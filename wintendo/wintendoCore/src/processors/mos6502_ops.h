@@ -301,14 +301,12 @@ OP_DEF( ORA )
 OP_DEF( JMP )
 {
 	PC = ReadAddressOperand( o );
-	DEBUG_ADDR_JMP( PC )
 }
 
 OP_DEF( JMPI )
 {
 	const uint16_t addr = ReadAddressOperand( o );
 	PC = JumpImmediateAddr( addr );
-	DEBUG_ADDR_JMPI( addr, PC )
 }
 
 OP_DEF( JSR )
@@ -319,8 +317,6 @@ OP_DEF( JSR )
 	Push( retAddr & 0xFF );
 
 	PC = ReadAddressOperand( o );
-
-	DEBUG_ADDR_JSR( PC )
 }
 
 OP_DEF( BRK )
@@ -24,7 +24,6 @@
 #include "../../stdafx.h"
 #include <iostream>
 #include <iomanip>
-#include <Windows.h>
 #include <chrono>
 #include <thread>
 #include <fstream>
@@ -36,6 +35,7 @@
 #include "../debug.h"
 #include "mos6502.h"
 #include "../system/NesSystem.h"
+#include "../system/mapperDispatch.h"
 
 
 void PPU::WriteReg( const uint16_t addr, const uint8_t value )
@@ -174,6 +174,10 @@ void PPU::PPUDATA( const uint8_t value )
 {
 	if( DataportEnabled() )
 	{
+		if ( system->HasBreakpoints() ) {
+			system->CheckPpuBreakpoint( BREAK_WRITE, regV.byte2x );
+		}
+
 		registers[PPUREG_DATA] = value;
 
 		regStatus.current.sem.lastReadLsb = ( value & 0x1F );
@@ -186,6 +190,10 @@ void PPU::PPUDATA( const uint8_t value )
 
 uint8_t PPU::PPUDATA()
 {
+	if ( system->HasBreakpoints() ) {
+		system->CheckPpuBreakpoint( BREAK_READ, regV.byte2x );
+	}
+
 	uint8_t value = 0;
 	if ( regV.byte2x < 0x3EFF ) {
 		value = ppuReadBuffer;
@@ -195,7 +203,7 @@ uint8_t PPU::PPUDATA()
 
 	// TODO: when reading palettes, store mirrored NT data
 	// https://wiki.nesdev.com/w/index.php/PPU_programmer_reference#The_PPUDATA_read_buffer_.28post-fetch.29
-	ppuReadBuffer = ReadVram( regV.byte2x );
+	ppuReadBuffer = ReadVram( regV.byte2x, CDL_CHR_READ );
 	vramAccessed = true;
 
 	return value;
@@ -475,13 +483,16 @@ bool PPU::IsMemoryMapped( const uint16_t addr ) const
 }
 
 
-FORCE_INLINE uint8_t PPU::ReadVram( const uint16_t addr ) const
+uint8_t PPU::ReadVram( const uint16_t addr, const uint8_t cdlFlags ) const
 {
 	const uint16_t adjustedAddr = MirrorVram( addr );
 	assert( adjustedAddr < VirtualMemorySize );
 
 	if( InRange( adjustedAddr, 0x0000, 0x1FFF ) ) {
-		return system->cart->mapper->ReadChrRom( adjustedAddr );
+		if ( system->IsCdlLogging() ) {
+			system->LogCdlChr( adjustedAddr, cdlFlags );
+		}
+		return system->ReadChrRom( adjustedAddr );
 	} else if ( InRange( adjustedAddr, 0x2000, 0x3EFF ) ) {
 		return nt[ adjustedAddr - 0x2000 ];
 	} else if ( InRange( adjustedAddr, 0x3F00, 0x3F0F ) ) {
@@ -503,7 +514,7 @@ void PPU::WriteVram()
 		// assert( adjustedAddr < PhysicalMemorySize );
 
 		if ( InRange( adjustedAddr, 0x0000, 0x1FFF ) ) {
-			system->cart->mapper->WriteChrRam( adjustedAddr, registers[ PPUREG_DATA ] );
+			system->WriteChrRam( adjustedAddr, registers[ PPUREG_DATA ] );
 		} else if ( InRange( adjustedAddr, 0x2000, 0x3EFF ) ) {
 			nt[ adjustedAddr - 0x2000 ] = registers[ PPUREG_DATA ];
 		} else if ( InRange( adjustedAddr, 0x3F00, 0x3F0F ) ) {
@@ -674,10 +685,8 @@ void PPU::FillSpriteDebug( const spriteAttrib_t& attribs )
 }
 
 
-bool PPU::DrawSpritePixel( wtDisplayImage& fb, const spriteAttrib_t& attribs, const ppuImageIx_t& beam, const uint8_t bgPixel )
+uint8_t PPU::GetSpritePixel( const spriteAttrib_t& attribs, const ppuImageIx_t& beam )
 {
-	Pixel pixelColor;
-
 	wtPoint spritePt;
 
 	spritePt.x = beam.point.x - attribs.x;
@@ -709,7 +718,15 @@ bool PPU::DrawSpritePixel( wtDisplayImage& fb, const spriteAttrib_t& attribs, co
 		chrRom1 = GetChrRom8x8( attribs.tileId, 1, GetSpritePatternTableId(), spritePt.y );
 	}
 
-	const uint8_t finalPalette = GetChrRomPalette( chrRom0, chrRom1, spritePt.x );
+	return GetChrRomPalette( chrRom0, chrRom1, spritePt.x );
+}
+
+
+bool PPU::DrawSpritePixel( wtDisplayImage& fb, const spriteAttrib_t& attribs, const ppuImageIx_t& beam, const uint8_t bgPixel )
+{
+	Pixel pixelColor;
+
+	const uint8_t finalPalette = GetSpritePixel( attribs, beam );
 
 	const uint8_t colorIx = ReadVram( SpritePaletteAddr + attribs.palette + finalPalette );
 
@@ -973,6 +990,20 @@ uint32_t PPU::GetScanline() const
 }
 
 
+uint32_t PPU::GetScanlinesToFrameEnd() const
+{
+	static const int32_t FrameEndScanline = POSTRENDER_SCANLINE + 1;
+
+	if ( currentScanline < FrameEndScanline ) {
+		return ( FrameEndScanline - currentScanline );
+	}
+	if ( ( currentScanline == FrameEndScanline ) && !inVBlank ) {
+		return 0;
+	}
+	return ( SCANLINE_COUNT - currentScanline + FrameEndScanline );
+}
+
+
 ppuCycle_t PPU::GetCycle() const
 {
 	return cycle;
@@ -981,6 +1012,13 @@ ppuCycle_t PPU::GetCycle() const
 
 void PPU::Render()
 {
+	if ( system->IsOutputSuppressed() )
+	{
+		TestSprite0Hit();
+		++beam.index;
+		return;
+	}
+
 	const uint32_t imageIx = beam.index;
 
 	uint8_t bgPixel = 0;
@@ -1038,6 +1076,33 @@ void PPU::Render()
 }
 
 
+// Render without the frame buffer: sprite 0 hit is the only result the CPU can see
+void PPU::TestSprite0Hit()
+{
+	if ( !regMask.sem.showBg || !regMask.sem.showSprt || !system->GetConfig()->ppu.showBG ) {
+		return;
+	}
+
+	if ( ( beam.point.x < 8 ) && ( !regMask.sem.bgLeft || !regMask.sem.sprtLeft ) ) {
+		return;
+	}
+
+	// Evaluation walks OAM in order, so sprite 0 can only be the first secondary entry
+	const spriteAttrib_t& attribs = secondaryOAM[ 0 ];
+	if ( ( secondaryOamSpriteCnt == 0 ) || !attribs.sprite0 ) {
+		return;
+	}
+
+	if ( ( beam.point.x >= ( attribs.x + 8 ) ) || ( beam.point.x < attribs.x ) ) {
+		return;
+	}
+
+	if ( ( ( BgPipelineDecodePalette() & 0x03 ) != 0 ) && ( GetSpritePixel( attribs, beam ) != 0 ) ) {
+		regStatus.current.sem.spriteHit = true;
+	}
+}
+
+
 ppuCycle_t PPU::Exec()
 {
 	ppuCycle_t execCycles = ppuCycle_t( 0 );
@@ -1170,7 +1235,7 @@ ppuCycle_t PPU::Exec()
 	else if ( cycleCount == 260 )
 	{
 		if( RenderEnabled() ) {
-			system->cart->mapper->Clock(); // TODO: How big of a hack is this?
+			system->ClockMapper(); // TODO: How big of a hack is this?
 		}
 		++execCycles;
 	}
@@ -1196,7 +1261,7 @@ ppuCycle_t PPU::Exec()
 	}
 	else if ( cycleCount == 340 )
 	{
-		currentScanline = ( currentScanline + 1 ) % PRERENDER_SCANLINE;
+		currentScanline = ( currentScanline + 1 ) % SCANLINE_COUNT;
 
 		++execCycles;
 	}
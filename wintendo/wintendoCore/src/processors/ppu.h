@@ -23,6 +23,7 @@
 
 #pragma once
 #include "../system/cart.h"
+#include "../cdl.h"
 
 union Tomtendo::Pixel;
 struct Tomtendo::RGBA;
@@ -184,6 +185,7 @@ enum ppuScanLine_t
 {
 	POSTRENDER_SCANLINE	= 240,
 	PRERENDER_SCANLINE	= 261,
+	SCANLINE_COUNT		= 262, // NTSC: 240 visible, post-render, 20 vblank, pre-render
 };
 
 
@@ -305,10 +307,11 @@ public:
 	void			DrawDebugPalette( wtPaletteImage& imageBuffer );
 
 	void			WriteVram();
-	uint8_t			ReadVram( const uint16_t addr ) const;
+	uint8_t			ReadVram( const uint16_t addr, const uint8_t cdlFlags = CDL_CHR_RENDERED ) const;
 	bool			IsMemoryMapped( const uint16_t addr ) const;
 	ppuCycle_t		GetCycle() const;
 	uint32_t		GetScanline() const;
+	uint32_t		GetScanlinesToFrameEnd() const; // Whole lines before the next ToggleFrame
 
 	ppuCycle_t		Exec();
 	bool			Step( const ppuCycle_t& nextCycle );	
@@ -362,7 +365,13 @@ public:
 		regStatus.latched.byte	= 0;
 		regStatus.hasLatch		= false;
 
+		secondaryOamSpriteCnt	= 0;
+
+		memset( primaryOAM, 0, sizeof( primaryOAM ) );
 		memset( secondaryOAM, 0, sizeof( secondaryOAM ) );
+		memset( &plShifts, 0, sizeof( plShifts ) );
+		memset( &plLatches, 0, sizeof( plLatches ) );
+		memset( registers, 0, sizeof( registers ) );
 		memset( nt, 0, KB(2) );
 		memset( imgPal, 0, PPU::PaletteColorNumber );
 		memset( sprPal, 0, PPU::PaletteColorNumber );
@@ -373,7 +382,8 @@ public:
 	void			End();
 	void			RegisterSystem( wtSystem* sys );
 
-	void			Serialize( Serializer& serializer );
+	template<class V>
+	void			Visit( V& visitor );
 
 private:
 	static uint8_t	GetChrRomPalette( const uint8_t plane0, const uint8_t plane1, const uint8_t col );
@@ -386,6 +396,7 @@ private:
 	void			DrawTile( wtNameTableImage& imageBuffer, const wtRect& imageRect, const wtPoint& nametableTile, const uint32_t ntId, const uint32_t ptrnTableId );
 	void			DrawChrRomTile( wtRawImageInterface* imageBuffer, const wtRect& imageRect, const RGBA palette[4], const uint32_t tileId, const uint32_t tableId, const bool cartBank, const bool is8x16 = false, const bool isUpper = false ) const;
 	bool			DrawSpritePixel( wtDisplayImage& fb, const spriteAttrib_t& attribs, const ppuImageIx_t& index, const uint8_t bgPixel );
+	uint8_t			GetSpritePixel( const spriteAttrib_t& attribs, const ppuImageIx_t& index );
 
 	bool			BgDataFetchEnabled();
 	void			BgPipelineShiftRegisters();
@@ -398,6 +409,7 @@ private:
 	void			LoadSecondaryOAM();
 	void			DMA( const uint16_t address );
 	void			Render();
+	void			TestSprite0Hit();
 	spriteAttrib_t	GetSpriteData( const uint8_t spriteId, const uint8_t oam[] );
 
 	uint8_t			GetBgPatternTableId();
@@ -0,0 +1,258 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "profiler.h"
+#include "disassembler.h"
+#include "processors/mos6502.h"
+
+using namespace std;
+
+wtProfiler::wtProfiler()
+{
+	frameIx = 0;
+	framesLeft = 0;
+	perFrame = false;
+	open = false;
+	finished = false;
+}
+
+
+void wtProfiler::Start( const uint32_t prgRomSize, const uint32_t frameCount, const bool perFrameHistograms )
+{
+	Clear();
+
+	histogram.assign( RamSlots + prgRomSize, 0 );
+	framesLeft = frameCount;
+	perFrame = perFrameHistograms;
+	open = true;
+}
+
+
+void wtProfiler::Stop()
+{
+	if ( !open ) {
+		return;
+	}
+
+	// Keep the partial frame so a manual stop doesn't drop the tail
+	if ( perFrame ) {
+		NewFrame();
+	}
+
+	open = false;
+	finished = true;
+}
+
+
+void wtProfiler::Clear()
+{
+	histogram.clear();
+	frames.clear();
+	frameIx = 0;
+	framesLeft = 0;
+	open = false;
+	finished = false;
+}
+
+
+void wtProfiler::NewFrame()
+{
+	if ( !open ) {
+		return;
+	}
+
+	if ( perFrame )
+	{
+		frame_t frame;
+		frame.frame = frameIx;
+		frame.cycles = GatherHits( frame.hits );
+		frames.push_back( std::move( frame ) );
+		fill( histogram.begin(), histogram.end(), 0 );
+	}
+
+	++frameIx;
+
+	// Zero frames runs until stopped
+	if ( ( framesLeft > 0 ) && ( --framesLeft == 0 ) )
+	{
+		open = false;
+		finished = true;
+	}
+}
+
+
+bool wtProfiler::IsOpen() const
+{
+	return open;
+}
+
+
+bool wtProfiler::IsFinished() const
+{
+	return finished;
+}
+
+
+uint64_t wtProfiler::GatherHits( std::vector<profileHit_t>& hits ) const
+{
+	uint64_t total = 0;
+	const uint32_t slotCount = static_cast<uint32_t>( histogram.size() );
+	for ( uint32_t slot = 0; slot < slotCount; ++slot )
+	{
+		if ( histogram[ slot ] == 0 ) {
+			continue;
+		}
+		hits.push_back( { slot, histogram[ slot ] } );
+		total += histogram[ slot ];
+	}
+
+	sort( hits.begin(), hits.end(), []( const profileHit_t& a, const profileHit_t& b ) { return a.cycles > b.cycles; } );
+	return total;
+}
+
+
+static bool FetchInstruction( const uint32_t slot, const profileSource_t& source, uint8_t bytes[ 3 ] )
+{
+	for ( uint32_t i = 0; i < 3; ++i )
+	{
+		if ( slot >= wtProfiler::RamSlots )
+		{
+			const uint32_t offset = slot - wtProfiler::RamSlots + i;
+			if ( offset >= source.prgRomSize ) {
+				return ( i > 0 );
+			}
+			bytes[ i ] = source.prgRom[ offset ];
+		}
+		else
+		{
+			const uint32_t address = slot + i;
+			if ( address < 0x2000 ) {
+				bytes[ i ] = source.ram[ address & 0x07FF ];
+			} else if ( ( address >= 0x6000 ) && ( address < 0x8000 ) && ( source.sram != nullptr ) ) {
+				bytes[ i ] = source.sram[ address - 0x6000 ];
+			} else {
+				return ( i > 0 );
+			}
+		}
+	}
+	return true;
+}
+
+
+void wtProfiler::WriteHit( std::string& out, const profileFormat_t format, const profileHit_t& hit, const uint64_t total, const profileSource_t& source )
+{
+	const bool isRom = ( hit.slot >= RamSlots );
+	const uint32_t romOffset = hit.slot - RamSlots;
+	const int32_t bank = isRom ? static_cast<int32_t>( romOffset / KB( 16 ) ) : -1;
+	const uint32_t address = isRom ? ( romOffset % KB( 16 ) ) : hit.slot;
+	const double percent = ( total > 0 ) ? ( 100.0 * hit.cycles / total ) : 0.0;
+
+	char bytesText[ 16 ] = "";
+	char asmText[ 32 ] = "";
+	uint8_t bytes[ 3 ] = {};
+	if ( FetchInstruction( hit.slot, source, bytes ) )
+	{
+		const opInfo_t& op = source.opLUT[ bytes[ 0 ] ];
+		char* b = bytesText;
+		for ( uint32_t i = 0; i <= op.operands; ++i ) {
+			b += snprintf( b, sizeof( bytesText ) - ( b - bytesText ), ( i == 0 ) ? "%02X" : " %02X", bytes[ i ] );
+		}
+		wtDisassembler::FormatInstruction( asmText, sizeof( asmText ), bytes, op, address );
+	}
+
+	char bankText[ 16 ] = "RAM";
+	if ( isRom || ( format == profileFormat_t::JSON ) ) {
+		snprintf( bankText, sizeof( bankText ), "%d", bank );
+	}
+
+	char line[ 192 ];
+	if ( format == profileFormat_t::JSON )
+	{
+		snprintf( line, sizeof( line ), "{\"bank\":%s,\"address\":\"%04X\",\"cycles\":%llu,\"percent\":%.3f,\"bytes\":\"%s\",\"asm\":\"%s\"}",
+			bankText, address, static_cast<unsigned long long>( hit.cycles ), percent, bytesText, asmText );
+	}
+	else
+	{
+		snprintf( line, sizeof( line ), "%s,%04X,%llu,%.3f,%s,%s\n",
+			bankText, address, static_cast<unsigned long long>( hit.cycles ), percent, bytesText, asmText );
+	}
+	out += line;
+}
+
+
+void wtProfiler::Export( std::string& out, const profileFormat_t format, const profileSource_t& source ) const
+{
+	// A per-run profile is exported as a single frame holding the whole histogram
+	std::vector<frame_t> runFrame;
+	const std::vector<frame_t>* exportFrames = &frames;
+	if ( frames.empty() )
+	{
+		runFrame.resize( 1 );
+		runFrame[ 0 ].frame = 0;
+		runFrame[ 0 ].cycles = GatherHits( runFrame[ 0 ].hits );
+		exportFrames = &runFrame;
+	}
+	const bool framed = !frames.empty();
+
+	if ( format == profileFormat_t::JSON ) {
+		out += "{\"frames\":[\n";
+	} else {
+		out += framed ? "frame,bank,address,cycles,percent,bytes,asm\n" : "bank,address,cycles,percent,bytes,asm\n";
+	}
+
+	for ( size_t i = 0; i < exportFrames->size(); ++i )
+	{
+		const frame_t& frame = ( *exportFrames )[ i ];
+		char prefix[ 64 ];
+
+		if ( format == profileFormat_t::JSON )
+		{
+			snprintf( prefix, sizeof( prefix ), "{\"frame\":%u,\"cycles\":%llu,\"hits\":[\n", frame.frame, static_cast<unsigned long long>( frame.cycles ) );
+			out += prefix;
+		}
+
+		for ( size_t h = 0; h < frame.hits.size(); ++h )
+		{
+			if ( framed && ( format == profileFormat_t::CSV ) )
+			{
+				snprintf( prefix, sizeof( prefix ), "%u,", frame.frame );
+				out += prefix;
+			}
+			WriteHit( out, format, frame.hits[ h ], frame.cycles, source );
+			if ( format == profileFormat_t::JSON ) {
+				out += ( ( h + 1 ) < frame.hits.size() ) ? ",\n" : "\n";
+			}
+		}
+
+		if ( format == profileFormat_t::JSON ) {
+			out += ( ( i + 1 ) < exportFrames->size() ) ? "]},\n" : "]}\n";
+		}
+	}
+
+	if ( format == profileFormat_t::JSON ) {
+		out += "]}\n";
+	}
+}
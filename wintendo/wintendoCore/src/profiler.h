@@ -0,0 +1,104 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "common.h"
+
+struct opInfo_t;
+
+enum class profileFormat_t : uint8_t
+{
+	CSV,
+	JSON,
+};
+
+struct profileHit_t
+{
+	uint32_t	slot;
+	uint64_t	cycles;
+};
+
+// What Export() needs to annotate hits with disassembly
+struct profileSource_t
+{
+	const opInfo_t*	opLUT;
+	const uint8_t*	prgRom;
+	uint32_t		prgRomSize;
+	const uint8_t*	ram;		// $0000-$07FF
+	const uint8_t*	sram;		// $6000-$7FFF, may be null
+};
+
+// Cycle histogram over every place an instruction can live. PCs below $8000
+// are keyed by address; banked PRG ROM is keyed by offset into the image so
+// the same PC in two different banks lands in two different slots.
+class wtProfiler
+{
+public:
+	static const uint32_t RamSlots = 0x8000;
+
+	wtProfiler();
+
+	void				Start( const uint32_t prgRomSize, const uint32_t frameCount, const bool perFrame );
+	void				Stop();
+	void				Clear();
+	void				NewFrame();
+	bool				IsOpen() const;
+	bool				IsFinished() const;
+	void				Export( std::string& out, const profileFormat_t format, const profileSource_t& source ) const;
+
+	static FORCE_INLINE uint32_t Slot( const uint16_t address, const uint32_t romOffset )
+	{
+		return ( romOffset == InvalidRomOffset ) ? ( address & ( RamSlots - 1 ) ) : ( RamSlots + romOffset );
+	}
+
+	FORCE_INLINE void Add( const uint32_t slot, const cpuCycle_t& cycles )
+	{
+		// The profile can close on a frame toggle partway through a Run(), the hook stays on until it returns
+		if ( open ) {
+			histogram[ slot ] += cycles.count();
+		}
+	}
+
+private:
+	struct frame_t
+	{
+		uint32_t					frame;
+		uint64_t					cycles;
+		std::vector<profileHit_t>	hits;
+	};
+
+	uint64_t			GatherHits( std::vector<profileHit_t>& hits ) const;
+	static void			WriteHit( std::string& out, const profileFormat_t format, const profileHit_t& hit, const uint64_t total, const profileSource_t& source );
+
+	std::vector<uint64_t>	histogram;
+	std::vector<frame_t>	frames;
+	uint32_t				frameIx;
+	uint32_t				framesLeft;
+	bool					perFrame;
+	bool					open;
+	bool					finished;
+};
@@ -0,0 +1,280 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "../include/tomtendo/ramSearch.h"
+#include "../include/tomtendo/interface.h"
+#include "assert.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined( _M_X64 ) || defined( __SSE2__ )
+#include <emmintrin.h>
+#define RAM_SEARCH_SSE2 1
+#endif
+
+namespace Tomtendo
+{
+	static uint32_t BitCount( uint32_t v )
+	{
+		v = v - ( ( v >> 1 ) & 0x55555555 );
+		v = ( v & 0x33333333 ) + ( ( v >> 2 ) & 0x33333333 );
+		return ( ( ( v + ( v >> 4 ) ) & 0x0F0F0F0F ) * 0x01010101 ) >> 24;
+	}
+
+
+#if RAM_SEARCH_SSE2
+	template<ramSearchFilter_t Filter>
+	static inline uint32_t CompareHalf( const uint8_t* cur, const uint8_t* prev, const __m128i k )
+	{
+		const __m128i c = _mm_loadu_si128( reinterpret_cast<const __m128i*>( cur ) );
+		const __m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( prev ) );
+		const uint32_t eq = static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( c, p ) ) );
+
+		// SSE2 has no unsigned byte compare; c >= p exactly when max( c, p ) == c
+		switch ( Filter )
+		{
+		case ramSearchFilter_t::EQUAL:		return eq;
+		case ramSearchFilter_t::CHANGED:	return ~eq & 0xFFFF;
+		case ramSearchFilter_t::INCREASED:	return static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_max_epu8( c, p ), c ) ) ) & ~eq;
+		case ramSearchFilter_t::DECREASED:	return static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( c, p ), c ) ) ) & ~eq;
+		case ramSearchFilter_t::DELTA:		return static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( c, _mm_add_epi8( p, k ) ) ) );
+		case ramSearchFilter_t::VALUE:		return static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( c, k ) ) );
+		}
+		return 0;
+	}
+
+
+	// One bit per byte for 32 bytes, matching the candidate lane layout
+	template<ramSearchFilter_t Filter>
+	static inline uint32_t CompareLane( const uint8_t* cur, const uint8_t* prev, const uint8_t operand )
+	{
+		const __m128i k = _mm_set1_epi8( static_cast<char>( operand ) );
+		return CompareHalf<Filter>( cur, prev, k ) | ( CompareHalf<Filter>( cur + 16, prev + 16, k ) << 16 );
+	}
+#else
+	template<ramSearchFilter_t Filter>
+	static inline uint32_t CompareLane( const uint8_t* cur, const uint8_t* prev, const uint8_t operand )
+	{
+		uint32_t mask = 0;
+		for ( uint32_t i = 0; i < wtRamSearch::LaneBytes; ++i )
+		{
+			bool pass = false;
+			switch ( Filter )
+			{
+			case ramSearchFilter_t::EQUAL:		pass = ( cur[ i ] == prev[ i ] );							break;
+			case ramSearchFilter_t::CHANGED:	pass = ( cur[ i ] != prev[ i ] );							break;
+			case ramSearchFilter_t::INCREASED:	pass = ( cur[ i ] > prev[ i ] );							break;
+			case ramSearchFilter_t::DECREASED:	pass = ( cur[ i ] < prev[ i ] );							break;
+			case ramSearchFilter_t::DELTA:		pass = ( cur[ i ] == static_cast<uint8_t>( prev[ i ] + operand ) );	break;
+			case ramSearchFilter_t::VALUE:		pass = ( cur[ i ] == operand );								break;
+			}
+			mask |= ( pass ? 1u : 0u ) << i;
+		}
+		return mask;
+	}
+#endif
+
+
+	template<ramSearchFilter_t Filter>
+	static void IntersectLanes( uint32_t* candidates, const uint8_t* cur, const uint8_t* prev, const uint8_t operand )
+	{
+		for ( uint32_t lane = 0; lane < wtRamSearch::LaneCount; ++lane )
+		{
+			// Most lanes empty out after a few filters
+			if ( candidates[ lane ] == 0 ) {
+				continue;
+			}
+			const uint32_t offset = lane * wtRamSearch::LaneBytes;
+			candidates[ lane ] &= CompareLane<Filter>( cur + offset, prev + offset, operand );
+		}
+	}
+
+
+	wtRamSearch::wtRamSearch()
+	{
+		memset( candidates, 0, sizeof( candidates ) );
+		candidateCount = 0;
+		hasSram = false;
+	}
+
+
+	bool wtRamSearch::Capture( const wtStateBlob& state, snapshot_t& snapshot )
+	{
+		memset( snapshot.bytes, 0, SnapshotSize );
+
+		const stateHeader_t& header = state.header;
+		if ( header.memory != nullptr ) {
+			memcpy( snapshot.bytes, header.memory, std::min( header.memorySize, MemorySize ) );
+		}
+
+		const bool sram = ( header.sram != nullptr ) && ( header.sramSize >= SramSize );
+		if ( sram ) {
+			memcpy( snapshot.bytes + MemorySize, header.sram, SramSize );
+		}
+		return sram;
+	}
+
+
+	void wtRamSearch::Reset( const wtStateBlob& state )
+	{
+		const wtStateBlob* states[] = { &state };
+		Reset( states, 1 );
+	}
+
+
+	void wtRamSearch::Reset( const wtStateBlob* const* states, const uint32_t instanceCount )
+	{
+		previous.resize( instanceCount );
+
+		hasSram = ( instanceCount > 0 );
+		for ( uint32_t i = 0; i < instanceCount; ++i ) {
+			hasSram = Capture( *states[ i ], previous[ i ] ) && hasSram;
+		}
+
+		memset( candidates, ( instanceCount > 0 ) ? 0xFF : 0x00, sizeof( candidates ) );
+		if ( !hasSram ) {
+			memset( candidates + MemorySize / LaneBytes, 0, SramSize / 8 );
+		}
+		candidateCount = CountCandidates();
+	}
+
+
+	uint32_t wtRamSearch::Filter( const wtStateBlob& state, const ramSearchFilter_t filter, const uint32_t operand )
+	{
+		const wtStateBlob* states[] = { &state };
+		return Filter( states, 1, filter, operand );
+	}
+
+
+	uint32_t wtRamSearch::Filter( const wtStateBlob* const* states, const uint32_t instanceCount, const ramSearchFilter_t filter, const uint32_t operand )
+	{
+		// Without a matching baseline there is nothing to compare against yet
+		if ( instanceCount != previous.size() )
+		{
+			Reset( states, instanceCount );
+			return candidateCount;
+		}
+
+		snapshot_t cur;
+		for ( uint32_t i = 0; i < instanceCount; ++i )
+		{
+			hasSram = Capture( *states[ i ], cur ) && hasSram;
+			Intersect( cur, previous[ i ], filter, static_cast<uint8_t>( operand ) );
+			previous[ i ] = cur;
+		}
+
+		candidateCount = CountCandidates();
+		return candidateCount;
+	}
+
+
+	uint32_t wtRamSearch::FilterSequence( const wtStateBlob* const* frames, const uint32_t frameCount, const ramSearchFilter_t filter, const uint32_t operand )
+	{
+		if ( frameCount == 0 ) {
+			return candidateCount;
+		}
+
+		uint32_t frameIx = 0;
+		if ( previous.size() != 1 )
+		{
+			Reset( *frames[ 0 ] );
+			frameIx = 1;
+		}
+
+		snapshot_t cur;
+		for ( ; frameIx < frameCount; ++frameIx )
+		{
+			hasSram = Capture( *frames[ frameIx ], cur ) && hasSram;
+			Intersect( cur, previous[ 0 ], filter, static_cast<uint8_t>( operand ) );
+			previous[ 0 ] = cur;
+		}
+
+		candidateCount = CountCandidates();
+		return candidateCount;
+	}
+
+
+	void wtRamSearch::Intersect( const snapshot_t& cur, const snapshot_t& prev, const ramSearchFilter_t filter, const uint8_t operand )
+	{
+		if ( !hasSram ) {
+			memset( candidates + MemorySize / LaneBytes, 0, SramSize / 8 );
+		}
+
+		switch ( filter )
+		{
+		case ramSearchFilter_t::EQUAL:		IntersectLanes<ramSearchFilter_t::EQUAL>( candidates, cur.bytes, prev.bytes, operand );		break;
+		case ramSearchFilter_t::CHANGED:	IntersectLanes<ramSearchFilter_t::CHANGED>( candidates, cur.bytes, prev.bytes, operand );	break;
+		case ramSearchFilter_t::INCREASED:	IntersectLanes<ramSearchFilter_t::INCREASED>( candidates, cur.bytes, prev.bytes, operand );	break;
+		case ramSearchFilter_t::DECREASED:	IntersectLanes<ramSearchFilter_t::DECREASED>( candidates, cur.bytes, prev.bytes, operand );	break;
+		case ramSearchFilter_t::DELTA:		IntersectLanes<ramSearchFilter_t::DELTA>( candidates, cur.bytes, prev.bytes, operand );		break;
+		case ramSearchFilter_t::VALUE:		IntersectLanes<ramSearchFilter_t::VALUE>( candidates, cur.bytes, prev.bytes, operand );		break;
+		}
+	}
+
+
+	uint32_t wtRamSearch::CountCandidates() const
+	{
+		uint32_t count = 0;
+		for ( uint32_t lane = 0; lane < LaneCount; ++lane ) {
+			count += BitCount( candidates[ lane ] );
+		}
+		return count;
+	}
+
+
+	uint32_t wtRamSearch::GetCandidateCount() const
+	{
+		return candidateCount;
+	}
+
+
+	uint32_t wtRamSearch::GetCandidates( std::vector<ramSearchResult_t>& results, const uint32_t maxCount, const uint32_t instance ) const
+	{
+		results.clear();
+		if ( instance >= previous.size() ) {
+			return 0;
+		}
+
+		const snapshot_t& snapshot = previous[ instance ];
+		for ( uint32_t lane = 0; ( lane < LaneCount ) && ( results.size() < maxCount ); ++lane )
+		{
+			uint32_t bits = candidates[ lane ];
+			while ( ( bits != 0 ) && ( results.size() < maxCount ) )
+			{
+				uint32_t bit = 0;
+				while ( ( bits & ( 1u << bit ) ) == 0 ) {
+					++bit;
+				}
+				bits &= ~( 1u << bit );
+
+				const uint32_t offset = lane * LaneBytes + bit;
+				ramSearchResult_t result;
+				result.address = static_cast<uint16_t>( ( offset < MemorySize ) ? offset : ( SramBase + offset - MemorySize ) );
+				result.value = snapshot.bytes[ offset ];
+				results.push_back( result );
+			}
+		}
+		return static_cast<uint32_t>( results.size() );
+	}
+};
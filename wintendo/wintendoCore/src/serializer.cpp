@@ -34,14 +34,20 @@ namespace Tomtendo
 
 	void Serializer::SetPosition( const uint32_t index )
 	{
-		this->index = 0;
-		dbgText.str( "" );
+		assert( index <= byteCount );
+		this->index = index;
+	#if DBG_SERIALIZER
+		if( index == 0 ) {
+			dbgText.str( "" );
+		}
+	#endif
 	}
 
 
 	void Serializer::Clear()
 	{
-		memset( bytes, 0, CurrentSize() );
+		memset( bytes, 0, BufferSize() );
+		header.sectionCount = 0;
 		SetPosition( 0 );
 	}
 
@@ -76,20 +82,26 @@ namespace Tomtendo
 	}
 
 
-	uint32_t Serializer::NewLabel( const char name[ serializerHeader_t::MaxNameLength ] )
+	uint32_t Serializer::NewLabel( const char* name )
 	{
+		assert( header.sectionCount < serializerHeader_t::MaxSections );
+		if ( header.sectionCount >= serializerHeader_t::MaxSections ) {
+			return header.sectionCount;
+		}
+
 		const uint32_t sectionIx = header.sectionCount;
 
 		serializerHeader_t::section_t& section = header.sections[ sectionIx ];
+		section.tag = HashString32( name );
 		section.offset = index;
-		strcpy_s< serializerHeader_t::MaxNameLength >( section.name, name );
+		section.size = 0;
 		++header.sectionCount;
 
 		return sectionIx;
 	}
 
 
-	void Serializer::EndLabel( const char name[ serializerHeader_t::MaxNameLength ] )
+	void Serializer::EndLabel( const char* name )
 	{
 		serializerHeader_t::section_t* section;
 		if( FindLabel( name, &section ) )
@@ -99,12 +111,18 @@ namespace Tomtendo
 	}
 
 
-	bool Serializer::FindLabel( const char name[ serializerHeader_t::MaxNameLength ], serializerHeader_t::section_t** outSection )
+	bool Serializer::FindLabel( const char* name, serializerHeader_t::section_t** outSection )
+	{
+		return FindSection( HashString32( name ), outSection );
+	}
+
+
+	bool Serializer::FindSection( const uint32_t tag, serializerHeader_t::section_t** outSection )
 	{
 		for( uint32_t i = 0; i < header.sectionCount; ++i )
 		{
 			serializerHeader_t::section_t& section = header.sections[ i ];
-			if( _strnicmp( name, section.name, serializerHeader_t::MaxNameLength ) == 0 )
+			if( section.tag == tag )
 			{
 				*outSection = &section;
 				return true;
@@ -116,6 +134,19 @@ namespace Tomtendo
 	}
 
 
+	uint32_t Serializer::GetSectionCount() const
+	{
+		return header.sectionCount;
+	}
+
+
+	const serializerHeader_t::section_t& Serializer::GetSection( const uint32_t sectionIx ) const
+	{
+		assert( sectionIx < header.sectionCount );
+		return header.sections[ sectionIx ];
+	}
+
+
 	bool Serializer::NextBool( bool& v)
 	{
 		return Next8b( *reinterpret_cast<uint8_t*>( &v ) );
@@ -172,165 +203,66 @@ namespace Tomtendo
 	}
 
 
-	bool Serializer::Next8b( uint8_t& b8 )
+	bool Serializer::NextBytes( void* v, const uint32_t sizeInBytes )
 	{
-		const uint32_t size = sizeof( b8 );
-		if ( !CanStore( size ) ) {
+		if ( !CanStore( sizeInBytes ) ) {
 			assert( 0 ); // TODO: remove
 			return false;
 		}
 
 		if ( mode == serializeMode_t::LOAD ) {
-			b8 = bytes[ index ];
-		}
-		else {
-			bytes[ index ] = b8;
+			memcpy( v, bytes + index, sizeInBytes );
+		} else {
+			memcpy( bytes + index, v, sizeInBytes );
 		}
-		index += size;
+		index += sizeInBytes;
+
+		return true;
+	}
 
+
+	bool Serializer::Next8b( uint8_t& b8 )
+	{
+		const bool ok = NextBytes( &b8, sizeof( b8 ) );
 	#if DBG_SERIALIZER
 		dbgText << (int)b8 << "\n";
 	#endif
-
-		return true;
+		return ok;
 	}
 
 
 	bool Serializer::Next16b( uint16_t& b16 )
 	{
-		const uint32_t size = sizeof( b16 );
-		if ( !CanStore( size ) ) {
-			assert( 0 ); // TODO: remove
-			return false;
-		}
-
-		serializerTuple_t t = {};
-		if ( mode == serializeMode_t::LOAD )
-		{
-			t.b8.e[ 0 ] = bytes[ index + 0 ];
-			t.b8.e[ 1 ] = bytes[ index + 1 ];
-			b16 = t.b16.e[ 0 ];
-		}
-		else
-		{
-			t.b16.e[ 0 ] = b16;
-			bytes[ index + 0 ] = t.b8.e[ 0 ];
-			bytes[ index + 1 ] = t.b8.e[ 1 ];
-		}
-		index += size;
-
+		const bool ok = NextBytes( &b16, sizeof( b16 ) );
 	#if DBG_SERIALIZER
 		dbgText << b16 << "\n";
 	#endif
-
-		return true;
+		return ok;
 	}
 
 
 	bool Serializer::Next32b( uint32_t& b32 )
 	{
-		const uint32_t size = sizeof( b32 );
-		if ( !CanStore( size ) ) {
-			assert( 0 ); // TODO: remove
-			return false;
-		}
-
-		serializerTuple_t t = {};
-		if ( mode == serializeMode_t::LOAD )
-		{
-			t.b8.e[ 0 ] = bytes[ index + 0 ];
-			t.b8.e[ 1 ] = bytes[ index + 1 ];
-			t.b8.e[ 2 ] = bytes[ index + 2 ];
-			t.b8.e[ 3 ] = bytes[ index + 3 ];
-			b32 = t.b32.e[ 0 ];
-		}
-		else
-		{
-			t.b32.e[ 0 ] = b32;
-			bytes[ index + 0 ] = t.b8.e[ 0 ];
-			bytes[ index + 1 ] = t.b8.e[ 1 ];
-			bytes[ index + 2 ] = t.b8.e[ 2 ];
-			bytes[ index + 3 ] = t.b8.e[ 3 ];
-		}
-		index += size;
-
+		const bool ok = NextBytes( &b32, sizeof( b32 ) );
 	#if DBG_SERIALIZER
 		dbgText << b32 << "\n";
 	#endif
-
-		return true;
+		return ok;
 	}
 
 
 	bool Serializer::Next64b( uint64_t& b64 )
 	{
-		const uint32_t size = sizeof( b64 );
-		if ( !CanStore( size ) ) {
-			assert( 0 ); // TODO: remove
-			return false;
-		}
-
-		serializerTuple_t t = {};
-		if ( mode == serializeMode_t::LOAD )
-		{
-			t.b8.e[ 0 ] = bytes[ index + 0 ];
-			t.b8.e[ 1 ] = bytes[ index + 1 ];
-			t.b8.e[ 2 ] = bytes[ index + 2 ];
-			t.b8.e[ 3 ] = bytes[ index + 3 ];
-			t.b8.e[ 4 ] = bytes[ index + 4 ];
-			t.b8.e[ 5 ] = bytes[ index + 5 ];
-			t.b8.e[ 6 ] = bytes[ index + 6 ];
-			t.b8.e[ 7 ] = bytes[ index + 7 ];
-			b64 = t.b64;
-		}
-		else
-		{
-			t.b64 = b64;
-			bytes[ index + 0 ] = t.b8.e[ 0 ];
-			bytes[ index + 1 ] = t.b8.e[ 1 ];
-			bytes[ index + 2 ] = t.b8.e[ 2 ];
-			bytes[ index + 3 ] = t.b8.e[ 3 ];
-			bytes[ index + 4 ] = t.b8.e[ 4 ];
-			bytes[ index + 5 ] = t.b8.e[ 5 ];
-			bytes[ index + 6 ] = t.b8.e[ 6 ];
-			bytes[ index + 7 ] = t.b8.e[ 7 ];
-		}
-		index += size;
-
+		const bool ok = NextBytes( &b64, sizeof( b64 ) );
 	#if DBG_SERIALIZER
 		dbgText << b64 << "\n";
 	#endif
-
-		return true;
+		return ok;
 	}
 
 
 	bool Serializer::NextArray( uint8_t* b8, uint32_t sizeInBytes )
 	{
-		if ( !CanStore( sizeInBytes ) ) {
-			assert( 0 ); // TODO: remove
-			return false;
-		}
-
-		if ( mode == serializeMode_t::LOAD ) {
-		//	memcpy( b8, bytes + index, sizeInBytes );
-			for ( uint32_t i = 0; i < sizeInBytes; ++i )
-			{
-				b8[ i ] = bytes[ index ];			
-				dbgText << b8[ i ] << " ";
-				++index;
-			}
-		} else {
-		//	memcpy( bytes + index, b8, sizeInBytes );
-			for( uint32_t i = 0; i < sizeInBytes; ++i )
-			{
-				bytes[ index ] = b8[ i ];
-				dbgText << bytes[ index ] << " ";
-				++index;
-			}
-		}
-		//index += sizeInBytes;
-
-		return true;
+		return NextBytes( b8, sizeInBytes );
 	}
 };
\ No newline at end of file
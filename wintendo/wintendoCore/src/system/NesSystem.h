@@ -37,7 +37,14 @@
 #include "../processors/ppu.h"
 #include "../processors/apu.h"
 #include "../../include/tomtendo/interface.h"
+#include "../../include/tomtendo/timeline.h"
 #include "cart.h"
+#include "ioWorker.h"
+#include "seekIndex.h"
+#include "../cdl.h"
+#include "../breakpoint.h"
+#include "../perfCounters.h"
+#include "../disassembler.h"
 
 using namespace Tomtendo;
 using namespace std;
@@ -52,6 +59,8 @@ void BackgroundWorker();
 
 class wtSystem
 {
+	friend class wtBenchmark; // wintendoBench drives the components directly
+
 public:
 	// Buffer and partition sizes
 	static const uint32_t VirtualMemorySize		= 0x10000;
@@ -94,7 +103,9 @@ public:
 	unique_ptr<wtCart>			cart;
 
 private:
-	static const uint32_t		MaxStates = 5000;
+	static const uint32_t		SramFlushFrames = 60;
+	static const uint32_t		MovieKeyframeFrames = 3600;
+	static const uint32_t		MovieFlushFrames = 60;
 
 	std::wstring				fileName;
 	std::wstring				baseFileName;
@@ -117,10 +128,19 @@ private:
 	wtPatternTableImage			patternTable0;
 	wtPatternTableImage			patternTable1;
 	wt16x8ChrImage				pickedObj8x16;
-	std::deque<wtStateBlob>		states;
 	wtStateBlob					frameState;
-	uint32_t					currentState;
-	uint32_t					firstState;
+	wtStateBlob					powerOnState;
+	wtStateBlob					forkState;		// Staging for CopyState, reused so forking never allocates once warm
+	frameHash_t					frameHash;
+	std::vector<frameHash_t>	replayHashes;	// Flushed to <rom>.fhash when the replay finishes
+	wtMovie						movie;
+	uint8_t						movieInput[ MovieControllers ];
+	uint8_t						movieLatched;	// Controllers already sampled this frame while recording
+	wtSeekIndex					seekIndex;
+	wtStateBlob					seekState;
+	std::vector<uint8_t>		seekScratch;
+	int64_t						seekFrame;
+	bool						suppressOutput;	// No video or audio while a seek fast-forwards
 	bool						strobeOn;
 	uint8_t						btnShift[ 2 ];
 	std::deque<sysCmd_t>		commands;
@@ -134,6 +154,17 @@ private:
 	uint64_t					frameTogglesPerRun;
 	bool						toggledFrame;
 	uint8_t						mirrorMode;
+	wtMapper*					mapper;			// Cached from cart so hot paths skip the pointer chase
+	mapperType_t				mapperType;		// Dispatch type, GENERIC while emulationFlags_t::REFERENCE is set
+	mapperType_t				cartMapperType;
+	bool						sramDirty;
+	std::vector<uint8_t>		movieSram;		// The player's battery save while a movie runs, empty otherwise
+	uint64_t					sramFlushFrame;
+	wtIoWorker					ioWorker;
+	profileFormat_t				profileFormat;
+	wtCdl						cdl;
+	wtBreakpoints				breakpoints;
+	wtPerfCounters				perf;
 
 public:
 	wtSystem()
@@ -156,6 +187,7 @@ public:
 	void Reset()
 	{
 		sysCycles = masterCycle_t( 0 );
+		overflowCycles = 0;
 
 		memset( memory, 0, PhysicalMemorySize );
 
@@ -181,7 +213,7 @@ public:
 		for( uint32_t i = 0; i < OutputBuffersCount; ++i ) {
 			frameBuffer[i].Clear();
 			char dbgName[ 128 ];
-			sprintf_s( dbgName, "FrameBuffer%i", i );
+			snprintf( dbgName, sizeof( dbgName ), "FrameBuffer%u", i );
 			frameBuffer[ i ].SetDebugName( dbgName );
 		}
 		nameTableSheet.Clear();
@@ -190,18 +222,34 @@ public:
 		patternTable1.Clear();
 		pickedObj8x16.Clear();
 
-		states.clear();
+		movie.Clear();
+		movieLatched = 0;
+		memset( movieInput, 0, sizeof( movieInput ) );
 		playbackState.currentFrame = 0;
 		playbackState.replayState = replayStateCode_t::LIVE;
 		playbackState.finalFrame = INT64_MAX;
+		playbackState.pause = false;
+
+		seekIndex.Clear();
+		seekFrame = 0;
+		suppressOutput = false;
 
-		currentState = 0;
-		firstState = 1;
 		currentFrameIx = 0;
 		finishedFrameIx = 1;
 		frameNumber = 0;
 
+		sramDirty = false;
+		sramFlushFrame = 0;
+		movieSram.clear();
+
+		profileFormat = profileFormat_t::CSV;
+
+		mapper = nullptr;
+		mapperType = mapperType_t::NROM;
+		cartMapperType = mapperType_t::NROM;
+
 		memset( &dbgInfo, 0, sizeof( dbgInfo ) );
+		memset( &frameHash, 0, sizeof( frameHash ) );
 	}
 
 	// Emulation functions - TODO: make visible only to other emulation components
@@ -221,26 +269,57 @@ public:
 	void					ToggleFrame();
 	wtDisplayImage*			GetBackbuffer();
 	void					Serialize( Serializer& serializer );
+	uint32_t				GetStateSize();
+	bool					LoadSections( const wtStateFile& file, const uint32_t sectionMask );
+	template<class F>
+	void					VisitSections( const uint32_t sectionMask, F func );
+	template<class V>
+	void					Visit( V& visitor );
 	unique_ptr<wtMapper>	AssignMapper( const uint32_t mapperId ); // In "mapper.h"
+	uint8_t					ReadChrRom( const uint16_t address ); // In "mapperDispatch.h"
+	void					WriteChrRam( const uint16_t address, const uint8_t value );
+	void					ClockMapper();
+	uint32_t				GetPrgRomOffset( const uint16_t address ) const;
+	uint32_t				GetChrRomOffset( const uint16_t address ) const;
+	bool					IsCdlLogging() const;
+	void					LogCdlPrg( const uint16_t address, const uint8_t flags );
+	void					LogCdlChr( const uint16_t address, const uint8_t flags );
+	void					SetCdlPaused( const bool pause );
+	void					GetCdlStats( cdlStats_t& stats ) const;
+	bool					HasBreakpoints() const;
+	bool					HasBreakpointHit() const;
+	bool					ConsumeBreakpointResume();
+	bool					CheckBreakpoint( const breakpointSpace_t space, const breakpointType_t type, const uint16_t address, const uint16_t pc );
+	void					CheckPpuBreakpoint( const breakpointType_t type, const uint16_t address );
+	bool					GetBreakpointHit( breakpointHit_t& hit ) const;
+	bool					IsOutputSuppressed() const;
 
 	// External functions
 	int						Init( const wstring& filePath, const uint32_t resetVectorManual = InvalidAddr );
+	int						Init( const uint8_t* romData, const uint32_t romSize, const uint32_t resetVectorManual = InvalidAddr );
+	int						Clone( wtSystem& source );
+	bool					CopyState( wtSystem& source );
 	void					Shutdown();
 	void					LoadProgram( const uint32_t resetVectorManual = InvalidAddr );
-	string					GetPrgBankDissambly( const uint8_t bankNum );
+	uint32_t				GetDisassemblyLineCount( const uint32_t bankNum ) const;
+	void					GetDisassembly( const uint32_t bankNum, const uint32_t firstLine, const uint32_t lineCount, std::string& out ) const;
 	void					GetChrRomPalette( const uint8_t paletteId, RGBA palette[ 4 ] );
 	void					GetGrayscalePalette( RGBA palette[ 4 ] );
 	bool					Run( const masterCycle_t& nextCycle );
 	int						RunEpoch( const std::chrono::nanoseconds& runCycles );
+	bool					StepFrame( const bool render ); // Exactly one picture, no commands, movies or wall clock
 	uint8_t					ReadInput( const uint16_t address );
 	void					WriteInput( const uint16_t address, const uint8_t value );
 	void					GetFrameResult( wtFrameResult& outFrameResult );
 	void					GetState( cpuDebug_t& state );
 	const PPU&				GetPPU() const;
+	const wtDisplayImage&	GetFinishedFrame( const uint32_t age ) const; // 0 is the last finished picture, 1 the one before
+	const uint8_t*			GetWorkRam() const; // PhysicalMemorySize bytes
 	const APU&				GetAPU() const;
+	const wtLog&			GetTraceLog() const; // Live CPU trace, GetFrameResult only exposes it once finished
 	void					SetConfig( config_t& cfg );
 	void					SaveSate();
-	void					LoadState();
+	void					LoadState( const uint32_t sectionMask = STATE_SECTION_ALL );
 	bool					MouseInRegion( const wtRect& region ) const;
 	void					AttachInputHandler( const Input* inputHandler );
 	const Input*			GetInput() const;
@@ -250,14 +329,42 @@ public:
 	void					SubmitCommand( const sysCmd_t& cmd ); // In "command.cpp"
 
 private:
+	template<class V>
+	void					VisitSystem( V& visitor, const uint32_t version );
+	template<class V>
+	void					VisitMemory( V& visitor );
+
+	int						Init( const shared_ptr<const wtRomImage>& romImage, const uint32_t resetVectorManual );
+	template<uint32_t Hooks>
+	bool					RunLoop( const masterCycle_t& nextCycle );
 	void					DebugPrintFlushLog();
+	void					DebugFlushProfile();
+	std::shared_ptr<const wtDisassembler::bank_t>	GetDisassemblyBank( const uint32_t bankNum ) const;
+	void					StartCdl();
+	void					SaveCdl();
+	uint8_t					ReadCartRom( const uint16_t address ); // In "mapperDispatch.h"
+	bool					WriteCart( const uint16_t address, const uint16_t offset, const uint8_t value );
 	void					WritePhysicalMemory( const uint16_t address, const uint8_t value );
 	uint16_t				MirrorAddress( const uint16_t address ) const;
 	void					RecordSate( wtStateBlob& state );
 	void					RestoreState( const wtStateBlob& state );
-	void					RunStateControl( const bool toggledFrame );
+	void					RunStateControl();
+	void					BuildStateImage( std::vector<uint8_t>& outImage );
+	bool					RestoreStateImage( const std::vector<uint8_t>& image );
+	ButtonFlags				SampleInput( const uint32_t controllerIndex );
+	void					StartRecording( const int64_t frameCount, const bool powerOn, const uint32_t keyframeInterval );
+	bool					StartPlayback( const int64_t frame, const bool pause );
+	bool					LoadMovie();
+	bool					SeekMovie( const uint64_t frame, const bool fromCurrent );
+	void					IndexMovieFrame();
+	void					AdvanceMovie();
+	void					StreamMovie();
+	void					HashFrame();
+	void					WriteFrameHashes();
 	void					SaveSRam();
 	void					LoadSRam();
+	void					HoldSRam();
+	void					ReturnSRam();
 	void					BackgroundUpdate();
 
 	// command.cpp
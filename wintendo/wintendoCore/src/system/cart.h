@@ -23,11 +23,21 @@
 
 #pragma once
 #include "../common.h"
+#include "romImage.h"
 
 using namespace std;
 
 class wtSystem;
 
+enum class mapperType_t : uint8_t
+{
+	NROM,
+	UNROM,
+	MMC1,
+	MMC3,
+	GENERIC,	// Virtual calls through wtMapper, the reference path for lockstep checks
+};
+
 class wtMapper
 {
 protected:
@@ -36,6 +46,8 @@ protected:
 public:
 	wtSystem* system;
 
+	virtual					~wtMapper() {};
+
 	virtual uint8_t			OnLoadCpu() { return 0; };
 	virtual uint8_t			OnLoadPpu() { return 0; };
 	virtual uint8_t			ReadRom( const uint16_t addr ) const = 0;
@@ -43,19 +55,33 @@ public:
 	virtual uint8_t			WriteChrRam( const uint16_t addr, const uint8_t value ) { return 0; };
 	virtual uint8_t			Write( const uint16_t addr, const uint8_t value ) { return 0; };
 	virtual bool			InWriteWindow( const uint16_t addr, const uint16_t offset ) const { return false; };
+	virtual uint8_t*		GetSaveRam() { return nullptr; }; // Battery backed $6000-$7FFF, SramSize bytes
+	virtual uint32_t		GetPrgRomOffset( const uint16_t addr ) const { return InvalidRomOffset; };
+	virtual uint32_t		GetChrRomOffset( const uint16_t addr ) const { return InvalidRomOffset; };
 
-	virtual void			Serialize( Serializer& serializer ) {};
+	virtual void			Serialize( wtStateSizer& /*visitor*/ ) {};
+	virtual void			Serialize( wtStateWriter& /*visitor*/ ) {};
+	virtual void			Serialize( wtStateReader& /*visitor*/ ) {};
 	virtual void			Clock() {};
 };
 
 
+// Routes the per-visitor virtual entry points to a mapper's templated Visit()
+#define MAPPER_STATE_VISITORS()																\
+	void Serialize( wtStateSizer& visitor ) override { Visit( visitor ); }					\
+	void Serialize( wtStateWriter& visitor ) override { Visit( visitor ); }					\
+	void Serialize( wtStateReader& visitor ) override { Visit( visitor ); }
+
+
 class wtCart
 {
 private:
-	uint8_t* rom;
+	shared_ptr<const wtRomImage>	image;
+	const uint8_t*			rom;
 	size_t					size;
 	size_t					prgSize;
 	size_t					chrSize;
+	uint64_t				romHash;
 
 public:
 	wtRomHeader				h;
@@ -66,17 +92,22 @@ public:
 		memset( &h, 0, sizeof( wtRomHeader ) );
 		rom = nullptr;
 		size = 0;
+		romHash = 0;
 	}
 
-	wtCart( wtRomHeader& header, uint8_t* romData, uint32_t romSize )
+	wtCart( const shared_ptr<const wtRomImage>& romImage )
 	{
-		rom = new uint8_t[ romSize ];
-
-		memcpy( &h, &header, sizeof( wtRomHeader ) );
-		memcpy( rom, romData, romSize );
-		size = romSize;
+		static_assert( sizeof( wtRomHeader ) == wtRomImage::HeaderSize, "iNES header size mismatch" );
+		assert( romImage->GetSize() > sizeof( wtRomHeader ) );
+
+		// Banks are read in place from the shared image; nothing is copied
+		image = romImage;
+		memcpy( &h, image->GetData(), sizeof( wtRomHeader ) );
+		rom = image->GetData() + sizeof( wtRomHeader ); // TODO: trainer needs to be checked
+		size = image->GetSize() - sizeof( wtRomHeader );
 		prgSize = KB( 16 ) * (size_t)h.prgRomBanks;
 		chrSize = KB( 8 ) * (size_t)h.chrRomBanks;
+		romHash = image->GetHash();
 
 		assert( h.type[ 0 ] == 'N' );
 		assert( h.type[ 1 ] == 'E' );
@@ -87,34 +118,55 @@ public:
 	~wtCart()
 	{
 		memset( &h, 0, sizeof( wtRomHeader ) );
-		if ( rom != nullptr )
-		{
-			delete[] rom;
-			rom = nullptr;
-		}
+		rom = nullptr;
 		size = 0;
 	}
 
-	uint8_t* GetPrgRomBank( const uint32_t bankNum, const uint32_t bankSize = KB( 16 ) )
+	const uint8_t* GetPrgRomBank( const uint32_t bankNum, const uint32_t bankSize = KB( 16 ) ) const
 	{
 		const size_t addr = ( bankNum * (size_t)bankSize ) % prgSize;
 		assert( addr < size );
 		return &rom[ addr ];
 	}
 
+	uint32_t GetPrgRomOffset( const uint32_t bankNum, const uint32_t bankSize = KB( 16 ) ) const
+	{
+		return static_cast<uint32_t>( ( bankNum * (size_t)bankSize ) % prgSize );
+	}
+
+	uint32_t GetPrgRomSize() const
+	{
+		return static_cast<uint32_t>( prgSize );
+	}
+
+	const uint8_t* GetPrgRom() const
+	{
+		return rom;
+	}
+
 	uint8_t GetPrgRomBankAddr( const uint32_t address )
 	{
 		assert( address < size );
 		return rom[ address ];
 	}
 
-	uint8_t* GetChrRomBank( const uint32_t bankNum, const uint32_t bankSize = KB( 4 ) )
+	const uint8_t* GetChrRomBank( const uint32_t bankNum, const uint32_t bankSize = KB( 4 ) ) const
 	{
 		const size_t addr = prgSize + ( bankNum * (size_t)bankSize ) % chrSize;
 		assert( addr < size );
 		return &rom[ addr ];
 	}
 
+	uint32_t GetChrRomOffset( const uint32_t bankNum, const uint32_t bankSize = KB( 4 ) ) const
+	{
+		return static_cast<uint32_t>( ( bankNum * (size_t)bankSize ) % chrSize );
+	}
+
+	uint32_t GetChrRomSize() const
+	{
+		return static_cast<uint32_t>( chrSize );
+	}
+
 	uint8_t GetPrgBankCount() const
 	{
 		return h.prgRomBanks;
@@ -135,6 +187,16 @@ public:
 		return h.controlBits0.usesBattery;
 	}
 
+	uint64_t GetHash() const
+	{
+		return romHash;
+	}
+
+	const shared_ptr<const wtRomImage>& GetImage() const
+	{
+		return image;
+	}
+
 	uint32_t GetMapperId() const {
 		return ( h.controlBits1.mappedNumberUpper << 4 ) | h.controlBits0.mapperNumberLower;
 	}
@@ -26,15 +26,18 @@
 
 void wtSystem::ProcessCommands()
 {
+	PERF_SCOPE( perf, PERF_COMMANDS );
+
 	const size_t cmdCount = commands.size();
 	for ( size_t i = 0; i < cmdCount; ++i )
 	{
-		sysCmd_t& cmd = commands[ i ];
+		sysCmd_t& cmd = commands.front();
 		switch( cmd.type )
 		{
 			case sysCmdType_t::LOAD_STATE:
 			{
-				LoadState();
+				const uint32_t sectionMask = static_cast<uint32_t>( cmd.parms[ 0 ].u );
+				LoadState( ( sectionMask == 0 ) ? STATE_SECTION_ALL : sectionMask );
 			}
 			break;
 
@@ -49,35 +52,33 @@ void wtSystem::ProcessCommands()
 				if( playbackState.replayState == replayStateCode_t::LIVE )
 				{
 					const int64_t frameCount = cmd.parms[ 0 ].i;
-					playbackState.replayState = replayStateCode_t::RECORD;
-					playbackState.startFrame = 0;
-					playbackState.currentFrame = 0;
-					if ( frameCount < 0 ) {
-						playbackState.finalFrame = INT64_MAX;
-					} else {
-						playbackState.finalFrame = frameCount;
-					}
+					const bool powerOn = ( cmd.parms[ 1 ].u != 0 );
+					const uint32_t keyframeInterval = ( cmd.parms[ 2 ].i < 0 ) ? 0 : ( ( cmd.parms[ 2 ].i == 0 ) ? MovieKeyframeFrames : static_cast<uint32_t>( cmd.parms[ 2 ].i ) );
+					StartRecording( frameCount, powerOn, keyframeInterval );
 				}
 			}
 			break;
 
 			case sysCmdType_t::REPLAY:
 			{
-				const int64_t frameCount = cmd.parms[ 0 ].i;
+				const int64_t frame = cmd.parms[ 0 ].i;
 				const bool pause = ( cmd.parms[ 1 ].u > 0 );
-				playbackState.replayState = replayStateCode_t::REPLAY;
-				playbackState.startFrame = frameCount;
-				playbackState.currentFrame = frameCount;
-				playbackState.finalFrame = static_cast<int64_t>( states.size() ) - 1;
-				playbackState.pause = pause;
+				if ( StartPlayback( frame, pause ) )
+				{
+					replayHashes.clear();
+					replayHashes.reserve( static_cast<size_t>( playbackState.finalFrame - playbackState.startFrame ) );
+				}
 			}
 			break;
 
 			case sysCmdType_t::START_TRACE:
 			{
 				const uint32_t frameCount = static_cast<uint32_t>( cmd.parms[0].u );
-				if ( ( frameCount > 0 ) && !cpu.IsTraceLogOpen() ) {
-					cpu.StartTraceLog( frameCount );
+				const bool spillToDisk = ( cmd.parms[1].u != 0 ) && !baseFileName.empty();
+				if ( ( frameCount > 0 ) && !cpu.IsTraceLogOpen() )
+				{
+					const std::string spillPath = spillToDisk ? ( std::string( baseFileName.begin(), baseFileName.end() ) + ".trace" ) : "";
+					cpu.StartTraceLog( frameCount, spillPath );
 				}
 			}
 			break;
@@ -90,6 +91,62 @@ void wtSystem::ProcessCommands()
 			}
 			break;
 
+			case sysCmdType_t::START_PROFILE:
+			{
+				if ( !cpu.profiler.IsOpen() && cart )
+				{
+					const uint32_t frameCount = static_cast<uint32_t>( cmd.parms[ 0 ].u );
+					const bool perFrame = ( cmd.parms[ 1 ].u != 0 );
+					profileFormat = ( cmd.parms[ 2 ].u != 0 ) ? profileFormat_t::JSON : profileFormat_t::CSV;
+					cpu.profiler.Start( cart->GetPrgRomSize(), frameCount, perFrame );
+				}
+			}
+			break;
+
+			case sysCmdType_t::STOP_PROFILE:
+			{
+				cpu.profiler.Stop();
+			}
+			break;
+
+			case sysCmdType_t::START_CDL:
+			{
+				StartCdl();
+			}
+			break;
+
+			case sysCmdType_t::STOP_CDL:
+			{
+				if ( cdl.IsLogging() )
+				{
+					cdl.Stop();
+					SaveCdl();
+				}
+			}
+			break;
+
+			case sysCmdType_t::SET_BREAKPOINT:
+			{
+				const uint16_t address = static_cast<uint16_t>( cmd.parms[ 0 ].u );
+				const uint8_t typeMask = static_cast<uint8_t>( cmd.parms[ 1 ].u );
+				const breakpointSpace_t space = ( cmd.parms[ 2 ].u != 0 ) ? breakpointSpace_t::PPU : breakpointSpace_t::CPU;
+				const bool enable = ( cmd.parms[ 3 ].u == 0 );
+				breakpoints.Set( space, typeMask, address, enable );
+			}
+			break;
+
+			case sysCmdType_t::CLEAR_BREAKPOINTS:
+			{
+				breakpoints.Clear();
+			}
+			break;
+
+			case sysCmdType_t::RESUME:
+			{
+				breakpoints.Resume();
+			}
+			break;
+
 			default: break;
 		}
 		commands.pop_front();
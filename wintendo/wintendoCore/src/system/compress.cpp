@@ -0,0 +1,209 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "compress.h"
+#include "../../include/tomtendo/util.h"
+#include <cstring>
+
+namespace wtLz
+{
+	static inline uint32_t Read32( const uint8_t* p )
+	{
+		uint32_t v;
+		memcpy( &v, p, sizeof( v ) );
+		return v;
+	}
+
+
+	static inline uint32_t HashSequence( const uint32_t v )
+	{
+		return ( v * 2654435761u ) >> ( 32 - HashBits );
+	}
+
+
+	static void EmitLength( std::vector<uint8_t>& out, uint32_t len )
+	{
+		while ( len >= 255 )
+		{
+			out.push_back( 255 );
+			len -= 255;
+		}
+		out.push_back( static_cast<uint8_t>( len ) );
+	}
+
+
+	// An offset of zero marks the trailing literal-only sequence
+	static void EmitSequence( std::vector<uint8_t>& out, const uint8_t* literals, const uint32_t litLen, const uint32_t offset, const uint32_t matchLen )
+	{
+		const uint32_t matchCode = ( offset != 0 ) ? ( matchLen - MinMatch ) : 0;
+		const uint8_t token = static_cast<uint8_t>( ( ( litLen < 15 ? litLen : 15 ) << 4 ) | ( matchCode < 15 ? matchCode : 15 ) );
+		out.push_back( token );
+		if ( litLen >= 15 ) {
+			EmitLength( out, litLen - 15 );
+		}
+		out.insert( out.end(), literals, literals + litLen );
+
+		if ( offset == 0 ) {
+			return;
+		}
+
+		out.push_back( static_cast<uint8_t>( offset & 0xFF ) );
+		out.push_back( static_cast<uint8_t>( ( offset >> 8 ) & 0xFF ) );
+		if ( matchCode >= 15 ) {
+			EmitLength( out, matchCode - 15 );
+		}
+	}
+
+
+	static bool ReadLength( const uint8_t*& ip, const uint8_t* end, uint32_t& len )
+	{
+		uint8_t b;
+		do
+		{
+			if ( ip >= end ) {
+				return false;
+			}
+			b = *ip++;
+			len += b;
+		} while ( b == 255 );
+		return true;
+	}
+
+
+	void Compress( const uint8_t* src, const uint32_t srcSize, std::vector<uint8_t>& out )
+	{
+		const size_t headerPos = out.size();
+		out.resize( headerPos + sizeof( packedHeader_t ) );
+		out.reserve( out.size() + srcSize / 2 );
+
+		uint32_t table[ 1 << HashBits ];
+		memset( table, 0xFF, sizeof( table ) );
+
+		uint32_t anchor = 0;
+		uint32_t i = 0;
+		while ( ( i + MinMatch ) <= srcSize )
+		{
+			const uint32_t v = Read32( src + i );
+			const uint32_t h = HashSequence( v );
+			const uint32_t candidate = table[ h ];
+			table[ h ] = i;
+
+			if ( ( candidate == ~0u ) || ( ( i - candidate ) > MaxOffset ) || ( Read32( src + candidate ) != v ) )
+			{
+				++i;
+				continue;
+			}
+
+			uint32_t matchLen = MinMatch;
+			while ( ( ( i + matchLen ) < srcSize ) && ( src[ candidate + matchLen ] == src[ i + matchLen ] ) ) {
+				++matchLen;
+			}
+
+			EmitSequence( out, src + anchor, i - anchor, i - candidate, matchLen );
+			i += matchLen;
+			anchor = i;
+		}
+		EmitSequence( out, src + anchor, srcSize - anchor, 0, 0 );
+
+		packedHeader_t header;
+		header.magic = PackedMagic;
+		header.rawSize = srcSize;
+		header.packedSize = static_cast<uint32_t>( out.size() - headerPos - sizeof( packedHeader_t ) );
+		header.checksum = Tomtendo::Hash32( src, srcSize );
+		memcpy( out.data() + headerPos, &header, sizeof( header ) );
+	}
+
+
+	bool IsPacked( const uint8_t* src, const uint32_t srcSize )
+	{
+		return ( srcSize >= sizeof( packedHeader_t ) ) && ( Read32( src ) == PackedMagic );
+	}
+
+
+	bool Decompress( const uint8_t* src, const uint32_t srcSize, std::vector<uint8_t>& out )
+	{
+		if ( !IsPacked( src, srcSize ) ) {
+			return false;
+		}
+
+		packedHeader_t header;
+		memcpy( &header, src, sizeof( header ) );
+		if ( header.packedSize != ( srcSize - sizeof( packedHeader_t ) ) ) {
+			return false;
+		}
+
+		out.resize( header.rawSize );
+		uint8_t* op = out.data();
+		uint8_t* const opEnd = op + header.rawSize;
+		const uint8_t* ip = src + sizeof( packedHeader_t );
+		const uint8_t* const ipEnd = src + srcSize;
+
+		while ( ip < ipEnd )
+		{
+			const uint8_t token = *ip++;
+
+			uint32_t litLen = ( token >> 4 );
+			if ( ( litLen == 15 ) && !ReadLength( ip, ipEnd, litLen ) ) {
+				return false;
+			}
+			if ( ( litLen > static_cast<uint32_t>( ipEnd - ip ) ) || ( litLen > static_cast<uint32_t>( opEnd - op ) ) ) {
+				return false;
+			}
+			memcpy( op, ip, litLen );
+			op += litLen;
+			ip += litLen;
+
+			if ( ip == ipEnd ) {
+				break;
+			}
+
+			if ( ( ipEnd - ip ) < 2 ) {
+				return false;
+			}
+			const uint32_t offset = ip[ 0 ] | ( ip[ 1 ] << 8 );
+			ip += 2;
+
+			uint32_t matchLen = ( token & 0x0F );
+			if ( ( matchLen == 15 ) && !ReadLength( ip, ipEnd, matchLen ) ) {
+				return false;
+			}
+			matchLen += MinMatch;
+
+			if ( ( offset == 0 ) || ( offset > static_cast<uint32_t>( op - out.data() ) ) || ( matchLen > static_cast<uint32_t>( opEnd - op ) ) ) {
+				return false;
+			}
+
+			// Byte copy, matches may overlap their own output
+			const uint8_t* match = op - offset;
+			for ( uint32_t i = 0; i < matchLen; ++i ) {
+				op[ i ] = match[ i ];
+			}
+			op += matchLen;
+		}
+
+		if ( op != opEnd ) {
+			return false;
+		}
+		return ( Tomtendo::Hash32( out.data(), out.size() ) == header.checksum );
+	}
+};
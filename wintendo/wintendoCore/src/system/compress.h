@@ -0,0 +1,53 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// LZ4-style byte-aligned block codec. Savestates are mostly zero pages and
+// repeated tiles so a greedy single-probe matcher is enough and keeps
+// compression far cheaper than the disk write it precedes.
+namespace wtLz
+{
+	static const uint32_t PackedMagic	= 0x5A4C5457; // "WTLZ"
+	static const uint32_t MinMatch		= 4;
+	static const uint32_t MaxOffset		= 0xFFFF;
+	static const uint32_t HashBits		= 12;
+
+	struct packedHeader_t
+	{
+		uint32_t	magic;
+		uint32_t	rawSize;
+		uint32_t	packedSize;
+		uint32_t	checksum;
+	};
+
+	// Appends a packedHeader_t followed by the compressed block to 'out'
+	void	Compress( const uint8_t* src, const uint32_t srcSize, std::vector<uint8_t>& out );
+
+	// Returns false on a corrupt stream; 'out' holds exactly rawSize bytes on success
+	bool	Decompress( const uint8_t* src, const uint32_t srcSize, std::vector<uint8_t>& out );
+	bool	IsPacked( const uint8_t* src, const uint32_t srcSize );
+};
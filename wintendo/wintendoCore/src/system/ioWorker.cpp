@@ -0,0 +1,316 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "ioWorker.h"
+#include "compress.h"
+#include <cstdio>
+#ifdef _WIN32
+#include <Windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static FILE* OpenFile( const std::wstring& path, const wchar_t* mode )
+{
+#ifdef _WIN32
+	return _wfopen( path.c_str(), mode );
+#else
+	const std::string narrowPath( path.begin(), path.end() );
+	const std::wstring wideMode( mode );
+	const std::string narrowMode( wideMode.begin(), wideMode.end() );
+	return fopen( narrowPath.c_str(), narrowMode.c_str() );
+#endif
+}
+
+
+// Pushes the file's contents to the device, so a rename over the old file never lands before its data
+static bool SyncFile( FILE* file )
+{
+	if ( fflush( file ) != 0 ) {
+		return false;
+	}
+#ifdef _WIN32
+	return ( _commit( _fileno( file ) ) == 0 );
+#else
+	return ( fsync( fileno( file ) ) == 0 );
+#endif
+}
+
+
+static bool ReplaceFile( const std::wstring& srcPath, const std::wstring& dstPath )
+{
+#ifdef _WIN32
+	return ( MoveFileExW( srcPath.c_str(), dstPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0 );
+#else
+	const std::string narrowSrc( srcPath.begin(), srcPath.end() );
+	const std::string narrowDst( dstPath.begin(), dstPath.end() );
+	return ( rename( narrowSrc.c_str(), narrowDst.c_str() ) == 0 );
+#endif
+}
+
+
+static void RemoveFile( const std::wstring& path )
+{
+#ifdef _WIN32
+	_wremove( path.c_str() );
+#else
+	const std::string narrowPath( path.begin(), path.end() );
+	remove( narrowPath.c_str() );
+#endif
+}
+
+
+wtIoWorker::wtIoWorker()
+{
+	running = false;
+	failedWrites = 0;
+}
+
+
+wtIoWorker::~wtIoWorker()
+{
+	Stop();
+}
+
+
+void wtIoWorker::Write( const std::wstring& path, std::vector<uint8_t>&& snapshot, const bool compress )
+{
+	{
+		std::lock_guard<std::mutex> guard( lock );
+
+		if ( !worker.joinable() )
+		{
+			running = true;
+			worker = std::thread( &wtIoWorker::WorkerThread, this );
+		}
+
+		bool replaced = false;
+		for ( auto it = jobs.begin(); it != jobs.end(); )
+		{
+			if ( it->path != path ) {
+				++it;
+			} else if ( replaced ) {
+				it = jobs.erase( it ); // Appends queued behind a rewrite are superseded by it
+			} else {
+				it->data = std::move( snapshot );
+				it->compress = compress;
+				it->append = false;
+				replaced = true;
+				++it;
+			}
+		}
+
+		if ( !replaced ) {
+			jobs.push_back( job_t{ path, std::move( snapshot ), compress, false } );
+		}
+	}
+	wake.notify_one();
+}
+
+
+void wtIoWorker::Append( const std::wstring& path, std::vector<uint8_t>&& data )
+{
+	{
+		std::lock_guard<std::mutex> guard( lock );
+
+		if ( !worker.joinable() )
+		{
+			running = true;
+			worker = std::thread( &wtIoWorker::WorkerThread, this );
+		}
+
+		// Fold into the latest queued job for the file so ordering is kept
+		job_t* pending = nullptr;
+		for ( job_t& job : jobs )
+		{
+			if ( job.path == path ) {
+				pending = &job;
+			}
+		}
+
+		if ( ( pending != nullptr ) && !pending->compress ) {
+			pending->data.insert( pending->data.end(), data.begin(), data.end() );
+		} else {
+			jobs.push_back( job_t{ path, std::move( data ), false, true } );
+		}
+	}
+	wake.notify_one();
+}
+
+
+bool wtIoWorker::Read( const std::wstring& path, std::vector<uint8_t>& outData )
+{
+	{
+		std::unique_lock<std::mutex> guard( lock );
+		done.wait( guard, [&]() { return !IsPending( path ); } );
+	}
+
+	FILE* file = OpenFile( path, L"rb" );
+	if ( file == nullptr ) {
+		return false;
+	}
+
+	fseek( file, 0, SEEK_END );
+	const long len = ftell( file );
+	fseek( file, 0, SEEK_SET );
+
+	std::vector<uint8_t> fileData( ( len > 0 ) ? len : 0 );
+	const size_t readLen = fread( fileData.data(), 1, fileData.size(), file );
+	fclose( file );
+
+	if ( ( len <= 0 ) || ( readLen != fileData.size() ) ) {
+		return false;
+	}
+
+	// Files from before compression was added are stored as-is
+	const uint32_t fileSize = static_cast<uint32_t>( fileData.size() );
+	if ( wtLz::IsPacked( fileData.data(), fileSize ) ) {
+		return wtLz::Decompress( fileData.data(), fileSize, outData );
+	}
+
+	outData.swap( fileData );
+	return true;
+}
+
+
+void wtIoWorker::Flush()
+{
+	std::unique_lock<std::mutex> guard( lock );
+	done.wait( guard, [this]() { return jobs.empty() && activePath.empty(); } );
+}
+
+
+void wtIoWorker::Stop()
+{
+	{
+		std::lock_guard<std::mutex> guard( lock );
+		running = false;
+	}
+	wake.notify_all();
+
+	if ( worker.joinable() ) {
+		worker.join();
+	}
+}
+
+
+uint32_t wtIoWorker::GetFailedCount() const
+{
+	return failedWrites.load();
+}
+
+
+bool wtIoWorker::IsPending( const std::wstring& path ) const
+{
+	if ( activePath == path ) {
+		return true;
+	}
+
+	for ( const job_t& job : jobs )
+	{
+		if ( job.path == path ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void wtIoWorker::WorkerThread()
+{
+	std::unique_lock<std::mutex> guard( lock );
+	while ( true )
+	{
+		wake.wait( guard, [this]() { return !jobs.empty() || !running; } );
+
+		// Queued jobs are always drained before exiting so shutdown never loses a save
+		if ( jobs.empty() ) {
+			break;
+		}
+
+		job_t job = std::move( jobs.front() );
+		jobs.pop_front();
+		activePath = job.path;
+		guard.unlock();
+
+		bool written;
+		if ( job.append )
+		{
+			written = AppendFile( job.path, job.data );
+		}
+		else if ( job.compress )
+		{
+			std::vector<uint8_t> packed;
+			wtLz::Compress( job.data.data(), static_cast<uint32_t>( job.data.size() ), packed );
+			written = WriteFileAtomic( job.path, packed );
+		}
+		else
+		{
+			written = WriteFileAtomic( job.path, job.data );
+		}
+
+		if ( !written ) {
+			++failedWrites;
+		}
+
+		guard.lock();
+		activePath.clear();
+		done.notify_all();
+	}
+}
+
+
+bool wtIoWorker::WriteFileAtomic( const std::wstring& path, const std::vector<uint8_t>& data )
+{
+	const std::wstring tempPath = path + L".tmp";
+
+	FILE* file = OpenFile( tempPath, L"wb" );
+	if ( file == nullptr ) {
+		return false;
+	}
+
+	const size_t written = fwrite( data.data(), 1, data.size(), file );
+	const bool flushed = SyncFile( file );
+	const bool closed = ( fclose( file ) == 0 );
+
+	if ( ( written != data.size() ) || !flushed || !closed || !ReplaceFile( tempPath, path ) )
+	{
+		RemoveFile( tempPath );
+		return false;
+	}
+	return true;
+}
+
+
+bool wtIoWorker::AppendFile( const std::wstring& path, const std::vector<uint8_t>& data )
+{
+	FILE* file = OpenFile( path, L"ab" );
+	if ( file == nullptr ) {
+		return false;
+	}
+
+	const size_t written = fwrite( data.data(), 1, data.size(), file );
+	const bool closed = ( fclose( file ) == 0 );
+	return ( written == data.size() ) && closed;
+}
@@ -0,0 +1,81 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Owns all save file traffic so the emulation thread only ever pays for a
+// buffer copy. Jobs are immutable snapshots; a newer snapshot for a path that
+// is still queued replaces the stale one instead of growing the backlog.
+class wtIoWorker
+{
+public:
+	wtIoWorker();
+	~wtIoWorker();
+
+	wtIoWorker( const wtIoWorker& ) = delete;
+	wtIoWorker& operator=( const wtIoWorker& ) = delete;
+
+	void		Write( const std::wstring& path, std::vector<uint8_t>&& snapshot, const bool compress );
+
+	// Adds to the end of the file in place, for logs that grow over time. Never compressed.
+	void		Append( const std::wstring& path, std::vector<uint8_t>&& data );
+
+	// Waits for any queued write to 'path', then reads and unpacks it. Returns false if missing or corrupt.
+	bool		Read( const std::wstring& path, std::vector<uint8_t>& outData );
+
+	void		Flush();
+	void		Stop();
+	uint32_t	GetFailedCount() const;
+
+private:
+	struct job_t
+	{
+		std::wstring			path;
+		std::vector<uint8_t>	data;
+		bool					compress;
+		bool					append;
+	};
+
+	void		WorkerThread();
+	bool		IsPending( const std::wstring& path ) const;
+	static bool	WriteFileAtomic( const std::wstring& path, const std::vector<uint8_t>& data );
+	static bool	AppendFile( const std::wstring& path, const std::vector<uint8_t>& data );
+
+	std::deque<job_t>			jobs;
+	std::wstring				activePath;
+	mutable std::mutex			lock;
+	std::condition_variable		wake;
+	std::condition_variable		done;
+	std::thread					worker;
+	bool						running;
+	std::atomic<uint32_t>		failedWrites;
+};
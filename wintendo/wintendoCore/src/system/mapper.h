@@ -30,14 +30,22 @@
 #include "../mappers/MMC3.h"
 #include "../mappers/UNROM.h"
 
+template<class T>
+static std::unique_ptr<wtMapper> MakeMapper( const uint32_t mapperId, mapperType_t& outType )
+{
+	outType = T::Type;
+	return std::make_unique<T>( mapperId );
+}
+
+
 std::unique_ptr<wtMapper> wtSystem::AssignMapper( const uint32_t mapperId )
 {
 	switch ( mapperId )
 	{
 		default:
-		case 0: return std::make_unique<NROM>( mapperId );	break;
-		case 1:	return std::make_unique<MMC1>( mapperId );	break;
-		case 2:	return std::make_unique<UNROM>( mapperId );	break;
-		case 4:	return std::make_unique<MMC3>( mapperId );	break;
+		case 0: return MakeMapper<NROM>( mapperId, cartMapperType );	break;
+		case 1:	return MakeMapper<MMC1>( mapperId, cartMapperType );	break;
+		case 2:	return MakeMapper<UNROM>( mapperId, cartMapperType );	break;
+		case 4:	return MakeMapper<MMC3>( mapperId, cartMapperType );	break;
 	}
 }
\ No newline at end of file
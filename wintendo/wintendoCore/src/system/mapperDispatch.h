@@ -0,0 +1,150 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include "../mappers/NROM.h"
+#include "../mappers/MMC1.h"
+#include "../mappers/MMC3.h"
+#include "../mappers/UNROM.h"
+
+// Resolves the concrete mapper from the type picked in AssignMapper. Mappers
+// are final, so calls made on the typed reference bind statically and inline
+// into the CPU and PPU fetch paths instead of going through the vtable.
+template<class Fn>
+FORCE_INLINE decltype( auto ) DispatchMapper( const mapperType_t type, wtMapper* mapper, Fn&& fn )
+{
+	switch ( type )
+	{
+		default:
+		case mapperType_t::NROM:	return fn( *static_cast<NROM*>( mapper ) );
+		case mapperType_t::UNROM:	return fn( *static_cast<UNROM*>( mapper ) );
+		case mapperType_t::MMC1:	return fn( *static_cast<MMC1*>( mapper ) );
+		case mapperType_t::MMC3:	return fn( *static_cast<MMC3*>( mapper ) );
+		case mapperType_t::GENERIC:	return fn( *mapper );
+	}
+}
+
+
+FORCE_INLINE uint8_t wtSystem::ReadCartRom( const uint16_t address )
+{
+	return DispatchMapper( mapperType, mapper, [ address ]( auto& m ) { return m.ReadRom( address ); } );
+}
+
+
+FORCE_INLINE bool wtSystem::WriteCart( const uint16_t address, const uint16_t offset, const uint8_t value )
+{
+	return DispatchMapper( mapperType, mapper, [ this, address, offset, value ]( auto& m )
+	{
+		if ( !m.InWriteWindow( address, offset ) ) {
+			return false;
+		}
+		PERF_SCOPE( perf, PERF_MAPPER );
+		m.Write( address, value );
+		return true;
+	} );
+}
+
+
+FORCE_INLINE uint8_t wtSystem::ReadChrRom( const uint16_t address )
+{
+	return DispatchMapper( mapperType, mapper, [ address ]( auto& m ) { return m.ReadChrRom( address ); } );
+}
+
+
+FORCE_INLINE void wtSystem::WriteChrRam( const uint16_t address, const uint8_t value )
+{
+	DispatchMapper( mapperType, mapper, [ address, value ]( auto& m ) { m.WriteChrRam( address, value ); } );
+}
+
+
+FORCE_INLINE void wtSystem::ClockMapper()
+{
+	PERF_SCOPE( perf, PERF_MAPPER );
+	DispatchMapper( mapperType, mapper, []( auto& m ) { m.Clock(); } );
+}
+
+
+FORCE_INLINE uint32_t wtSystem::GetPrgRomOffset( const uint16_t address ) const
+{
+	return DispatchMapper( mapperType, mapper, [ address ]( const auto& m ) { return m.GetPrgRomOffset( address ); } );
+}
+
+
+FORCE_INLINE uint32_t wtSystem::GetChrRomOffset( const uint16_t address ) const
+{
+	return DispatchMapper( mapperType, mapper, [ address ]( const auto& m ) { return m.GetChrRomOffset( address ); } );
+}
+
+
+FORCE_INLINE bool wtSystem::IsCdlLogging() const
+{
+	return cdl.IsLogging();
+}
+
+
+FORCE_INLINE void wtSystem::LogCdlPrg( const uint16_t address, const uint8_t flags )
+{
+	cdl.MarkPrg( GetPrgRomOffset( address ), flags | wtCdl::BankBits( address ) );
+}
+
+
+FORCE_INLINE void wtSystem::LogCdlChr( const uint16_t address, const uint8_t flags )
+{
+	cdl.MarkChr( GetChrRomOffset( address ), flags );
+}
+
+
+FORCE_INLINE bool wtSystem::HasBreakpoints() const
+{
+	return breakpoints.IsArmed();
+}
+
+
+FORCE_INLINE bool wtSystem::HasBreakpointHit() const
+{
+	return breakpoints.HasHit();
+}
+
+
+FORCE_INLINE bool wtSystem::ConsumeBreakpointResume()
+{
+	return breakpoints.ConsumeResume();
+}
+
+
+FORCE_INLINE bool wtSystem::CheckBreakpoint( const breakpointSpace_t space, const breakpointType_t type, const uint16_t address, const uint16_t pc )
+{
+	if ( !breakpoints.Test( space, type, address ) ) {
+		return false;
+	}
+	breakpoints.Hit( space, type, address, pc, cpu.cycle.count(), frameNumber );
+	return true;
+}
+
+
+// PPUDATA is only reached from inside a CPU op, where PC sits one past the opcode
+FORCE_INLINE void wtSystem::CheckPpuBreakpoint( const breakpointType_t type, const uint16_t address )
+{
+	CheckBreakpoint( breakpointSpace_t::PPU, type, static_cast<uint16_t>( address & 0x3FFF ), static_cast<uint16_t>( cpu.PC - 1 ) );
+}
@@ -0,0 +1,225 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "../../include/tomtendo/movie.h"
+#include <cstring>
+#include <algorithm>
+#include <assert.h>
+
+namespace Tomtendo
+{
+	static void AppendChunk( std::vector<uint8_t>& outData, const uint32_t type, const uint64_t frame, const uint8_t* payload, const uint32_t size )
+	{
+		const movieChunk_t chunk = { type, size, frame };
+		const size_t offset = outData.size();
+		outData.resize( offset + sizeof( chunk ) + size );
+		memcpy( outData.data() + offset, &chunk, sizeof( chunk ) );
+		memcpy( outData.data() + offset + sizeof( chunk ), payload, size );
+	}
+
+
+	wtMovie::wtMovie()
+	{
+		Clear();
+	}
+
+
+	void wtMovie::Begin( const uint64_t romHash, const uint32_t flags, const uint32_t keyframeInterval )
+	{
+		Clear();
+
+		header.magic			= MovieFileMagic;
+		header.version			= MovieFileVersion;
+		header.headerSize		= sizeof( movieFileHeader_t );
+		header.flags			= flags;
+		header.keyframeInterval	= keyframeInterval;
+		header.romHash			= romHash;
+	}
+
+
+	void wtMovie::Clear()
+	{
+		header = {};
+		input.clear();
+		keyframes.clear();
+		encodedFrames = 0;
+		encodedKeyframes = 0;
+		encodedHeader = false;
+	}
+
+
+	bool wtMovie::IsEmpty() const
+	{
+		return ( header.magic != MovieFileMagic );
+	}
+
+
+	void wtMovie::AddFrame( const uint8_t frameInput[ MovieControllers ] )
+	{
+		input.insert( input.end(), frameInput, frameInput + MovieControllers );
+	}
+
+
+	void wtMovie::AddKeyframe( const uint64_t frame, std::vector<uint8_t>&& image )
+	{
+		assert( keyframes.empty() || ( keyframes.back().frame < frame ) );
+		keyframes.push_back( movieKeyframe_t{ frame, std::move( image ) } );
+	}
+
+
+	uint64_t wtMovie::GetFrameCount() const
+	{
+		return input.size() / MovieControllers;
+	}
+
+
+	uint64_t wtMovie::GetPendingFrameCount() const
+	{
+		return GetFrameCount() - encodedFrames;
+	}
+
+
+	uint8_t wtMovie::GetInput( const uint64_t frame, const uint32_t controller ) const
+	{
+		const uint64_t index = frame * MovieControllers + controller;
+		return ( index < input.size() ) ? input[ index ] : 0;
+	}
+
+
+	const movieKeyframe_t* wtMovie::FindKeyframe( const uint64_t frame ) const
+	{
+		auto it = std::upper_bound( keyframes.begin(), keyframes.end(), frame, []( const uint64_t f, const movieKeyframe_t& key ) {
+			return f < key.frame;
+		} );
+		return ( it == keyframes.begin() ) ? nullptr : &*( it - 1 );
+	}
+
+
+	const movieFileHeader_t& wtMovie::GetHeader() const
+	{
+		return header;
+	}
+
+
+	bool wtMovie::EncodePending( std::vector<uint8_t>& outData )
+	{
+		const bool rewrite = !encodedHeader;
+		if ( rewrite )
+		{
+			outData.resize( sizeof( header ) );
+			memcpy( outData.data(), &header, sizeof( header ) );
+			encodedHeader = true;
+		}
+
+		// Keyframes are interleaved so that each follows the input leading up to it
+		const uint64_t frameCount = GetFrameCount();
+		while ( ( encodedFrames < frameCount ) || ( encodedKeyframes < keyframes.size() ) )
+		{
+			uint64_t endFrame = frameCount;
+			if ( encodedKeyframes < keyframes.size() && ( keyframes[ encodedKeyframes ].frame < endFrame ) ) {
+				endFrame = keyframes[ encodedKeyframes ].frame;
+			}
+
+			if ( endFrame > encodedFrames )
+			{
+				const uint32_t size = static_cast<uint32_t>( ( endFrame - encodedFrames ) * MovieControllers );
+				AppendChunk( outData, MOVIE_CHUNK_INPUT, encodedFrames, &input[ encodedFrames * MovieControllers ], size );
+				encodedFrames = endFrame;
+			}
+
+			if ( ( encodedKeyframes < keyframes.size() ) && ( keyframes[ encodedKeyframes ].frame <= encodedFrames ) )
+			{
+				const movieKeyframe_t& key = keyframes[ encodedKeyframes ];
+				AppendChunk( outData, MOVIE_CHUNK_STATE, key.frame, key.image.data(), static_cast<uint32_t>( key.image.size() ) );
+				++encodedKeyframes;
+			}
+			else if ( encodedFrames == frameCount )
+			{
+				break;
+			}
+		}
+		return rewrite;
+	}
+
+
+	bool wtMovie::Parse( const uint8_t* data, const size_t sizeInBytes )
+	{
+		Clear();
+
+		if ( ( data == nullptr ) || ( sizeInBytes < sizeof( movieFileHeader_t ) ) ) {
+			return false;
+		}
+
+		movieFileHeader_t fileHeader;
+		memcpy( &fileHeader, data, sizeof( fileHeader ) );
+
+		if ( ( fileHeader.magic != MovieFileMagic ) || ( fileHeader.version == 0 ) ) {
+			return false;
+		}
+
+		if ( ( fileHeader.headerSize < sizeof( movieFileHeader_t ) ) || ( fileHeader.headerSize > sizeInBytes ) ) {
+			return false;
+		}
+
+		header = fileHeader;
+
+		size_t offset = fileHeader.headerSize;
+		while ( ( offset + sizeof( movieChunk_t ) ) <= sizeInBytes )
+		{
+			movieChunk_t chunk;
+			memcpy( &chunk, data + offset, sizeof( chunk ) );
+			offset += sizeof( chunk );
+
+			// Stop at a partly written chunk; everything before it is still playable
+			if ( chunk.size > ( sizeInBytes - offset ) ) {
+				break;
+			}
+
+			const uint8_t* payload = data + offset;
+			offset += chunk.size;
+
+			if ( chunk.type == MOVIE_CHUNK_INPUT )
+			{
+				if ( ( chunk.frame != GetFrameCount() ) || ( ( chunk.size % MovieControllers ) != 0 ) ) {
+					break;
+				}
+				input.insert( input.end(), payload, payload + chunk.size );
+			}
+			else if ( chunk.type == MOVIE_CHUNK_STATE )
+			{
+				if ( ( chunk.frame > GetFrameCount() ) || ( !keyframes.empty() && ( keyframes.back().frame >= chunk.frame ) ) ) {
+					break;
+				}
+				keyframes.push_back( movieKeyframe_t{ chunk.frame, std::vector<uint8_t>( payload, payload + chunk.size ) } );
+			}
+			// Unknown chunk types are skipped so later versions can add to the stream
+		}
+
+		// Everything parsed is already on disk
+		encodedHeader = true;
+		encodedFrames = GetFrameCount();
+		encodedKeyframes = static_cast<uint32_t>( keyframes.size() );
+		return true;
+	}
+};
@@ -35,56 +35,142 @@
 #include "../processors/mos6502.h"
 #include "../../include/tomtendo/input.h"
 #include "mapper.h"
+#include "mapperDispatch.h"
 #include "../../include/tomtendo/timer.h"
 
 
-static void LoadNesFile( const std::wstring& fileName, unique_ptr<wtCart>& outCart )
+void wtSystem::DebugPrintFlushLog()
 {
-	// TODO: use serializer here
-	std::ifstream nesFile;
-	nesFile.open( fileName, std::ios::binary );
+#if DEBUG_ADDR == 1
+	if ( !cpu.IsTraceLogOpen() && cpu.logToFile )
+	{
+		string dbgString;
+		cpu.dbgLog.ToString( dbgString, 0, 0, true );
+		dbgString += '\n';
+		ioWorker.Write( fileName + L".log", vector<uint8_t>( dbgString.begin(), dbgString.end() ), false );
+	}
+#endif
+}
 
-	assert( nesFile.good() );
 
-	nesFile.seekg( 0, std::ios::end );
-	uint32_t len = static_cast<uint32_t>( nesFile.tellg() );
+void wtSystem::DebugFlushProfile()
+{
+	if ( !cpu.profiler.IsFinished() ) {
+		return;
+	}
 
-	wtRomHeader header;
-	uint32_t size = len - static_cast<uint32_t>( sizeof( header ) ); // TODO: trainer needs to be checked
-	uint8_t* romData = new uint8_t[ size ];
+	if ( !baseFileName.empty() && cart )
+	{
+		profileSource_t source;
+		source.opLUT = cpu.opLUT;
+		source.prgRom = cart->GetPrgRom();
+		source.prgRomSize = cart->GetPrgRomSize();
+		source.ram = memory;
+		source.sram = mapper->GetSaveRam();
+
+		string text;
+		cpu.profiler.Export( text, profileFormat, source );
+
+		const wstring ext = ( profileFormat == profileFormat_t::JSON ) ? L".profile.json" : L".profile.csv";
+		ioWorker.Write( baseFileName + ext, vector<uint8_t>( text.begin(), text.end() ), false );
+	}
+	cpu.profiler.Clear();
+}
+
+
+void wtSystem::StartCdl()
+{
+	if ( !cart || cdl.IsLogging() ) {
+		return;
+	}
+
+	cdl.Start( cart->GetPrgRomSize(), cart->HasChrRam() ? 0 : cart->GetChrRomSize() );
+
+	if ( !baseFileName.empty() )
+	{
+		vector<uint8_t> file;
+		if ( ioWorker.Read( baseFileName + L".cdl", file ) ) {
+			cdl.Load( file );
+		}
+	}
+}
 
-	nesFile.seekg( 0, std::ios::beg );
-	nesFile.read( reinterpret_cast<char*>( &header ), sizeof( header ) );
-	nesFile.read( reinterpret_cast<char*>( romData ), size );
-	nesFile.close();
 
-	outCart = make_unique<wtCart>( header, romData, size );
+void wtSystem::SaveCdl()
+{
+	if ( baseFileName.empty() ) {
+		return;
+	}
 
-	delete[] romData;
+	vector<uint8_t> file;
+	cdl.Save( file );
+	ioWorker.Write( baseFileName + L".cdl", std::move( file ), false );
 }
 
 
-void wtSystem::DebugPrintFlushLog()
+void wtSystem::SetCdlPaused( const bool pause )
 {
-#if DEBUG_ADDR == 1
-	if ( !cpu.IsTraceLogOpen() && cpu.logToFile )
-	{
-		string dbgString;
-		std::ofstream logFile;
-		logFile.open( fileName + L".log" );
-		cpu.dbgLog.ToString( dbgString, 0, 0, true );
-		logFile << dbgString << endl;
-		logFile.close();
+	cdl.SetPaused( pause );
+}
+
+
+void wtSystem::GetCdlStats( cdlStats_t& stats ) const
+{
+	cdl.GetStats( stats );
+}
+
+
+bool wtSystem::GetBreakpointHit( breakpointHit_t& hit ) const
+{
+	if ( !breakpoints.HasHit() ) {
+		return false;
 	}
-#endif
+	hit = breakpoints.GetHit();
+	return true;
 }
 
 
 int wtSystem::Init( const wstring& filePath, const uint32_t resetVectorManual )
+{
+	fileName = filePath;
+
+	const size_t offset = fileName.find( L".nes", 0 );
+	baseFileName = fileName.substr( 0, offset );
+
+	return Init( wtRomImage::Open( filePath ), resetVectorManual );
+}
+
+
+int wtSystem::Init( const uint8_t* romData, const uint32_t romSize, const uint32_t resetVectorManual )
+{
+	// In-memory ROMs have no file to pair saves with, so persistence is skipped
+	fileName.clear();
+	baseFileName.clear();
+
+	return Init( wtRomImage::Borrow( romData, romSize ), resetVectorManual );
+}
+
+
+int wtSystem::Init( const shared_ptr<const wtRomImage>& romImage, const uint32_t resetVectorManual )
 {
 	Reset();
 
-	LoadNesFile( filePath, cart );
+	if ( ( romImage == nullptr ) || ( romImage->GetSize() <= sizeof( wtRomHeader ) ) ) {
+		return -1;
+	}
+
+	// The cart reads banks straight out of the image, so the header's bank counts must fit in it
+	wtRomHeader header;
+	memcpy( &header, romImage->GetData(), sizeof( wtRomHeader ) );
+
+	const size_t trainerSize = header.controlBits0.usesTrainer ? 512 : 0;
+	const size_t imageSize = sizeof( wtRomHeader ) + trainerSize + KB( 16 ) * (size_t)header.prgRomBanks + KB( 8 ) * (size_t)header.chrRomBanks;
+	if ( ( memcmp( header.type, "NES", 3 ) != 0 ) || ( header.magic != 0x1A ) || ( header.prgRomBanks == 0 ) || ( romImage->GetSize() < imageSize ) ) {
+		return -1;
+	}
+
+	cart = make_unique<wtCart>( romImage );
+	wtRomImage::PurgeCache();
 
 	ppu.Reset();
 	ppu.RegisterSystem( this );
@@ -96,10 +182,9 @@ int wtSystem::Init( const wstring& filePath, const uint32_t resetVectorManual )
 	cpu.RegisterSystem( this );
 
 	LoadProgram( resetVectorManual );
-	fileName = filePath;
 
-	const size_t offset = fileName.find( L".nes", 0 );
-	baseFileName = fileName.substr( 0, offset );
+	// Power-on movies start here, before the battery save makes the machine local
+	RecordSate( powerOnState );
 
 	LoadSRam();
 
@@ -107,9 +192,61 @@ int wtSystem::Init( const wstring& filePath, const uint32_t resetVectorManual )
 }
 
 
+// The clone shares the source's ROM image, so PRG/CHR and the decode caches keyed on its hash are never
+// copied. It has no file name, so it never touches the source's saves or movie.
+int wtSystem::Clone( wtSystem& source )
+{
+	if ( source.cart == nullptr ) {
+		return -1;
+	}
+
+	const int ret = Init( source.cart->GetImage(), source.cpu.resetVector );
+	if ( ret != 0 ) {
+		return ret;
+	}
+
+	input = source.input;
+	config = source.config;
+	CopyState( source );
+	return 0;
+}
+
+
+// Copies only what the running machine changes: RAM, VRAM, OAM, registers and the mapper.
+// The source is only read, so many machines can fork from it at once while it is stopped.
+bool wtSystem::CopyState( wtSystem& source )
+{
+	if ( ( cart == nullptr ) || ( source.cart == nullptr ) || ( cart->GetHash() != source.cart->GetHash() ) ) {
+		return false;
+	}
+
+	const uint32_t stateSize = source.GetStateSize();
+	forkState.Resize( stateSize );
+
+	Serializer store( forkState.GetPtr(), stateSize, serializeMode_t::STORE );
+	source.Serialize( store );
+
+	Serializer load( forkState.GetPtr(), stateSize, serializeMode_t::LOAD );
+	Serialize( load );
+
+	// Profiling counter, not machine state
+	cpu.instrCount = source.cpu.instrCount;
+	return true;
+}
+
+
 void wtSystem::Shutdown()
 {
 	SaveSRam();
+	StreamMovie();
+	cpu.profiler.Stop();
+	DebugFlushProfile();
+	if ( cdl.IsLogging() )
+	{
+		cdl.Stop();
+		SaveCdl();
+	}
+	ioWorker.Flush();
 }
 
 
@@ -118,9 +255,11 @@ void wtSystem::LoadProgram( const uint32_t resetVectorManual )
 	memset( memory, 0, PhysicalMemorySize );
 
 	cart->mapper = AssignMapper( cart->GetMapperId() );
+	mapperType = cartMapperType;
 	cart->mapper->system = this;
 	cart->mapper->OnLoadCpu();
 	cart->mapper->OnLoadPpu();
+	mapper = cart->mapper.get();
 
 	if ( resetVectorManual == 0x10000 ) {
 		cpu.resetVector = Combine( ReadMemory( ResetVectorAddr ), ReadMemory( ResetVectorAddr + 1 ) );
@@ -237,7 +376,7 @@ uint8_t wtSystem::ReadMemory( const uint16_t address )
 	const uint16_t mAddr = MirrorAddress( address );
 	if ( IsCartMemory( mAddr ) )
 	{
-		return cart->mapper->ReadRom( mAddr );
+		return ReadCartRom( mAddr );
 	}
 	else if ( IsPpuRegister( mAddr ) )
 	{
@@ -300,14 +439,17 @@ void wtSystem::WriteMemory( const uint16_t address, const uint16_t offset, const
 	{
 		apu.WriteReg( mAddr, value );
 	}
-	else if ( cart->mapper->InWriteWindow( mAddr, offset ) )
+	else if ( WriteCart( mAddr, offset, value ) )
 	{
-		cart->mapper->Write( mAddr, value );
+		if ( InRange( mAddr, SramBase, SramEnd ) ) {
+			sramDirty = true;
+		}
 	}
-	else
+	else if ( mAddr < PhysicalMemorySize )
 	{
 		WritePhysicalMemory( mAddr, value );
 	}
+	// Anything else is open bus, e.g. $4020-$5FFF on NROM
 }
 
 
@@ -324,16 +466,15 @@ uint8_t wtSystem::ReadInput( const uint16_t address )
 
 	assert( InputRegister0 <= address );
 	const uint32_t controllerIndex = ( address - InputRegister0 );
-	const ControllerId controllerId = static_cast<ControllerId>( controllerIndex );
 
 	if ( strobeOn )
 	{
-		keyBuffer = static_cast<uint8_t>( GetInput()->GetKeyBuffer( controllerId ) & static_cast<ButtonFlags>( 0X80 ) );
+		keyBuffer = static_cast<uint8_t>( SampleInput( controllerIndex ) & static_cast<ButtonFlags>( 0X80 ) );
 		btnShift[ controllerIndex ] = 0;
 	}
 	else
 	{
-		keyBuffer = static_cast<uint8_t>( GetInput()->GetKeyBuffer( controllerId ) >> static_cast<ButtonFlags>( 7 - btnShift[ controllerIndex ] ) ) & 0x01;
+		keyBuffer = static_cast<uint8_t>( SampleInput( controllerIndex ) >> static_cast<ButtonFlags>( 7 - btnShift[ controllerIndex ] ) ) & 0x01;
 		++btnShift[ controllerIndex ];
 		btnShift[ controllerIndex ] %= 8;
 	}
@@ -355,6 +496,8 @@ void wtSystem::WriteInput( const uint16_t address, const uint8_t value )
 
 void wtSystem::GetFrameResult( wtFrameResult& outFrameResult )
 {
+	TIMELINE_SCOPE( "GetFrameResult" );
+
 	outFrameResult.frameBuffer		= &frameBuffer[ finishedFrameIx ];
 	outFrameResult.nameTableSheet	= &nameTableSheet;
 	outFrameResult.paletteDebug		= &paletteDebug;
@@ -383,8 +526,9 @@ void wtSystem::GetFrameResult( wtFrameResult& outFrameResult )
 	}
 
 	outFrameResult.frameState		= &frameState;
+	outFrameResult.frameHash		= frameHash;
 	outFrameResult.currentFrame		= frameNumber;
-	outFrameResult.stateCount		= static_cast<uint64_t>( states.size() );
+	outFrameResult.movieFrameCount	= movie.GetFrameCount();
 	outFrameResult.playbackState	= playbackState;
 	outFrameResult.dbgFrameBufferIx	= finishedFrameIx;
 	outFrameResult.frameToggleCount = frameTogglesPerRun;
@@ -425,6 +569,12 @@ const APU& wtSystem::GetAPU() const
 }
 
 
+const wtLog& wtSystem::GetTraceLog() const
+{
+	return cpu.dbgLog;
+}
+
+
 void wtSystem::AttachInputHandler( const Input* inputHandler )
 {
 	input = inputHandler;
@@ -449,6 +599,25 @@ bool wtSystem::HasNewFrame() const
 }
 
 
+bool wtSystem::IsOutputSuppressed() const
+{
+	return suppressOutput;
+}
+
+
+const wtDisplayImage& wtSystem::GetFinishedFrame( const uint32_t age ) const
+{
+	assert( age < OutputBuffersCount );
+	return frameBuffer[ ( finishedFrameIx + OutputBuffersCount - age ) % OutputBuffersCount ];
+}
+
+
+const uint8_t* wtSystem::GetWorkRam() const
+{
+	return memory;
+}
+
+
 wtDisplayImage* wtSystem::GetBackbuffer()
 {
 	return &frameBuffer[ currentFrameIx ];
@@ -495,47 +664,90 @@ void wtSystem::RequestDmcTransfer() const
 
 void wtSystem::SaveSRam()
 {
-	if ( ( cart.get() != nullptr ) && cart->HasSave() )
-	{
-		uint8_t saveBuffer[ KB( 8 ) ];
-		for ( int32_t i = 0; i < KB( 8 ); ++i ) {
-			saveBuffer[ i ] = cart->mapper->ReadRom( 0x6000 + i );
-		}
+	if ( !sramDirty || baseFileName.empty() || ( cart.get() == nullptr ) || !cart->HasSave() ) {
+		return;
+	}
+
+	// Movies may start from a cleared battery save; don't let them replace the player's. See HoldSRam
+	if ( ( playbackState.replayState == replayStateCode_t::RECORD ) || ( playbackState.replayState == replayStateCode_t::REPLAY ) ) {
+		return;
+	}
 
-		std::ofstream saveFile;
-		saveFile.open( baseFileName + L".sav", ios::binary );
-		saveFile.write( reinterpret_cast<char*>( saveBuffer ), KB( 8 ) );
-		saveFile.close();
+	const uint8_t* sram = cart->mapper->GetSaveRam();
+	if ( sram == nullptr ) {
+		return;
 	}
+
+	std::vector<uint8_t> snapshot( sram, sram + SramSize );
+	ioWorker.Write( baseFileName + L".sav", std::move( snapshot ), true );
+
+	sramDirty = false;
+	sramFlushFrame = frameNumber;
 }
 
 
-void wtSystem::LoadSRam()
+// Flushes the player's battery save and keeps a copy for the length of the movie
+void wtSystem::HoldSRam()
 {
-	if ( ( cart.get() != nullptr ) && cart->HasSave() )
-	{
-		uint8_t saveBuffer[ KB( 2 ) ];
+	if ( !movieSram.empty() || ( cart.get() == nullptr ) || !cart->HasSave() ) {
+		return;
+	}
 
-		std::ifstream saveFile;
-		saveFile.open( baseFileName + L".sav", ios::binary );
+	SaveSRam();
 
-		if ( !saveFile.good() ) {
-			return;
-		}
+	const uint8_t* sram = cart->mapper->GetSaveRam();
+	if ( sram != nullptr ) {
+		movieSram.assign( sram, sram + SramSize );
+	}
+}
 
-		saveFile.read( reinterpret_cast<char*>( saveBuffer ), KB( 2 ) );
-		saveFile.close();
 
-		for ( int32_t i = 0; i < KB( 2 ); ++i ) {
-			cart->mapper->Write( 0x6000 + i, saveBuffer[ i ] );
-		}
+// Puts the player's battery save back once the movie ends, so the movie's is never flushed over it
+void wtSystem::ReturnSRam()
+{
+	if ( movieSram.empty() ) {
+		return;
+	}
+
+	uint8_t* sram = cart->mapper->GetSaveRam();
+	if ( sram != nullptr ) {
+		memcpy( sram, movieSram.data(), SramSize );
+	}
+	movieSram.clear();
+	sramDirty = false;
+}
+
+
+void wtSystem::LoadSRam()
+{
+	if ( baseFileName.empty() || ( cart.get() == nullptr ) || !cart->HasSave() ) {
+		return;
+	}
+
+	uint8_t* sram = cart->mapper->GetSaveRam();
+	if ( sram == nullptr ) {
+		return;
+	}
+
+	std::vector<uint8_t> saveData;
+	if ( !ioWorker.Read( baseFileName + L".sav", saveData ) ) {
+		return;
 	}
+
+	const size_t restoreSize = ( saveData.size() < SramSize ) ? saveData.size() : SramSize;
+	memcpy( sram, saveData.data(), restoreSize );
+	sramDirty = false;
 }
 
 
 void wtSystem::RecordSate( wtStateBlob& state )
 {
-	Serializer serializer( MB_1, serializeMode_t::STORE );
+	PERF_SCOPE( perf, PERF_STATE );
+	TIMELINE_SCOPE( "RecordState" );
+
+	// Serialize straight into the blob; its allocation is reused frame to frame
+	state.Resize( GetStateSize() );
+	Serializer serializer( state.GetPtr(), state.GetBufferSize(), serializeMode_t::STORE );
 	Serialize( serializer );
 	state.Set( serializer, sysCycles );
 }
@@ -547,54 +759,77 @@ void wtSystem::RestoreState( const wtStateBlob& state )
 		return;
 	}
 
-	Serializer serializer( state.GetBufferSize(), serializeMode_t::LOAD );
-	state.WriteTo( serializer );
+	Serializer serializer( const_cast<uint8_t*>( state.GetPtr() ), state.GetBufferSize(), serializeMode_t::LOAD );
 	Serialize( serializer );
 }
 
 
 void wtSystem::SaveSate()
 {
-	wtStateBlob state;
-	RecordSate( state );
+	if ( baseFileName.empty() ) {
+		return;
+	}
+
+	std::vector<uint8_t> image;
+	BuildStateImage( image );
 
-	std::ofstream saveFile;
-	saveFile.open( baseFileName + L".st", ios::binary );
-	saveFile.write( reinterpret_cast<char*>( state.GetPtr() ), state.GetBufferSize() );
-	saveFile.close();
+	// Stored raw so the section table can be read and checked without unpacking the whole file
+	ioWorker.Write( baseFileName + L".st", std::move( image ), false );
 }
 
 
-void wtSystem::LoadState()
+void wtSystem::BuildStateImage( std::vector<uint8_t>& outImage )
 {
-	std::ifstream loadFile;
-	loadFile.open( baseFileName + L".st", ios::binary | ios::in );
+	Serializer serializer( GetStateSize(), serializeMode_t::STORE );
+	Serialize( serializer );
 
-	if ( !loadFile.good() ) {
-		loadFile.close();
-		return;
+	wtStateFile::Build( serializer, cart->GetHash(), sysCycles.count(), outImage );
+}
+
+
+bool wtSystem::RestoreStateImage( const std::vector<uint8_t>& image )
+{
+	wtStateFile file;
+	if ( !file.Parse( image.data(), static_cast<uint32_t>( image.size() ) ) || ( file.GetHeader().romHash != cart->GetHash() ) ) {
+		return false;
 	}
+	return LoadSections( file, STATE_SECTION_ALL );
+}
 
-	loadFile.seekg( 0, std::ios::end );
-	const uint32_t len = static_cast<uint32_t>( loadFile.tellg() );
 
-	Serializer serializer( len, serializeMode_t::LOAD );
+void wtSystem::LoadState( const uint32_t sectionMask )
+{
+	std::vector<uint8_t> fileData;
+	if ( baseFileName.empty() || !ioWorker.Read( baseFileName + L".st", fileData ) ) {
+		return;
+	}
 
-	loadFile.seekg( 0, std::ios::beg );
-	loadFile.read( reinterpret_cast<char*>( serializer.GetPtr() ), len );
-	loadFile.close();
+	wtStateFile file;
+	if ( !file.Parse( fileData.data(), static_cast<uint32_t>( fileData.size() ) ) )
+	{
+		fprintf( stderr, "State rejected: not a state file, or corrupt\n" );
+		return;
+	}
+	if ( file.GetHeader().romHash != cart->GetHash() )
+	{
+		fprintf( stderr, "State rejected: saved from a different ROM\n" );
+		return;
+	}
 
-	Serialize( serializer );
+	if ( LoadSections( file, sectionMask ) && ( ( sectionMask & STATE_SECTION_MAPPER ) != 0 ) ) {
+		sramDirty = true;
+	}
 }
 
 
-bool wtSystem::Run( const masterCycle_t& nextCycle )
+template<uint32_t Hooks>
+bool wtSystem::RunLoop( const masterCycle_t& nextCycle )
 {
 	bool isRunning = true;
 
 	static const masterCycle_t ticks( CpuClockDivide );
 
-	apu.Begin();
+	PERF_LAP_BEGIN( lap );
 
 	// TODO: CHECK WRAP AROUND LOGIC
 	while ( ( sysCycles < nextCycle ) && isRunning )
@@ -604,19 +839,55 @@ bool wtSystem::Run( const masterCycle_t& nextCycle )
 		const cpuCycle_t nextCpuCycle = MasterToCpuCycle( sysCycles );
 		const ppuCycle_t nextPpuCycle = MasterToPpuCycle( sysCycles );
 
-		isRunning = cpu.Step( nextCpuCycle );
+		isRunning = cpu.Step<Hooks>( nextCpuCycle );
+		PERF_LAP( perf, PERF_CPU, lap );
 		ppu.Step( nextPpuCycle );
+		PERF_LAP( perf, PERF_PPU, lap );
 #ifndef _DEBUG
 		apu.Step( nextCpuCycle );
+		PERF_LAP( perf, PERF_APU, lap );
 #endif
+		if ( ( Hooks & CPU_HOOK_BREAK ) && breakpoints.HasHit() ) {
+			break;
+		}
 	}
-	apu.End();
 
-#if DEBUG_MODE == 1
-	dbgInfo.masterCpu = chrono::duration_cast<masterCycle_t>( cpu.cycle );
-	dbgInfo.masterPpu = chrono::duration_cast<masterCycle_t>( ppu.cycle );
-	dbgInfo.masterApu = chrono::duration_cast<masterCycle_t>( apu.cpuCycle );
-#endif // #if DEBUG_MODE == 1
+	return isRunning;
+}
+
+
+bool wtSystem::Run( const masterCycle_t& nextCycle )
+{
+	TIMELINE_SCOPE( "Run" );
+
+	apu.Begin();
+
+	// Tracing and profiling only start or stop between runs, so the core is chosen once here
+	typedef bool ( wtSystem::* runLoopFn_t )( const masterCycle_t& nextCycle );
+	static const runLoopFn_t runLoops[ CPU_HOOK_ALL + 1 ] =
+	{
+		&wtSystem::RunLoop<0>, &wtSystem::RunLoop<1>, &wtSystem::RunLoop<2>, &wtSystem::RunLoop<3>,
+		&wtSystem::RunLoop<4>, &wtSystem::RunLoop<5>, &wtSystem::RunLoop<6>, &wtSystem::RunLoop<7>,
+		&wtSystem::RunLoop<8>, &wtSystem::RunLoop<9>, &wtSystem::RunLoop<10>, &wtSystem::RunLoop<11>,
+		&wtSystem::RunLoop<12>, &wtSystem::RunLoop<13>, &wtSystem::RunLoop<14>, &wtSystem::RunLoop<15>,
+	};
+
+	uint32_t hooks = cpu.profiler.IsOpen() ? CPU_HOOK_PROFILE : CPU_HOOK_NONE;
+	hooks |= cdl.IsLogging() ? CPU_HOOK_CDL : CPU_HOOK_NONE;
+	hooks |= breakpoints.IsArmed() ? CPU_HOOK_BREAK : CPU_HOOK_NONE;
+
+	// The reference configuration takes the instrumented core and virtual mapper calls so
+	// lockstep runs can check the specialized paths against it
+	const bool reference = ( config->sys.flags & emulationFlags_t::REFERENCE ) != 0;
+	hooks |= reference ? CPU_HOOK_BREAK : CPU_HOOK_NONE;
+	mapperType = reference ? mapperType_t::GENERIC : cartMapperType;
+#if DEBUG_ADDR == 1
+	hooks |= cpu.IsTraceLogOpen() ? CPU_HOOK_TRACE : CPU_HOOK_NONE;
+#endif
+
+	const bool isRunning = ( this->*runLoops[ hooks ] )( nextCycle );
+
+	apu.End();
 
 #if DEBUG_ADDR == 1
 	if ( cpu.IsTraceLogOpen() )
@@ -630,45 +901,45 @@ bool wtSystem::Run( const masterCycle_t& nextCycle )
 }
 
 
-string wtSystem::GetPrgBankDissambly( const uint8_t bankNum )
+// Lands just past the end of the next picture, so the render flag of the following call covers
+// all of its visible lines. Most of the frame runs in one go, the last line a scanline at a time.
+bool wtSystem::StepFrame( const bool render )
 {
-	std::stringstream debugStream;
-	uint8_t* bankMem = cart->GetPrgRomBank( bankNum );
-	uint16_t curByte = 0;
+	static const masterCycle_t scanlineStep( PPU::ScanlineCycles * PpuClockDivide );
 
-	while ( curByte < KB( 16 ) )
-	{
-		stringstream hexString;
-		const uint32_t instrAddr = curByte;
-		const uint32_t opCode = bankMem[ curByte ];
+	suppressOutput = !render;
 
-		opInfo_t instrInfo = cpu.opLUT[ opCode ];
-		const uint32_t operandCnt = instrInfo.operands;
-		const char* mnemonic = instrInfo.mnemonic;
+	const uint64_t startFrame = frameNumber;
+	const uint32_t bulkLines = ppu.GetScanlinesToFrameEnd();
 
-		if ( operandCnt == 1 )
-		{
-			const uint32_t op0 = bankMem[ curByte + 1 ];
-			hexString << uppercase << setfill( '0' ) << setw( 2 ) << hex << opCode << " " << setw( 2 ) << op0;
-		}
-		else if ( operandCnt == 2 )
-		{
-			const uint32_t op0 = bankMem[ curByte + 1 ];
-			const uint32_t op1 = bankMem[ curByte + 2 ];
-			hexString << uppercase << setfill( '0' ) << setw( 2 ) << hex << opCode << " " << setw( 2 ) << op0 << " " << setw( 2 ) << op1;
-		}
-		else
-		{
-			hexString << uppercase << setfill( '0' ) << setw( 2 ) << hex << opCode;
-		}
+	bool isRunning = true;
+	if ( bulkLines > 1 ) {
+		isRunning = Run( sysCycles + masterCycle_t( ( bulkLines - 1 ) * PPU::ScanlineCycles * PpuClockDivide ) );
+	}
+	while ( isRunning && ( frameNumber == startFrame ) ) {
+		isRunning = Run( sysCycles + scanlineStep );
+	}
+
+	suppressOutput = false;
+	return isRunning;
+}
 
-		debugStream << "0x" << right << uppercase << setfill( '0' ) << setw( 4 ) << hex << instrAddr << setfill( ' ' ) << "  " << setw( 10 ) << left << hexString.str() << mnemonic << std::endl;
 
-		curByte += 1 + operandCnt;
-		assert( curByte <= ( KB( 16 ) + operandCnt + 1 ) );
-	}
+uint32_t wtSystem::GetDisassemblyLineCount( const uint32_t bankNum ) const
+{
+	return static_cast<uint32_t>( GetDisassemblyBank( bankNum )->lines.size() );
+}
+
+
+void wtSystem::GetDisassembly( const uint32_t bankNum, const uint32_t firstLine, const uint32_t lineCount, std::string& out ) const
+{
+	wtDisassembler::FormatLines( out, *GetDisassemblyBank( bankNum ), cart->GetPrgRomBank( bankNum ), cpu.opLUT, firstLine, lineCount );
+}
+
 
-	return debugStream.str();
+std::shared_ptr<const wtDisassembler::bank_t> wtSystem::GetDisassemblyBank( const uint32_t bankNum ) const
+{
+	return wtDisassembler::GetBank( cart->GetPrgRom(), cart->GetPrgRomSize(), cart->GetHash(), bankNum, cpu.opLUT, &cdl );
 }
 
 
@@ -697,57 +968,34 @@ void wtSystem::GetGrayscalePalette( RGBA palette[ 4 ] )
 }
 
 
-void wtSystem::RunStateControl( const bool toggledFrame )
+void wtSystem::RunStateControl()
 {
 	const replayStateCode_t stateCode = playbackState.replayState;
 
-	if ( toggledFrame )
-	{
-	//	RecordSate( frameState );
-	//	dbgInfo.stateCycle = sysCycles;
-	}
+	IndexMovieFrame();
 
-	if ( stateCode == replayStateCode_t::REPLAY )
+	if ( stateCode == replayStateCode_t::RECORD )
 	{
-		const bool replayFinished = ( playbackState.currentFrame >= playbackState.finalFrame );
-		if ( replayFinished )
-		{
-			playbackState.replayState = replayStateCode_t::FINISHED;
-		}
-		else if( toggledFrame )
+		// Keyframes are taken between runs, never mid-instruction, so they restore cleanly
+		const uint32_t keyframeInterval = movie.GetHeader().keyframeInterval;
+		const movieKeyframe_t* lastKeyframe = movie.FindKeyframe( playbackState.currentFrame );
+		const int64_t lastKeyframeFrame = ( lastKeyframe != nullptr ) ? static_cast<int64_t>( lastKeyframe->frame ) : 0;
+		if ( ( keyframeInterval > 0 ) && ( ( playbackState.currentFrame - lastKeyframeFrame ) >= keyframeInterval ) )
 		{
-			const wtStateBlob& state = states[ playbackState.currentFrame ];
-			if( state.IsValid() )
-			{
-				GetBackbuffer()->Clear();
-				RestoreState( states[ playbackState.currentFrame ] );
-				playbackState.currentFrame += playbackState.pause ? 0 : 1;
-			}
-			else
-			{
-				playbackState.replayState = replayStateCode_t::FINISHED;
-			}
+			std::vector<uint8_t> image;
+			BuildStateImage( image );
+			movie.AddKeyframe( playbackState.currentFrame, std::move( image ) );
 		}
-	}
-	else if ( stateCode == replayStateCode_t::RECORD )
-	{
-		const bool hasNewState = ( toggledFrame && frameState.IsValid() );
-		const bool canRecord = ( playbackState.currentFrame < playbackState.finalFrame );
 
-		if( hasNewState && canRecord )
-		{
-			if( states.size() >= MaxStates ) {
-				states.pop_front();
-			}
-
-			states.push_back( frameState );
-			++playbackState.currentFrame;
+		if ( movie.GetPendingFrameCount() >= MovieFlushFrames ) {
+			StreamMovie();
 		}
 	}
 	else if ( stateCode == replayStateCode_t::FINISHED )
 	{
-		states.clear();
-		frameState.Reset();
+		StreamMovie();
+		WriteFrameHashes();
+		ReturnSRam();
 		playbackState.replayState = replayStateCode_t::LIVE;
 		playbackState.startFrame = -1;
 		playbackState.currentFrame = -1;
@@ -756,8 +1004,249 @@ void wtSystem::RunStateControl( const bool toggledFrame )
 }
 
 
+ButtonFlags wtSystem::SampleInput( const uint32_t controllerIndex )
+{
+	const replayStateCode_t stateCode = playbackState.replayState;
+	if ( stateCode == replayStateCode_t::REPLAY ) {
+		return static_cast<ButtonFlags>( movie.GetInput( playbackState.currentFrame, controllerIndex ) );
+	}
+
+	const ButtonFlags keys = GetInput()->GetKeyBuffer( static_cast<ControllerId>( controllerIndex ) );
+	if ( stateCode != replayStateCode_t::RECORD ) {
+		return keys;
+	}
+
+	// The first read in a frame fixes what the movie stores, so key changes mid-frame can't desync playback
+	const uint8_t controllerBit = static_cast<uint8_t>( 1 << controllerIndex );
+	if ( ( movieLatched & controllerBit ) == 0 )
+	{
+		movieInput[ controllerIndex ] = static_cast<uint8_t>( keys );
+		movieLatched |= controllerBit;
+	}
+	return static_cast<ButtonFlags>( movieInput[ controllerIndex ] );
+}
+
+
+void wtSystem::StartRecording( const int64_t frameCount, const bool powerOn, const uint32_t keyframeInterval )
+{
+	if ( powerOn && !powerOnState.IsValid() ) {
+		return;
+	}
+
+	HoldSRam();
+	if ( powerOn ) {
+		RestoreState( powerOnState );
+	}
+
+	movie.Begin( cart->GetHash(), powerOn ? MOVIE_POWER_ON : 0, keyframeInterval );
+	seekIndex.Clear();
+	if ( !powerOn )
+	{
+		std::vector<uint8_t> image;
+		BuildStateImage( image );
+		movie.AddKeyframe( 0, std::move( image ) );
+	}
+
+	movieLatched = 0;
+	playbackState.replayState = replayStateCode_t::RECORD;
+	playbackState.startFrame = 0;
+	playbackState.currentFrame = 0;
+	playbackState.finalFrame = ( frameCount < 0 ) ? INT64_MAX : frameCount;
+	playbackState.pause = false;
+
+	StreamMovie();
+}
+
+
+bool wtSystem::StartPlayback( const int64_t frame, const bool pause )
+{
+	if ( playbackState.replayState == replayStateCode_t::RECORD ) {
+		StreamMovie();
+	}
+
+	if ( movie.IsEmpty() && !LoadMovie() )
+	{
+		ReturnSRam();
+		playbackState.replayState = replayStateCode_t::LIVE;
+		return false;
+	}
+
+	const int64_t frameCount = static_cast<int64_t>( movie.GetFrameCount() );
+	const int64_t targetFrame = ( frame < 0 ) ? 0 : ( ( frame > frameCount ) ? frameCount : frame );
+
+	// Pausing or resuming in place needs no seek
+	const bool replaying = ( playbackState.replayState == replayStateCode_t::REPLAY );
+	if ( replaying && ( playbackState.currentFrame == targetFrame ) )
+	{
+		playbackState.pause = pause;
+		return true;
+	}
+
+	HoldSRam();
+	playbackState.replayState = replayStateCode_t::REPLAY;
+	playbackState.startFrame = targetFrame;
+	playbackState.finalFrame = frameCount;
+	playbackState.pause = pause;
+
+	if ( !SeekMovie( targetFrame, replaying && ( playbackState.currentFrame < targetFrame ) ) )
+	{
+		ReturnSRam();
+		playbackState.replayState = replayStateCode_t::LIVE;
+		return false;
+	}
+	return true;
+}
+
+
+bool wtSystem::LoadMovie()
+{
+	std::vector<uint8_t> fileData;
+	if ( baseFileName.empty() || !ioWorker.Read( baseFileName + L".wtm", fileData ) ) {
+		return false;
+	}
+
+	seekIndex.Clear();
+	if ( !movie.Parse( fileData.data(), fileData.size() ) || ( movie.GetHeader().romHash != cart->GetHash() ) )
+	{
+		movie.Clear();
+		return false;
+	}
+	return true;
+}
+
+
+bool wtSystem::SeekMovie( const uint64_t frame, const bool fromCurrent )
+{
+	// Start at least two frames back so the target's picture is drawn in full once output is back on
+	const uint64_t restoreFrame = ( frame > 2 ) ? ( frame - 2 ) : 0;
+	const uint64_t currentFrame = static_cast<uint64_t>( playbackState.currentFrame );
+
+	const movieKeyframe_t* keyframe = movie.FindKeyframe( restoreFrame );
+	const uint64_t keyframeFrame = ( keyframe != nullptr ) ? keyframe->frame : 0;
+
+	uint64_t indexFrame = 0;
+	const bool indexed = seekIndex.Find( restoreFrame, indexFrame );
+
+	if ( fromCurrent && ( !indexed || ( currentFrame >= indexFrame ) ) && ( ( keyframe == nullptr ) || ( currentFrame >= keyframeFrame ) ) )
+	{
+		// Playing forward from here is already the shortest path
+	}
+	else if ( indexed && ( ( keyframe == nullptr ) || ( indexFrame >= keyframeFrame ) ) )
+	{
+		if ( !seekIndex.Load( indexFrame, seekScratch ) ) {
+			return false;
+		}
+		Serializer serializer( seekScratch.data(), static_cast<uint32_t>( seekScratch.size() ), serializeMode_t::LOAD );
+		Serialize( serializer );
+		playbackState.currentFrame = indexFrame;
+	}
+	else
+	{
+		// A keyframe this build can't read, e.g. one saved by a newer build, falls back to an earlier one and then to power-on.
+		// Failed restores change nothing, so the next candidate starts from the same machine.
+		while ( ( keyframe != nullptr ) && !RestoreStateImage( keyframe->image ) ) {
+			keyframe = ( keyframe->frame > 0 ) ? movie.FindKeyframe( keyframe->frame - 1 ) : nullptr;
+		}
+
+		if ( keyframe != nullptr ) {
+			playbackState.currentFrame = keyframe->frame;
+		} else if ( ( ( movie.GetHeader().flags & MOVIE_POWER_ON ) != 0 ) && powerOnState.IsValid() ) {
+			RestoreState( powerOnState );
+			playbackState.currentFrame = 0;
+		} else {
+			return false;
+		}
+	}
+
+	// AdvanceMovie turns output back on for the frame before the target
+	seekFrame = static_cast<int64_t>( frame );
+	suppressOutput = ( ( playbackState.currentFrame + 1 ) < seekFrame );
+
+	// Most of a frame per run while far off, then a scanline at a time so it stops just past the target's frame toggle
+	static const masterCycle_t scanlineStep( PPU::ScanlineCycles * PpuClockDivide );
+	static const masterCycle_t frameStep( PPU::ScanlineCycles * PPU::ScreenHeight * PpuClockDivide );
+	while ( ( playbackState.currentFrame < seekFrame ) && ( playbackState.replayState == replayStateCode_t::REPLAY ) )
+	{
+		const bool farOff = ( playbackState.currentFrame + 2 ) < seekFrame;
+		if ( !Run( sysCycles + ( farOff ? frameStep : scanlineStep ) ) ) {
+			break;
+		}
+		IndexMovieFrame();
+	}
+	suppressOutput = false;
+	return true;
+}
+
+
+void wtSystem::IndexMovieFrame()
+{
+	const replayStateCode_t stateCode = playbackState.replayState;
+	if ( ( stateCode != replayStateCode_t::RECORD ) && ( stateCode != replayStateCode_t::REPLAY ) ) {
+		return;
+	}
+
+	// The budget is read each time so it follows config changes
+	seekIndex.SetBudget( static_cast<size_t>( config->sys.seekIndexMB ) << 20 );
+
+	const uint64_t frame = static_cast<uint64_t>( playbackState.currentFrame );
+	if ( seekIndex.Wants( frame ) )
+	{
+		RecordSate( seekState );
+		seekIndex.Add( frame, seekState.GetPtr(), seekState.GetBufferSize() );
+	}
+}
+
+
+void wtSystem::AdvanceMovie()
+{
+	const replayStateCode_t stateCode = playbackState.replayState;
+	if ( stateCode == replayStateCode_t::RECORD )
+	{
+		// Controllers the game never read this frame are stored as they're held now
+		for ( uint32_t i = 0; i < MovieControllers; ++i ) {
+			SampleInput( i );
+		}
+		movie.AddFrame( movieInput );
+		movieLatched = 0;
+	}
+	else if ( stateCode != replayStateCode_t::REPLAY )
+	{
+		return;
+	}
+
+	++playbackState.currentFrame;
+	if ( suppressOutput && ( ( playbackState.currentFrame + 1 ) >= seekFrame ) ) {
+		suppressOutput = false;
+	}
+	if ( playbackState.currentFrame >= playbackState.finalFrame ) {
+		playbackState.replayState = replayStateCode_t::FINISHED;
+	}
+}
+
+
+void wtSystem::StreamMovie()
+{
+	if ( movie.IsEmpty() || baseFileName.empty() ) {
+		return;
+	}
+
+	std::vector<uint8_t> data;
+	const bool rewrite = movie.EncodePending( data );
+	if ( rewrite ) {
+		ioWorker.Write( baseFileName + L".wtm", std::move( data ), false );
+	} else if ( !data.empty() ) {
+		ioWorker.Append( baseFileName + L".wtm", std::move( data ) );
+	}
+}
+
+
 void wtSystem::UpdateDebugImages()
 {
+	TIMELINE_SCOPE( "UpdateDebugImages" );
+
+	// Debug views fetch CHR like the renderer does; keep them out of the CDL
+	cdl.SetPaused( true );
+
 	RGBA palette[ 4 ];
 	for ( uint32_t i = 0; i < 4; ++i )
 	{
@@ -775,6 +1264,8 @@ void wtSystem::UpdateDebugImages()
 	ppu.DrawDebugPatternTables( patternTable0, palette, 0, false );
 	ppu.DrawDebugPatternTables( patternTable1, palette, 1, false );
 
+	cdl.SetPaused( false );
+
 	DebugPrintFlushLog();
 }
 
@@ -783,6 +1274,58 @@ void wtSystem::SaveFrameState()
 {
 	RecordSate( frameState );
 	dbgInfo.stateCycle = sysCycles;
+
+	// A seek's skipped frames were never drawn, so there is nothing to hash
+	if ( ( ( config->sys.flags & emulationFlags_t::FRAME_HASH ) != 0 ) && !suppressOutput )
+	{
+		HashFrame();
+		if ( playbackState.replayState == replayStateCode_t::REPLAY ) {
+			replayHashes.push_back( frameHash );
+		}
+	}
+	else
+	{
+		frameHash = {};
+	}
+}
+
+
+void wtSystem::HashFrame()
+{
+	PERF_SCOPE( perf, PERF_STATE );
+
+	// The finished buffer stays untouched until the next vblank toggles it
+	const wtDisplayImage& image = frameBuffer[ finishedFrameIx ];
+
+	frameHash.frame	= frameNumber;
+	frameHash.video	= FastHash64( image.GetRawBuffer(), image.GetBufferLength() * sizeof( uint32_t ) );
+	frameHash.ram	= FastHash64( memory, PhysicalMemorySize );
+	frameHash.state	= FastHash64( frameState.GetPtr(), frameState.GetBufferSize() );
+}
+
+
+void wtSystem::WriteFrameHashes()
+{
+	if ( replayHashes.empty() ) {
+		return;
+	}
+
+	if ( !baseFileName.empty() )
+	{
+		frameHashFileHeader_t header = {};
+		header.magic		= FrameHashFileMagic;
+		header.version		= FrameHashFileVersion;
+		header.romHash		= cart->GetHash();
+		header.frameCount	= replayHashes.size();
+
+		const size_t recordBytes = replayHashes.size() * sizeof( frameHash_t );
+		std::vector<uint8_t> file( sizeof( header ) + recordBytes );
+		memcpy( file.data(), &header, sizeof( header ) );
+		memcpy( file.data() + sizeof( header ), replayHashes.data(), recordBytes );
+
+		ioWorker.Write( baseFileName + L".fhash", std::move( file ), false );
+	}
+	replayHashes.clear();
 }
 
 
@@ -797,13 +1340,30 @@ void wtSystem::ToggleFrame()
 	frameNumber++;
 	toggledFrame = true;
 	frameTogglesPerRun++;
+
+	// Per-frame histograms are cut on the picture, not on Run() calls, which may cover several or a scanline
+	cpu.profiler.NewFrame();
+
+	AdvanceMovie();
 }
 
 
 int wtSystem::RunEpoch( const std::chrono::nanoseconds& runEpoch )
 {
+	TIMELINE_SCOPE( "RunEpoch" );
+
 	ProcessCommands();
 
+	// Hold at the breakpoint until a RESUME command
+	if ( breakpoints.HasHit() ) {
+		return true;
+	}
+
+	// A paused movie holds its frame until the next REPLAY command
+	if ( ( playbackState.replayState == replayStateCode_t::REPLAY ) && playbackState.pause ) {
+		return true;
+	}
+
 	const nano_t e = nano_t( runEpoch.count() );
 
 	masterCycle_t cyclesPerFrame = masterCycle_t( overflowCycles );
@@ -826,7 +1386,7 @@ int wtSystem::RunEpoch( const std::chrono::nanoseconds& runEpoch )
 		cyclesPerFrame = masterCycle_t( NanoToCycle( e ) );
 	}
 	
-	RunStateControl( toggledFrame );
+	RunStateControl();
 
 	const masterCycle_t startCycle = sysCycles;
 	const masterCycle_t nextCycle = sysCycles + cyclesPerFrame;
@@ -843,7 +1403,11 @@ int wtSystem::RunEpoch( const std::chrono::nanoseconds& runEpoch )
 	emuTime.Stop();
 
 	const masterCycle_t endCycle = sysCycles;
-	overflowCycles += ( endCycle - nextCycle ).count();
+	if ( breakpoints.HasHit() ) {
+		overflowCycles = 0;
+	} else {
+		overflowCycles += ( endCycle - nextCycle ).count();
+	}
 
 	dbgInfo.cycleEnd = endCycle;
 
@@ -855,17 +1419,16 @@ int wtSystem::RunEpoch( const std::chrono::nanoseconds& runEpoch )
 	dbgInfo.frameNumber = frameNumber;
 	dbgInfo.framePerRun += frameNumber - previousFrameNumber;
 	dbgInfo.runInvocations++;
+#if PERF_COUNTERS == 1
+	perf.EndEpoch( dbgInfo.perf );
+#endif
 
 	DebugPrintFlushLog();
+	DebugFlushProfile();
 
-	if ( ( config->sys.flags & emulationFlags_t::HEADLESS ) != 0 ) {
-		return isRunning;
-	}
-
-	if ( !isRunning )
-	{
+	// Headless runs persist battery saves too; SaveSRam skips in-memory ROMs and clones
+	if ( !isRunning || ( sramDirty && ( ( frameNumber - sramFlushFrame ) >= SramFlushFrames ) ) ) {
 		SaveSRam();
-		return false;
 	}
 
 	return isRunning;
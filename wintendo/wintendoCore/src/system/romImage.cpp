@@ -0,0 +1,209 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "romImage.h"
+#include "../../include/tomtendo/util.h"
+#include <map>
+#include <mutex>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Weak entries: the last cart to drop an image unmaps it, the cache only lets live carts share it
+using RomCache = std::map< std::wstring, std::weak_ptr<const wtRomImage> >;
+
+static std::mutex	cacheLock;
+static RomCache		cache;
+
+
+static const uint8_t* MapFile( const std::wstring& path, size_t& outSize )
+{
+	outSize = 0;
+#ifdef _WIN32
+	HANDLE file = CreateFileW( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		return nullptr;
+	}
+
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( file, &fileSize ) || ( fileSize.QuadPart == 0 ) )
+	{
+		CloseHandle( file );
+		return nullptr;
+	}
+
+	// The view keeps the mapping and file alive after their handles close
+	HANDLE mapping = CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	CloseHandle( file );
+	if ( mapping == nullptr ) {
+		return nullptr;
+	}
+
+	const void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if ( view == nullptr ) {
+		return nullptr;
+	}
+
+	outSize = static_cast<size_t>( fileSize.QuadPart );
+	return static_cast<const uint8_t*>( view );
+#else
+	const std::string narrowPath( path.begin(), path.end() );
+	const int fd = open( narrowPath.c_str(), O_RDONLY );
+	if ( fd < 0 ) {
+		return nullptr;
+	}
+
+	struct stat fileStat;
+	if ( ( fstat( fd, &fileStat ) != 0 ) || ( fileStat.st_size == 0 ) )
+	{
+		close( fd );
+		return nullptr;
+	}
+
+	void* view = mmap( nullptr, static_cast<size_t>( fileStat.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( view == MAP_FAILED ) {
+		return nullptr;
+	}
+
+	outSize = static_cast<size_t>( fileStat.st_size );
+	return static_cast<const uint8_t*>( view );
+#endif
+}
+
+
+static void UnmapFile( const uint8_t* view, const size_t size )
+{
+#ifdef _WIN32
+	UnmapViewOfFile( view );
+#else
+	munmap( const_cast<uint8_t*>( view ), size );
+#endif
+}
+
+
+wtRomImage::wtRomImage()
+{
+	data = nullptr;
+	size = 0;
+	hash = 0;
+	mapped = false;
+}
+
+
+wtRomImage::~wtRomImage()
+{
+	if ( mapped && ( data != nullptr ) ) {
+		UnmapFile( data, size );
+	}
+	data = nullptr;
+	size = 0;
+}
+
+
+std::shared_ptr<const wtRomImage> wtRomImage::Open( const std::wstring& path )
+{
+	std::lock_guard<std::mutex> guard( cacheLock );
+
+	auto it = cache.find( path );
+	if ( it != cache.end() )
+	{
+		std::shared_ptr<const wtRomImage> image = it->second.lock();
+		if ( image != nullptr ) {
+			return image;
+		}
+	}
+
+	size_t fileSize;
+	const uint8_t* view = MapFile( path, fileSize );
+	if ( view == nullptr ) {
+		return nullptr;
+	}
+
+	std::shared_ptr<wtRomImage> image( new wtRomImage() );
+	image->data = view;
+	image->size = fileSize;
+	image->mapped = true;
+	if ( fileSize > HeaderSize ) {
+		image->hash = Tomtendo::Hash64( view + HeaderSize, fileSize - HeaderSize );
+	}
+
+	cache[ path ] = image;
+	return image;
+}
+
+
+std::shared_ptr<const wtRomImage> wtRomImage::Borrow( const uint8_t* data, const size_t sizeInBytes )
+{
+	if ( ( data == nullptr ) || ( sizeInBytes == 0 ) ) {
+		return nullptr;
+	}
+
+	std::shared_ptr<wtRomImage> image( new wtRomImage() );
+	image->data = data;
+	image->size = sizeInBytes;
+	if ( sizeInBytes > HeaderSize ) {
+		image->hash = Tomtendo::Hash64( data + HeaderSize, sizeInBytes - HeaderSize );
+	}
+	return image;
+}
+
+
+void wtRomImage::PurgeCache()
+{
+	std::lock_guard<std::mutex> guard( cacheLock );
+
+	for ( auto it = cache.begin(); it != cache.end(); )
+	{
+		if ( it->second.expired() ) {
+			it = cache.erase( it );
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+
+const uint8_t* wtRomImage::GetData() const
+{
+	return data;
+}
+
+
+size_t wtRomImage::GetSize() const
+{
+	return size;
+}
+
+
+uint64_t wtRomImage::GetHash() const
+{
+	return hash;
+}
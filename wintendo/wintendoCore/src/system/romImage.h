@@ -0,0 +1,58 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <memory>
+
+// Read-only iNES image shared by every cart booted from it. File images are
+// memory mapped and cached by path, so booting the same ROM again never
+// touches the disk. Borrowed images reference caller memory without copying.
+class wtRomImage
+{
+public:
+	static const size_t HeaderSize = 16;
+
+	~wtRomImage();
+
+	wtRomImage( const wtRomImage& ) = delete;
+	wtRomImage& operator=( const wtRomImage& ) = delete;
+
+	static std::shared_ptr<const wtRomImage>	Open( const std::wstring& path );
+	static std::shared_ptr<const wtRomImage>	Borrow( const uint8_t* data, const size_t sizeInBytes ); // Caller keeps 'data' alive
+	static void									PurgeCache(); // Drops entries for files no cart still references
+
+	const uint8_t*	GetData() const;
+	size_t			GetSize() const;
+	uint64_t		GetHash() const; // Hash of the image past the header
+
+private:
+	wtRomImage();
+
+	const uint8_t*	data;
+	size_t			size;
+	uint64_t		hash;
+	bool			mapped;
+};
@@ -0,0 +1,145 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "seekIndex.h"
+#include "compress.h"
+
+wtSeekIndex::wtSeekIndex()
+{
+	budget = 0;
+	Clear();
+}
+
+
+void wtSeekIndex::Clear()
+{
+	states.clear();
+	bytes = 0;
+	spacing = MinSpacing;
+}
+
+
+void wtSeekIndex::SetBudget( const size_t budgetBytes )
+{
+	budget = budgetBytes;
+	Thin();
+}
+
+
+bool wtSeekIndex::Wants( const uint64_t frame ) const
+{
+	if ( budget == 0 ) {
+		return false;
+	}
+
+	const uint64_t bucketStart = frame - ( frame % spacing );
+	const auto it = states.lower_bound( bucketStart );
+	return ( it == states.end() ) || ( it->first >= ( bucketStart + spacing ) );
+}
+
+
+void wtSeekIndex::Add( const uint64_t frame, const uint8_t* state, const uint32_t stateSize )
+{
+	if ( !Wants( frame ) ) {
+		return;
+	}
+
+	std::vector<uint8_t>& packed = states[ frame ];
+	wtLz::Compress( state, stateSize, packed );
+	packed.shrink_to_fit();
+	bytes += packed.size();
+
+	Thin();
+}
+
+
+bool wtSeekIndex::Find( const uint64_t frame, uint64_t& outFrame ) const
+{
+	auto it = states.upper_bound( frame );
+	if ( it == states.begin() ) {
+		return false;
+	}
+	--it;
+	outFrame = it->first;
+	return true;
+}
+
+
+bool wtSeekIndex::Load( const uint64_t frame, std::vector<uint8_t>& outState ) const
+{
+	const auto it = states.find( frame );
+	if ( it == states.end() ) {
+		return false;
+	}
+	return wtLz::Decompress( it->second.data(), static_cast<uint32_t>( it->second.size() ), outState );
+}
+
+
+uint32_t wtSeekIndex::GetSpacing() const
+{
+	return spacing;
+}
+
+
+size_t wtSeekIndex::GetCount() const
+{
+	return states.size();
+}
+
+
+size_t wtSeekIndex::GetBytes() const
+{
+	return bytes;
+}
+
+
+void wtSeekIndex::Thin()
+{
+	while ( ( bytes > budget ) && !states.empty() )
+	{
+		// Past 2^31 frames the budget can't hold even one state; give up on indexing
+		if ( spacing >= ( 1u << 31 ) )
+		{
+			states.clear();
+			bytes = 0;
+			return;
+		}
+		spacing *= 2;
+
+		uint64_t keptBucket = UINT64_MAX;
+		for ( auto it = states.begin(); it != states.end(); )
+		{
+			const uint64_t bucket = it->first / spacing;
+			if ( bucket == keptBucket )
+			{
+				bytes -= it->second.size();
+				it = states.erase( it );
+				continue;
+			}
+			keptBucket = bucket;
+			++it;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// Compressed machine states taken while a movie records, plays or seeks, so a
+// seek only re-emulates the few frames past the nearest one. Frames are split
+// into buckets of 'spacing' frames holding at most one state each; when the
+// index outgrows its budget the spacing doubles and every other bucket's
+// state is dropped, so memory stays bounded however long the movie gets.
+class wtSeekIndex
+{
+public:
+	static const uint32_t	MinSpacing = 8;
+
+	wtSeekIndex();
+
+	void		Clear();
+	void		SetBudget( const size_t bytes );
+
+	// True while 'frame' lands in a bucket with no state yet
+	bool		Wants( const uint64_t frame ) const;
+	void		Add( const uint64_t frame, const uint8_t* state, const uint32_t stateSize );
+
+	// Finds the closest state at or before 'frame'. Returns false if there is none.
+	bool		Find( const uint64_t frame, uint64_t& outFrame ) const;
+	bool		Load( const uint64_t frame, std::vector<uint8_t>& outState ) const;
+
+	uint32_t	GetSpacing() const;
+	size_t		GetCount() const;
+	size_t		GetBytes() const;
+
+private:
+	void		Thin();
+
+	std::map<uint64_t, std::vector<uint8_t>>	states;
+	size_t										bytes;
+	size_t										budget;
+	uint32_t									spacing;
+};
@@ -25,6 +25,40 @@
 
 namespace Tomtendo
 {
+	wtStateBlob::wtStateBlob( const wtStateBlob& blob )
+	{
+		bytes = nullptr;
+		byteCount = 0;
+		*this = blob;
+	}
+
+	wtStateBlob& wtStateBlob::operator=( const wtStateBlob& blob )
+	{
+		if ( this == &blob ) {
+			return *this;
+		}
+
+		if ( blob.bytes == nullptr ) {
+			Reset();
+		} else {
+			Resize( blob.byteCount );
+			memcpy( bytes, blob.bytes, byteCount );
+		}
+
+		header = blob.header;
+		if ( blob.header.memory != nullptr ) {
+			header.memory = bytes + ( blob.header.memory - blob.bytes );
+		}
+		if ( blob.header.vram != nullptr ) {
+			header.vram = bytes + ( blob.header.vram - blob.bytes );
+		}
+		if ( blob.header.sram != nullptr ) {
+			header.sram = bytes + ( blob.header.sram - blob.bytes );
+		}
+		cycle = blob.cycle;
+		return *this;
+	}
+
 	bool wtStateBlob::IsValid() const
 	{
 		return ( byteCount > 0 );
@@ -40,12 +74,29 @@ namespace Tomtendo
 		return bytes;
 	}
 
-	void  wtStateBlob::Set( Serializer& s, const masterCycle_t sysCycle )
+	const uint8_t* wtStateBlob::GetPtr() const
 	{
+		return bytes;
+	}
+
+	void wtStateBlob::Resize( const uint32_t sizeInBytes )
+	{
+		if ( ( bytes != nullptr ) && ( byteCount == sizeInBytes ) ) {
+			return;
+		}
 		Reset();
-		byteCount = s.CurrentSize();
-		bytes = new uint8_t[ byteCount ];
-		memcpy( bytes, s.GetPtr(), byteCount );
+		bytes = new uint8_t[ sizeInBytes ];
+		byteCount = sizeInBytes;
+	}
+
+	void  wtStateBlob::Set( Serializer& s, const masterCycle_t sysCycle )
+	{
+		// Serializers wrapping this blob's own buffer already hold the data
+		if ( s.GetPtr() != bytes )
+		{
+			Resize( s.CurrentSize() );
+			memcpy( bytes, s.GetPtr(), byteCount );
+		}
 
 		serializerHeader_t::section_t* memSection;
 		s.FindLabel( STATE_MEMORY_LABEL, &memSection );
@@ -57,6 +108,18 @@ namespace Tomtendo
 		header.vram = bytes + vramSection->offset;
 		header.vramSize = vramSection->size;
 
+		serializerHeader_t::section_t* sramSection;
+		if ( s.FindLabel( STATE_SRAM_LABEL, &sramSection ) )
+		{
+			header.sram = bytes + sramSection->offset;
+			header.sramSize = sramSection->size;
+		}
+		else
+		{
+			header.sram = nullptr;
+			header.sramSize = 0;
+		}
+
 		cycle = sysCycle;
 	}
 
@@ -75,11 +138,12 @@ namespace Tomtendo
 
 	void  wtStateBlob::Reset()
 	{
-		if ( bytes == nullptr )
+		if ( bytes != nullptr )
 		{
 			delete[] bytes;
-			byteCount = 0;
+			bytes = nullptr;
 		}
+		byteCount = 0;
 		cycle = masterCycle_t( 0 );
 	}
 };
\ No newline at end of file
@@ -0,0 +1,198 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "../../include/tomtendo/interface.h"
+#include <cstring>
+
+namespace Tomtendo
+{
+	wtStateFile::wtStateFile()
+	{
+		image = nullptr;
+		imageSize = 0;
+		header = {};
+		sections = nullptr;
+		sectionStride = 0;
+	}
+
+
+	bool wtStateFile::Parse( const uint8_t* data, const uint32_t sizeInBytes )
+	{
+		*this = wtStateFile();
+
+		if ( ( data == nullptr ) || ( sizeInBytes < sizeof( stateFileHeader_t ) ) ) {
+			return false;
+		}
+
+		stateFileHeader_t fileHeader;
+		memcpy( &fileHeader, data, sizeof( fileHeader ) );
+
+		if ( fileHeader.magic != StateFileMagic ) {
+			return false;
+		}
+
+		if ( ( fileHeader.version == 0 ) || ( fileHeader.headerSize < sizeof( stateFileHeader_t ) ) ) {
+			return false;
+		}
+
+		// Entries only grow, so a newer build's table is still read up to the fields known here
+		const uint32_t stride = ( fileHeader.version < 3 ) ? StateLegacySectionSize : fileHeader.sectionEntrySize;
+		if ( stride < ( ( fileHeader.version < 3 ) ? StateLegacySectionSize : sizeof( stateFileSection_t ) ) ) {
+			return false;
+		}
+
+		const uint64_t sectionEnd = fileHeader.sectionOffset + static_cast<uint64_t>( fileHeader.sectionCount ) * stride;
+		const uint64_t payloadEnd = fileHeader.payloadOffset + static_cast<uint64_t>( fileHeader.payloadSize );
+		if ( ( sectionEnd > sizeInBytes ) || ( payloadEnd > sizeInBytes ) ) {
+			return false;
+		}
+
+		const uint8_t* payload = data + fileHeader.payloadOffset;
+		if ( Hash32( payload, fileHeader.payloadSize ) != fileHeader.payloadChecksum ) {
+			return false;
+		}
+
+		image = data;
+		imageSize = sizeInBytes;
+		header = fileHeader;
+		sections = data + fileHeader.sectionOffset;
+		sectionStride = stride;
+
+		for ( uint32_t i = 0; i < fileHeader.sectionCount; ++i )
+		{
+			const stateFileSection_t section = GetSection( i );
+			if ( ( static_cast<uint64_t>( section.offset ) + section.size ) > fileHeader.payloadSize )
+			{
+				*this = wtStateFile();
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	bool wtStateFile::IsValid() const
+	{
+		return ( image != nullptr );
+	}
+
+
+	const stateFileHeader_t& wtStateFile::GetHeader() const
+	{
+		return header;
+	}
+
+
+	const uint8_t* wtStateFile::GetPayload() const
+	{
+		return ( image != nullptr ) ? ( image + header.payloadOffset ) : nullptr;
+	}
+
+
+	uint32_t wtStateFile::GetPayloadSize() const
+	{
+		return header.payloadSize;
+	}
+
+
+	stateFileSection_t wtStateFile::GetSection( const uint32_t sectionIx ) const
+	{
+		stateFileSection_t section = {};
+		memcpy( &section, sections + sectionIx * sectionStride, ( header.version < 3 ) ? StateLegacySectionSize : sizeof( section ) );
+
+		if ( header.version < 3 ) {
+			section.version = ( section.tag == HashString32( STATE_SYSTEM_LABEL ) ) ? header.version : StateSectionVersion;
+		}
+		return section;
+	}
+
+
+	bool wtStateFile::FindSection( const uint32_t tag, const uint8_t** outData, uint32_t* outSize, uint32_t* outVersion ) const
+	{
+		for ( uint32_t i = 0; i < header.sectionCount; ++i )
+		{
+			const stateFileSection_t section = GetSection( i );
+			if ( section.tag == tag )
+			{
+				*outData = GetPayload() + section.offset;
+				*outSize = section.size;
+				if ( outVersion != nullptr ) {
+					*outVersion = section.version;
+				}
+				return true;
+			}
+		}
+
+		*outData = nullptr;
+		*outSize = 0;
+		return false;
+	}
+
+
+	bool wtStateFile::FindSection( const char* name, const uint8_t** outData, uint32_t* outSize, uint32_t* outVersion ) const
+	{
+		return FindSection( HashString32( name ), outData, outSize, outVersion );
+	}
+
+
+	uint32_t wtStateFile::CurrentVersion( const uint32_t tag )
+	{
+		return ( tag == HashString32( STATE_SYSTEM_LABEL ) ) ? StateSystemVersion : StateSectionVersion;
+	}
+
+
+	void wtStateFile::Build( Serializer& serializer, const uint64_t romHash, const uint64_t cycle, std::vector<uint8_t>& outImage )
+	{
+		const uint32_t sectionCount = serializer.GetSectionCount();
+		const uint32_t sectionBytes = sectionCount * sizeof( stateFileSection_t );
+
+		stateFileHeader_t fileHeader = {};
+		fileHeader.magic			= StateFileMagic;
+		fileHeader.version			= StateFileVersion;
+		fileHeader.headerSize		= sizeof( stateFileHeader_t );
+		fileHeader.sectionCount		= sectionCount;
+		fileHeader.sectionOffset	= sizeof( stateFileHeader_t );
+		fileHeader.payloadOffset	= fileHeader.sectionOffset + sectionBytes;
+		fileHeader.payloadSize		= serializer.CurrentSize();
+		fileHeader.payloadChecksum	= Hash32( serializer.GetPtr(), serializer.CurrentSize() );
+		fileHeader.sectionEntrySize	= sizeof( stateFileSection_t );
+		fileHeader.romHash			= romHash;
+		fileHeader.cycle			= cycle;
+
+		outImage.resize( fileHeader.payloadOffset + fileHeader.payloadSize );
+		uint8_t* dest = outImage.data();
+
+		memcpy( dest, &fileHeader, sizeof( fileHeader ) );
+		dest += sizeof( fileHeader );
+
+		for ( uint32_t i = 0; i < sectionCount; ++i )
+		{
+			const serializerHeader_t::section_t& section = serializer.GetSection( i );
+			const stateFileSection_t fileSection = { section.tag, section.offset, section.size, CurrentVersion( section.tag ) };
+			memcpy( dest, &fileSection, sizeof( fileSection ) );
+			dest += sizeof( fileSection );
+		}
+
+		memcpy( dest, serializer.GetPtr(), fileHeader.payloadSize );
+	}
+};
@@ -23,236 +23,402 @@
 
 #include "NesSystem.h"
 
-template<typename Cycle>
-static inline void SerializeCycle( Serializer& serializer, Cycle& c )
+template<class V, typename Cycle>
+static inline void SerializeCycle( V& visitor, Cycle& c )
 {
-	if ( serializer.GetMode() == serializeMode_t::LOAD )
-	{
-		uint64_t cycles;
-		serializer.Next64b( *reinterpret_cast<uint64_t*>( &cycles ) );
+	uint64_t cycles = static_cast<uint64_t>( c.count() );
+	visitor.Field( cycles );
+	if ( V::Loading ) {
 		c = Cycle( cycles );
 	}
-	else if ( serializer.GetMode() == serializeMode_t::STORE )
-	{
-		uint64_t cycles = static_cast<uint64_t>( c.count() );
-		serializer.Next64b( *reinterpret_cast<uint64_t*>( &cycles ) );
+}
+
+
+template<class V, typename Counter>
+static inline void SerializeBitCounter( V& visitor, Counter& c )
+{
+	uint16_t value = c.Value();
+	visitor.Field( value );
+	if ( V::Loading ) {
+		c.Reload( value );
 	}
 }
 
 
-template<typename Counter>
-static inline void SerializeBitCounter( Serializer& serializer, Counter& c )
+template<class V>
+static inline void SerializeEnvelope( V& visitor, envelope_t& e )
+{
+	visitor.Field( e.startFlag );
+	visitor.Field( e.decayLevel );
+	visitor.Field( e.divCounter );
+	visitor.Field( e.output );
+}
+
+
+template<class V>
+static inline void SerializeSweep( V& visitor, sweep_t& s )
+{
+	visitor.Field( s.mute );
+	visitor.Field( s.reloadFlag );
+	visitor.Field( s.period );
+	SerializeBitCounter( visitor, s.divider );
+}
+
+
+uint32_t wtSystem::GetStateSize()
+{
+	wtStateSizer sizer;
+	Visit( sizer );
+	return sizer.Size();
+}
+
+
+void wtSystem::Serialize( Serializer& serializer )
 {
-	if ( serializer.GetMode() == serializeMode_t::LOAD )
+	// One bounds check for the whole machine, the visitors below copy unchecked
+	if ( !serializer.CanStore( GetStateSize() ) ) {
+		assert( 0 );
+		return;
+	}
+
+	if ( serializer.GetMode() == serializeMode_t::STORE )
 	{
-		uint16_t value;
-		serializer.Next16b( *reinterpret_cast<uint16_t*>( &value ) );
-		c.Reload( value );
+		wtStateWriter writer( serializer );
+		Visit( writer );
+	}
+	else
+	{
+		wtStateReader reader( serializer );
+		Visit( reader );
 	}
-	else if ( serializer.GetMode() == serializeMode_t::STORE )
+}
+
+
+template<class V>
+void wtSystem::VisitSystem( V& visitor, const uint32_t version )
+{
+	SerializeCycle( visitor, sysCycles );
+
+	visitor.Field( frameNumber );
+	visitor.Field( strobeOn );
+	visitor.Field( btnShift[ 0 ] );
+	visitor.Field( btnShift[ 1 ] );
+
+	if ( version >= 2 )
 	{
-		uint16_t value = c.Value();
-		serializer.Next16b( *reinterpret_cast<uint16_t*>( &value ) );
+		visitor.Field( mirrorMode );		// MMC1 and MMC3 only set it on register writes
+		visitor.Field( overflowCycles );
+		visitor.Field( cpu.dmcTransfer );
 	}
 }
 
 
-static inline void SerializeEnvelope( Serializer& serializer, envelope_t& e )
+template<class V>
+void wtSystem::VisitMemory( V& visitor )
 {
-	serializer.NextBool( e.startFlag );
-	serializer.Next8b( e.decayLevel );
-	serializer.Next8b( e.divCounter );
-	serializer.Next8b( e.output );
+	visitor.Array( memory, PhysicalMemorySize );
 }
 
 
-static inline void SerializeSweep( Serializer& serializer, sweep_t& s )
+template<class V>
+void wtSystem::Visit( V& visitor )
 {
-	serializer.NextBool( s.mute );
-	serializer.NextBool( s.reloadFlag );
-	serializer.Next16b( s.period );
-	SerializeBitCounter( serializer, s.divider );
+	// Labels only record each section's offset and size in the header, the payload is the fields back to back
+	visitor.BeginLabel( STATE_SYSTEM_LABEL );
+	VisitSystem( visitor, StateSystemVersion );
+	visitor.EndLabel( STATE_SYSTEM_LABEL );
+
+	visitor.BeginLabel( STATE_MEMORY_LABEL );
+	VisitMemory( visitor );
+	visitor.EndLabel( STATE_MEMORY_LABEL );
+
+	visitor.BeginLabel( STATE_CPU_LABEL );
+	cpu.Visit( visitor );
+	visitor.EndLabel( STATE_CPU_LABEL );
+
+	visitor.BeginLabel( STATE_PPU_LABEL );
+	ppu.Visit( visitor );
+	visitor.EndLabel( STATE_PPU_LABEL );
+
+	visitor.BeginLabel( STATE_APU_LABEL );
+	apu.Visit( visitor );
+	visitor.EndLabel( STATE_APU_LABEL );
+
+	visitor.BeginLabel( STATE_MAPPER_LABEL );
+	cart->mapper->Serialize( visitor );
+	visitor.EndLabel( STATE_MAPPER_LABEL );
 }
 
 
-void wtSystem::Serialize( Serializer& serializer )
+// Calls func( bit, label, visit ) for each section in the mask, in Visit() order,
+// where visit( visitor, version ) walks that component as laid out in the given version
+template<class F>
+void wtSystem::VisitSections( const uint32_t sectionMask, F func )
 {
-	SerializeCycle( serializer, sysCycles );
+	if ( sectionMask & STATE_SECTION_SYSTEM ) {
+		func( STATE_SECTION_SYSTEM, STATE_SYSTEM_LABEL, [&]( auto& v, const uint32_t version ) { VisitSystem( v, version ); } );
+	}
+	if ( sectionMask & STATE_SECTION_MEMORY ) {
+		func( STATE_SECTION_MEMORY, STATE_MEMORY_LABEL, [&]( auto& v, const uint32_t /*version*/ ) { VisitMemory( v ); } );
+	}
+	if ( sectionMask & STATE_SECTION_CPU ) {
+		func( STATE_SECTION_CPU, STATE_CPU_LABEL, [&]( auto& v, const uint32_t /*version*/ ) { cpu.Visit( v ); } );
+	}
+	if ( sectionMask & STATE_SECTION_PPU ) {
+		func( STATE_SECTION_PPU, STATE_PPU_LABEL, [&]( auto& v, const uint32_t /*version*/ ) { ppu.Visit( v ); } );
+	}
+	if ( sectionMask & STATE_SECTION_APU ) {
+		func( STATE_SECTION_APU, STATE_APU_LABEL, [&]( auto& v, const uint32_t /*version*/ ) { apu.Visit( v ); } );
+	}
+	if ( sectionMask & STATE_SECTION_MAPPER ) {
+		func( STATE_SECTION_MAPPER, STATE_MAPPER_LABEL, [&]( auto& v, const uint32_t /*version*/ ) { cart->mapper->Serialize( v ); } );
+	}
+}
 
-	serializer.Next64b( frameNumber );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &strobeOn ) );
-	serializer.Next8b( btnShift[ 0 ] );
-	serializer.Next8b( btnShift[ 1 ] );
 
-	serializer.NewLabel( STATE_MEMORY_LABEL );
-	serializer.NextArray( memory, PhysicalMemorySize );
-	serializer.EndLabel( STATE_MEMORY_LABEL );
+// All or nothing: every section present must have the size its version reads before any of
+// them is applied, so a mismatched file never leaves the machine half restored. Sections the
+// file lacks, and fields an older version lacks, are left at their power-on values.
+bool wtSystem::LoadSections( const wtStateFile& file, const uint32_t sectionMask )
+{
+	const char* badSection = nullptr;
+	bool newerSection = false;
+	VisitSections( sectionMask, [&]( const uint32_t /*bit*/, const char* label, auto visit )
+	{
+		const uint8_t* data;
+		uint32_t size;
+		uint32_t version;
+		if ( ( badSection != nullptr ) || !file.FindSection( label, &data, &size, &version ) ) {
+			return;
+		}
+
+		newerSection = ( version > wtStateFile::CurrentVersion( HashString32( label ) ) );
+		if ( newerSection )
+		{
+			badSection = label;
+			return;
+		}
+
+		wtStateSizer sizer;
+		visit( sizer, version );
+		if ( sizer.Size() != size ) {
+			badSection = label;
+		}
+	} );
+
+	if ( badSection != nullptr )
+	{
+		fprintf( stderr, "State rejected: the %s section %s\n", badSection, newerSection ? "was saved by a newer build" : "has a different layout" );
+		return false;
+	}
 
-	cpu.Serialize( serializer );
-	ppu.Serialize( serializer );
-	apu.Serialize( serializer );
-	cart->mapper->Serialize( serializer );
+	// Sections sit back to back in the power-on state, so each offset is the size of those before it
+	uint32_t defaultOffset = 0;
+	VisitSections( STATE_SECTION_ALL, [&]( const uint32_t bit, const char* label, auto visit )
+	{
+		const uint32_t currentVersion = wtStateFile::CurrentVersion( HashString32( label ) );
+
+		wtStateSizer sizer;
+		visit( sizer, currentVersion );
+		const uint32_t defaultSize = sizer.Size();
+
+		const uint8_t* data;
+		uint32_t size;
+		uint32_t version;
+		const bool present = file.FindSection( label, &data, &size, &version );
+
+		if ( ( bit & sectionMask ) != 0 )
+		{
+			if ( ( !present || ( version < currentVersion ) ) && powerOnState.IsValid() )
+			{
+				Serializer serializer( const_cast<uint8_t*>( powerOnState.GetPtr() ) + defaultOffset, defaultSize, serializeMode_t::LOAD );
+				wtStateReader reader( serializer );
+				visit( reader, currentVersion );
+			}
+
+			if ( present )
+			{
+				Serializer serializer( const_cast<uint8_t*>( data ), size, serializeMode_t::LOAD );
+				wtStateReader reader( serializer );
+				visit( reader, version );
+			}
+		}
+		defaultOffset += defaultSize;
+	} );
+	return true;
 }
 
 
-void Cpu6502::Serialize( Serializer& serializer )
+template<class V>
+void Cpu6502::Visit( V& visitor )
 {
-	SerializeCycle( serializer, cycle );
-
-	serializer.Next16b( nmiVector );
-	serializer.Next16b( irqVector );
-	serializer.Next16b( resetVector );
-	serializer.Next16b( irqAddr );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &interruptRequestNMI ) );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &interruptRequest ) );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &oamInProcess ) );
-	serializer.Next8b( X );
-	serializer.Next8b( Y );
-	serializer.Next8b( A );
-	serializer.Next8b( SP );
-	serializer.Next8b( P.byte );
-	serializer.Next16b( PC );
+	SerializeCycle( visitor, cycle );
+
+	visitor.Field( nmiVector );
+	visitor.Field( irqVector );
+	visitor.Field( resetVector );
+	visitor.Field( irqAddr );
+	visitor.Field( interruptRequestNMI );
+	visitor.Field( interruptRequest );
+	visitor.Field( oamInProcess );
+	visitor.Field( X );
+	visitor.Field( Y );
+	visitor.Field( A );
+	visitor.Field( SP );
+	visitor.Field( P.byte );
+	visitor.Field( PC );
 }
 
 
-void PPU::Serialize( Serializer& serializer )
+template<class V>
+void PPU::Visit( V& visitor )
 {
-	SerializeCycle( serializer, cycle );
-
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &genNMI ) );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &nmiOccurred ) );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &vramAccessed ) );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &vramWritePending ) );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &inVBlank ) );
-	serializer.Next16b( chrShifts[ 0 ] );
-	serializer.Next16b( chrShifts[ 1 ] );
-	serializer.Next8b( chrLatch[ 0 ] );
-	serializer.Next8b( chrLatch[ 1 ] );
-	serializer.Next16b( attrib );
-	serializer.Next8b( palLatch[ 0 ] );
-	serializer.Next8b( palLatch[ 1 ] );
-	serializer.Next8b( palShifts[ 0 ] );
-	serializer.Next8b( palShifts[ 1 ] );
-	serializer.Next8b( ppuReadBuffer );
-	serializer.Next32b( *reinterpret_cast<uint32_t*>( &currentScanline ) );
-	serializer.Next8b( beam.point.x );
-	serializer.Next8b( beam.point.y );
-	serializer.Next16b( regT.byte2x );
-	serializer.Next16b( regV.byte2x );
-	serializer.Next16b( regX );
-	serializer.Next16b( regW );
-	serializer.Next8b( curShift );
-	serializer.Next8b( secondaryOamSpriteCnt );
-	serializer.Next8b( regCtrl.byte );
-	serializer.Next8b( regMask.byte );
-	serializer.Next8b( regStatus.current.byte );
-	serializer.Next8b( regStatus.latched.byte );
-	serializer.Next8b( *reinterpret_cast<uint8_t*>( &regStatus.hasLatch ) );
+	SerializeCycle( visitor, cycle );
+
+	visitor.Field( genNMI );
+	visitor.Field( nmiOccurred );
+	visitor.Field( vramAccessed );
+	visitor.Field( vramWritePending );
+	visitor.Field( inVBlank );
+	visitor.Field( chrShifts[ 0 ] );
+	visitor.Field( chrShifts[ 1 ] );
+	visitor.Field( chrLatch[ 0 ] );
+	visitor.Field( chrLatch[ 1 ] );
+	visitor.Field( attrib );
+	visitor.Field( palLatch[ 0 ] );
+	visitor.Field( palLatch[ 1 ] );
+	visitor.Field( palShifts[ 0 ] );
+	visitor.Field( palShifts[ 1 ] );
+	visitor.Field( ppuReadBuffer );
+	visitor.Field( currentScanline );
+	visitor.Field( beam.point.x );
+	visitor.Field( beam.point.y );
+	visitor.Field( regT.byte2x );
+	visitor.Field( regV.byte2x );
+	visitor.Field( regX );
+	visitor.Field( regW );
+	visitor.Field( curShift );
+	visitor.Field( secondaryOamSpriteCnt );
+	visitor.Field( regCtrl.byte );
+	visitor.Field( regMask.byte );
+	visitor.Field( regStatus.current.byte );
+	visitor.Field( regStatus.latched.byte );
+	visitor.Field( regStatus.hasLatch );
 	
-	serializer.NextArray( reinterpret_cast<uint8_t*>( &primaryOAM ), OamSize );
-	serializer.NextArray( reinterpret_cast<uint8_t*>( &secondaryOAM ), OamSize * sizeof( spriteAttrib_t ) );
-	serializer.NewLabel( STATE_VRAM_LABEL );
-	serializer.NextArray( nt, KB(2) );
-	serializer.EndLabel( STATE_VRAM_LABEL );
-	serializer.NextArray( imgPal, PPU::PaletteColorNumber );
-	serializer.NextArray( sprPal, PPU::PaletteColorNumber );
-	serializer.NextArray( registers, 9 );
-	serializer.NextArray( reinterpret_cast<uint8_t*>( &plShifts ), 2 * sizeof( pipelineData_t ) );
-	serializer.NextArray( reinterpret_cast<uint8_t*>( &plLatches ), sizeof( pipelineData_t ) );
+	visitor.Array( &primaryOAM, OamSize );
+	visitor.Array( &secondaryOAM, OamSize * sizeof( spriteAttrib_t ) );
+	visitor.BeginLabel( STATE_VRAM_LABEL );
+	visitor.Array( nt, KB(2) );
+	visitor.EndLabel( STATE_VRAM_LABEL );
+	visitor.Array( imgPal, PPU::PaletteColorNumber );
+	visitor.Array( sprPal, PPU::PaletteColorNumber );
+	visitor.Array( registers, 9 );
+	visitor.Array( &plShifts, 2 * sizeof( pipelineData_t ) );
+	visitor.Array( &plLatches, sizeof( pipelineData_t ) );
 }
 
 
-void APU::Serialize( Serializer& serializer )
+template<class V>
+void APU::Visit( V& visitor )
 {
-/*
-	serializer.Next32b( currentBuffer,		mode);
-	if( mode == serializeMode_t::LOAD ) {
-		soundOutput = &soundOutputBuffers[ currentBuffer ];
-		frameOutput = soundOutput;
-	}
-
-	// TODO: soundOutputBuffers?
-	pulse1.Serialize( serializer, mode );
-	pulse2.Serialize( serializer, mode );
-	triangle.Serialize( serializer, mode );
-	noise.Serialize( serializer, mode );
-	dmc.Serialize( serializer, mode );
-
-	serializer.Next8b( frameCounter.byte,	mode );
-	serializer.Next8b( regStatus.byte,		mode );
-	serializer.NextBool( halfClk,			mode );
-	serializer.NextBool( quarterClk,		mode );
-	serializer.NextBool( irqClk,			mode );
-
-	serializer.Next32b( frameSeqTick,		mode );
-	serializer.Next8b( frameSeqStep,		mode );
-*/
+	// Mixer output buffers are transient and stay with the machine
+	pulse1.Visit( visitor );
+	pulse2.Visit( visitor );
+	triangle.Visit( visitor );
+	noise.Visit( visitor );
+	dmc.Visit( visitor );
+
+	visitor.Field( frameCounter.byte );
+	visitor.Field( regStatus.byte );
+	visitor.Field( frameSeqStep );
+	visitor.Field( frameSeq );
+
+	SerializeCycle( visitor, frameSeqTick );
+	SerializeCycle( visitor, cpuCycle );
+	SerializeCycle( visitor, apuCycle );
+	SerializeCycle( visitor, seqCycle );
 }
 
 
-void PulseChannel::Serialize( Serializer& serializer )
+template<class V>
+void PulseChannel::Visit( V& visitor )
 {
-	serializer.Next8b( regCtrl.byte );
-	serializer.Next16b( regTune.byte2x );
-	serializer.Next8b( regRamp.byte );
-	serializer.Next32b( volume );
-	serializer.Next8b( sequenceStep );
-	serializer.NextBool( mute );
-
-	SerializeEnvelope( serializer, envelope );
-	SerializeSweep( serializer, sweep );
-	SerializeBitCounter( serializer, period );
-	SerializeBitCounter( serializer, periodTimer );
-	SerializeCycle( serializer, lastCycle );
+	visitor.Field( regCtrl.byte );
+	visitor.Field( regTune.byte2x );
+	visitor.Field( regRamp.byte );
+	visitor.Field( volume );
+	visitor.Field( sequenceStep );
+	visitor.Field( lengthCounter );
+	visitor.Field( sample );
+	visitor.Field( mute );
+
+	SerializeEnvelope( visitor, envelope );
+	SerializeSweep( visitor, sweep );
+	SerializeBitCounter( visitor, period );
+	SerializeBitCounter( visitor, periodTimer );
+	SerializeCycle( visitor, lastCycle );
+	SerializeCycle( visitor, lastApuCycle );
 }
 
 
-void TriangleChannel::Serialize( Serializer& serializer )
+template<class V>
+void TriangleChannel::Visit( V& visitor )
 {
-	serializer.Next8b( regLinear.byte );
-	serializer.Next8b( sequenceStep );
-	serializer.Next16b( regTimer.byte2x );
-	serializer.NextBool( reloadFlag );
-	serializer.NextBool( mute );
-	serializer.Next8b( lengthCounter );
-
-	SerializeBitCounter( serializer, linearCounter );
-	SerializeBitCounter( serializer, timer );	
-	SerializeCycle( serializer, lastCycle );
+	visitor.Field( regLinear.byte );
+	visitor.Field( sequenceStep );
+	visitor.Field( regTimer.byte2x );
+	visitor.Field( reloadFlag );
+	visitor.Field( mute );
+	visitor.Field( lengthCounter );
+	visitor.Field( sample );
+
+	SerializeBitCounter( visitor, linearCounter );
+	SerializeBitCounter( visitor, timer );	
+	SerializeCycle( visitor, lastCycle );
 }
 
 
-void NoiseChannel::Serialize( Serializer& serializer )
+template<class V>
+void NoiseChannel::Visit( V& visitor )
 {
-	serializer.Next8b( regCtrl.byte );
-	serializer.Next8b( regFreq1.byte );
-	serializer.Next8b( regFreq2.byte );
-	serializer.NextBool( mute );
-	serializer.Next8b( lengthCounter );
+	visitor.Field( regCtrl.byte );
+	visitor.Field( regFreq1.byte );
+	visitor.Field( regFreq2.byte );
+	visitor.Field( mute );
+	visitor.Field( lengthCounter );
+	visitor.Field( sample );
 	
-	SerializeBitCounter( serializer, shift );
-	SerializeBitCounter( serializer, timer );
-	SerializeEnvelope( serializer, envelope );
-	SerializeCycle( serializer, lastCycle );
+	SerializeBitCounter( visitor, shift );
+	SerializeBitCounter( visitor, timer );
+	SerializeEnvelope( visitor, envelope );
+	SerializeCycle( visitor, lastCycle );
+	SerializeCycle( visitor, lastApuCycle );
 }
 
 
-void DmcChannel::Serialize( Serializer& serializer )
+template<class V>
+void DmcChannel::Visit( V& visitor )
 {
-	serializer.Next8b( regCtrl.byte );
-	serializer.Next8b( regLoad.byte );
-	serializer.Next16b( regAddr );
-	serializer.Next16b( regLength );
-	serializer.NextBool( irq );
-	serializer.NextBool( silenceFlag );
-	serializer.NextBool( mute );
-
-	serializer.Next16b( addr );
-	serializer.Next16b( bitCnt );
-	serializer.Next8b( sampleBuffer );
-	serializer.NextBool( emptyBuffer );
-	serializer.Next8b( shiftReg );
-
-	SerializeBitCounter( serializer, outputLevel );
-	SerializeCycle( serializer, lastCycle );
+	visitor.Field( regCtrl.byte );
+	visitor.Field( regLoad.byte );
+	visitor.Field( regAddr );
+	visitor.Field( regLength );
+	visitor.Field( irq );
+	visitor.Field( silenceFlag );
+	visitor.Field( mute );
+
+	visitor.Field( addr );
+	visitor.Field( bitCnt );
+	visitor.Field( bytesRemaining );
+	visitor.Field( period );
+	visitor.Field( periodCounter );
+	visitor.Field( sampleBuffer );
+	visitor.Field( emptyBuffer );
+	visitor.Field( startRead );
+	visitor.Field( shiftReg );
+	visitor.Field( sample );
+
+	SerializeBitCounter( visitor, outputLevel );
+	SerializeCycle( visitor, lastCycle );
+	SerializeCycle( visitor, lastApuCycle );
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "../include/tomtendo/timeline.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace Tomtendo
+{
+	struct timelineEvent_t
+	{
+		const char*	name;
+		uint64_t	beginNs;
+		uint64_t	endNs;
+	};
+
+
+	// Written only by its owning thread; 'head' publishes finished events to Export()
+	struct timelineThread_t
+	{
+		std::unique_ptr<timelineEvent_t[]>	events;
+		std::atomic<uint64_t>				head;
+		std::atomic<uint64_t>				start;	// Clear() hides everything below this instead of rewinding 'head'
+		uint32_t							tid;
+		std::string							name;
+	};
+
+
+	static std::atomic<bool>								timelineEnabled( false );
+	static std::mutex										timelineLock;
+	static std::vector<std::unique_ptr<timelineThread_t>>	timelineThreads; // Never shrinks, threads keep raw pointers
+	static thread_local timelineThread_t*					localThread = nullptr;
+	static const std::chrono::steady_clock::time_point		timelineEpoch = std::chrono::steady_clock::now();
+
+
+	static timelineThread_t* GetLocalThread()
+	{
+		if ( localThread == nullptr )
+		{
+			std::unique_ptr<timelineThread_t> thread( new timelineThread_t() );
+			thread->events.reset( new timelineEvent_t[ wtTimeline::EventsPerThread ] );
+			thread->head = 0;
+			thread->start = 0;
+
+			std::lock_guard<std::mutex> lock( timelineLock );
+			thread->tid = static_cast<uint32_t>( timelineThreads.size() + 1 );
+			thread->name = "Thread " + std::to_string( thread->tid );
+			localThread = thread.get();
+			timelineThreads.push_back( std::move( thread ) );
+		}
+		return localThread;
+	}
+
+
+	void wtTimeline::Enable( const bool enable )
+	{
+		timelineEnabled.store( enable, std::memory_order_relaxed );
+	}
+
+
+	bool wtTimeline::IsEnabled()
+	{
+		return timelineEnabled.load( std::memory_order_relaxed );
+	}
+
+
+	void wtTimeline::SetThreadName( const char* name )
+	{
+		timelineThread_t* thread = GetLocalThread();
+
+		std::lock_guard<std::mutex> lock( timelineLock );
+		thread->name = name;
+	}
+
+
+	uint64_t wtTimeline::NowNs()
+	{
+		// Offset by one so a valid timestamp is never zero
+		return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - timelineEpoch ).count() ) + 1;
+	}
+
+
+	void wtTimeline::Record( const char* name, const uint64_t beginNs, const uint64_t endNs )
+	{
+		timelineThread_t* thread = GetLocalThread();
+
+		const uint64_t head = thread->head.load( std::memory_order_relaxed );
+		timelineEvent_t& event = thread->events[ head % EventsPerThread ];
+		event.name		= name;
+		event.beginNs	= beginNs;
+		event.endNs		= endNs;
+		thread->head.store( head + 1, std::memory_order_release );
+	}
+
+
+	void wtTimeline::Clear()
+	{
+		std::lock_guard<std::mutex> lock( timelineLock );
+		for ( auto& thread : timelineThreads ) {
+			thread->start.store( thread->head.load( std::memory_order_acquire ), std::memory_order_relaxed );
+		}
+	}
+
+
+	bool wtTimeline::Export( const std::string& path )
+	{
+		FILE* file = fopen( path.c_str(), "wb" );
+		if ( file == nullptr ) {
+			return false;
+		}
+
+		// Pause so the rings aren't overwritten while they're copied; scopes already open still land
+		const bool wasEnabled = timelineEnabled.exchange( false );
+
+		std::vector<timelineEvent_t> events;
+		bool first = true;
+
+		fprintf( file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+
+		std::lock_guard<std::mutex> lock( timelineLock );
+		for ( auto& thread : timelineThreads )
+		{
+			const uint64_t head = thread->head.load( std::memory_order_acquire );
+			const uint64_t oldest = std::max<uint64_t>( thread->start.load( std::memory_order_relaxed ), ( head > EventsPerThread ) ? ( head - EventsPerThread ) : 0 );
+
+			events.clear();
+			for ( uint64_t i = oldest; i < head; ++i ) {
+				events.push_back( thread->events[ i % EventsPerThread ] );
+			}
+
+			// The owner may have lapped the oldest slots while they were copied; its next write lands on 'newHead'
+			const uint64_t newHead = thread->head.load( std::memory_order_acquire );
+			if ( ( newHead + 1 ) > ( oldest + EventsPerThread ) )
+			{
+				const uint64_t torn = std::min<uint64_t>( newHead + 1 - EventsPerThread - oldest, events.size() );
+				events.erase( events.begin(), events.begin() + static_cast<size_t>( torn ) );
+			}
+
+			fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", thread->tid, thread->name.c_str() );
+			first = false;
+
+			for ( const timelineEvent_t& event : events )
+			{
+				const uint64_t durationNs = ( event.endNs > event.beginNs ) ? ( event.endNs - event.beginNs ) : 0;
+				fprintf( file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u,\"dur\":%llu.%03u}",
+					event.name, thread->tid,
+					static_cast<unsigned long long>( event.beginNs / 1000 ), static_cast<uint32_t>( event.beginNs % 1000 ),
+					static_cast<unsigned long long>( durationNs / 1000 ), static_cast<uint32_t>( durationNs % 1000 ) );
+			}
+		}
+
+		fprintf( file, "\n]}\n" );
+		const bool ok = ( ferror( file ) == 0 );
+		fclose( file );
+
+		timelineEnabled.store( wasEnabled );
+		return ok;
+	}
+};
@@ -0,0 +1,357 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "../include/tomtendo/vecEnv.h"
+#include "system/NesSystem.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Tomtendo
+{
+	vecEnvConfig_t DefaultVecEnvConfig()
+	{
+		vecEnvConfig_t vecConfig;
+		vecConfig.envCount		= 8;
+		vecConfig.frameSkip		= 4;
+		vecConfig.maxPool		= true;
+		vecConfig.grayscale		= true;
+		vecConfig.downsample	= 2;
+		vecConfig.ramBytes		= wtSystem::PhysicalMemorySize;
+		vecConfig.noopMax		= 30;
+		vecConfig.threads		= 0;
+		return vecConfig;
+	}
+
+
+	wtVecEnv::wtVecEnv()
+	{
+		config = DefaultVecEnvConfig();
+		sysConfig = DefaultConfig();
+		root = nullptr;
+		renderFrames = 1;
+		obsWidth = 0;
+		obsHeight = 0;
+		obsChannels = 0;
+		ramSize = 0;
+		job = job_t::STEP;
+		jobSeeds = nullptr;
+		jobMask = nullptr;
+		jobActions = nullptr;
+		jobObservations = nullptr;
+		jobRam = nullptr;
+		generation = 0;
+		pending = 0;
+		running = false;
+		nextEnv = 0;
+	}
+
+
+	wtVecEnv::~wtVecEnv()
+	{
+		Shutdown();
+	}
+
+
+	int wtVecEnv::Init( const uint8_t* romData, const uint32_t romSize, const vecEnvConfig_t& vecConfig )
+	{
+		Shutdown();
+
+		const uint32_t ds = vecConfig.downsample;
+		if ( ( vecConfig.envCount == 0 ) || ( vecConfig.frameSkip == 0 ) || ( ( ds != 1 ) && ( ds != 2 ) && ( ds != 4 ) ) ) {
+			return -1;
+		}
+
+		config = vecConfig;
+		obsWidth = FrameWidth / ds;
+		obsHeight = FrameHeight / ds;
+		obsChannels = config.grayscale ? 1 : 3;
+		ramSize = std::min( config.ramBytes, wtSystem::PhysicalMemorySize );
+		renderFrames = config.maxPool ? 2 : 1;
+
+		sysConfig = DefaultConfig();
+		sysConfig.sys.flags = emulationFlags_t::HEADLESS | emulationFlags_t::NO_AUDIO;
+		sysConfig.sys.seekIndexMB = 0;
+
+		root = new wtSystem();
+		const int ret = root->Init( romData, romSize );
+		if ( ret != 0 )
+		{
+			Shutdown();
+			return ret;
+		}
+		root->SetConfig( sysConfig );
+
+		// Sized once, the machines keep pointers to their Input
+		inputs.resize( config.envCount );
+		systems.resize( config.envCount, nullptr );
+		for ( uint32_t envIx = 0; envIx < config.envCount; ++envIx )
+		{
+			systems[ envIx ] = new wtSystem();
+			if ( systems[ envIx ]->Clone( *root ) != 0 )
+			{
+				Shutdown();
+				return -1;
+			}
+			systems[ envIx ]->AttachInputHandler( &inputs[ envIx ] );
+		}
+
+		uint32_t threadCount = ( config.threads != 0 ) ? config.threads : std::thread::hardware_concurrency();
+		threadCount = std::max( 1u, std::min( threadCount, config.envCount ) );
+
+		running = true;
+		for ( uint32_t i = 1; i < threadCount; ++i ) {
+			workers.emplace_back( &wtVecEnv::WorkerThread, this );
+		}
+		return 0;
+	}
+
+
+	void wtVecEnv::Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> guard( lock );
+			running = false;
+		}
+		wake.notify_all();
+
+		for ( std::thread& worker : workers ) {
+			worker.join();
+		}
+		workers.clear();
+
+		for ( wtSystem* system : systems ) {
+			delete system;
+		}
+		systems.clear();
+		inputs.clear();
+
+		delete root;
+		root = nullptr;
+	}
+
+
+	uint32_t wtVecEnv::GetEnvCount() const
+	{
+		return static_cast<uint32_t>( systems.size() );
+	}
+
+
+	uint32_t wtVecEnv::GetObservationWidth() const
+	{
+		return obsWidth;
+	}
+
+
+	uint32_t wtVecEnv::GetObservationHeight() const
+	{
+		return obsHeight;
+	}
+
+
+	uint32_t wtVecEnv::GetObservationChannels() const
+	{
+		return obsChannels;
+	}
+
+
+	uint32_t wtVecEnv::GetObservationSize() const
+	{
+		return ( obsWidth * obsHeight * obsChannels );
+	}
+
+
+	uint32_t wtVecEnv::GetRamSize() const
+	{
+		return ramSize;
+	}
+
+
+	void wtVecEnv::Reset( const uint32_t* seeds, const uint8_t* mask, uint8_t* observations, uint8_t* ram )
+	{
+		assert( seeds != nullptr );
+		assert( observations != nullptr );
+
+		jobSeeds = seeds;
+		jobMask = mask;
+		jobActions = nullptr;
+		jobObservations = observations;
+		jobRam = ram;
+		Dispatch( job_t::RESET );
+	}
+
+
+	void wtVecEnv::Step( const ButtonFlags* actions, uint8_t* observations, uint8_t* ram )
+	{
+		assert( actions != nullptr );
+		assert( observations != nullptr );
+
+		jobSeeds = nullptr;
+		jobMask = nullptr;
+		jobActions = actions;
+		jobObservations = observations;
+		jobRam = ram;
+		Dispatch( job_t::STEP );
+	}
+
+
+	// The caller works through the envs alongside the pool and returns once every one is done
+	void wtVecEnv::Dispatch( const job_t nextJob )
+	{
+		if ( systems.empty() ) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard( lock );
+			job = nextJob;
+			nextEnv = 0;
+			pending = static_cast<uint32_t>( workers.size() );
+			++generation;
+		}
+		wake.notify_all();
+
+		RunShare();
+
+		std::unique_lock<std::mutex> guard( lock );
+		done.wait( guard, [ this ] { return ( pending == 0 ); } );
+	}
+
+
+	void wtVecEnv::WorkerThread()
+	{
+		uint64_t lastGeneration = 0;
+
+		std::unique_lock<std::mutex> guard( lock );
+		while ( true )
+		{
+			wake.wait( guard, [ & ] { return !running || ( generation != lastGeneration ); } );
+			if ( !running ) {
+				return;
+			}
+			lastGeneration = generation;
+
+			guard.unlock();
+			RunShare();
+			guard.lock();
+
+			if ( --pending == 0 ) {
+				done.notify_one();
+			}
+		}
+	}
+
+
+	void wtVecEnv::RunShare()
+	{
+		const uint32_t envCount = static_cast<uint32_t>( systems.size() );
+		for ( uint32_t envIx = nextEnv++; envIx < envCount; envIx = nextEnv++ ) {
+			RunEnv( envIx );
+		}
+	}
+
+
+	void wtVecEnv::RunEnv( const uint32_t envIx )
+	{
+		wtSystem& system = *systems[ envIx ];
+
+		ButtonFlags action = ButtonFlags::BUTTON_NONE;
+		uint32_t frames = config.frameSkip;
+		if ( job == job_t::RESET )
+		{
+			if ( ( jobMask != nullptr ) && ( jobMask[ envIx ] == 0 ) ) {
+				return;
+			}
+			system.CopyState( *root );
+
+			// The pooled frames must be rendered after the reset, not left over from the last episode
+			frames = ( jobSeeds[ envIx ] % ( config.noopMax + 1 ) ) + std::max( config.frameSkip, renderFrames );
+		}
+		else
+		{
+			action = jobActions[ envIx ];
+		}
+
+		inputs[ envIx ].SetKeyBuffer( ControllerId::CONTROLLER_0, action );
+		for ( uint32_t frame = 0; frame < frames; ++frame )
+		{
+			if ( !system.StepFrame( ( frames - frame ) <= renderFrames ) ) {
+				break;
+			}
+		}
+
+		WriteObservation( system, jobObservations + envIx * GetObservationSize() );
+		if ( ( jobRam != nullptr ) && ( ramSize > 0 ) ) {
+			memcpy( jobRam + envIx * ramSize, system.GetWorkRam(), ramSize );
+		}
+	}
+
+
+	void wtVecEnv::WriteObservation( const wtSystem& system, uint8_t* out ) const
+	{
+		const uint32_t* current = system.GetFinishedFrame( 0 ).GetRawBuffer();
+		const uint32_t* previous = config.maxPool ? system.GetFinishedFrame( 1 ).GetRawBuffer() : current;
+
+		const uint32_t ds = config.downsample;
+		const uint32_t shift = ( ds == 4 ) ? 4 : ( ( ds == 2 ) ? 2 : 0 ); // log2 of the box area
+
+		for ( uint32_t y = 0; y < obsHeight; ++y )
+		{
+			for ( uint32_t x = 0; x < obsWidth; ++x )
+			{
+				uint32_t r = 0;
+				uint32_t g = 0;
+				uint32_t b = 0;
+				for ( uint32_t boxY = 0; boxY < ds; ++boxY )
+				{
+					const uint32_t rowIx = ( y * ds + boxY ) * FrameWidth + x * ds;
+					for ( uint32_t boxX = 0; boxX < ds; ++boxX )
+					{
+						// ABGR, max pooled per channel
+						const uint32_t c = current[ rowIx + boxX ];
+						const uint32_t p = previous[ rowIx + boxX ];
+						r += std::max( c & 0xFF, p & 0xFF );
+						g += std::max( ( c >> 8 ) & 0xFF, ( p >> 8 ) & 0xFF );
+						b += std::max( ( c >> 16 ) & 0xFF, ( p >> 16 ) & 0xFF );
+					}
+				}
+				r >>= shift;
+				g >>= shift;
+				b >>= shift;
+
+				if ( config.grayscale )
+				{
+					*out++ = static_cast<uint8_t>( ( 77 * r + 150 * g + 29 * b ) >> 8 );
+				}
+				else
+				{
+					*out++ = static_cast<uint8_t>( r );
+					*out++ = static_cast<uint8_t>( g );
+					*out++ = static_cast<uint8_t>( b );
+				}
+			}
+		}
+	}
+};
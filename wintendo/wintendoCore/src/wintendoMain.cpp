@@ -22,28 +22,57 @@
 */
 
 #include "../stdafx.h"
-#include <iostream>
-#include <iomanip>
-#include <fstream>
-#include <Windows.h>
+#include <cstdio>
+#include <cstdlib>
 #include <string>
-#include <wchar.h>
-#include <sstream>
 
 #include "system/NesSystem.h"
 #include "../include/tomtendo/interface.h"
+#include "../include/tomtendo/capture.h"
 
-wtSystem nesSystem;
+static wtSystem	nesSystem;
+static Input	input; // No buttons held
 
-int main()
+// Usage: rom.nes [frameCount] [video.y4m|-] [audio.wav|-]
+int main( int argc, char* argv[] )
 {
-	nesSystem.Init( L"Games/Contra.nes" );
+	if ( argc < 2 )
+	{
+		fprintf( stderr, "Usage: %s rom.nes [frameCount] [video.y4m|-] [audio.wav|-]\n", argv[ 0 ] );
+		return 1;
+	}
+
+	const std::string romPath = argv[ 1 ];
+	if ( nesSystem.Init( std::wstring( romPath.begin(), romPath.end() ) ) != 0 )
+	{
+		fprintf( stderr, "Failed to load %s\n", romPath.c_str() );
+		return 1;
+	}
+	nesSystem.AttachInputHandler( &input );
 
 	Tomtendo::config_t cfg = Tomtendo::DefaultConfig();
 	cfg.sys.flags = emulationFlags_t::HEADLESS;
 	nesSystem.SetConfig( cfg );
 
-	nesSystem.RunEpoch( FrameLatencyNs );
+	const uint32_t frameCount = ( argc > 2 ) ? static_cast<uint32_t>( atoi( argv[ 2 ] ) ) : 1;
+
+	Tomtendo::captureConfig_t captureCfg = Tomtendo::DefaultCaptureConfig();
+	captureCfg.videoPath = ( argc > 3 ) ? argv[ 3 ] : "";
+	captureCfg.audioPath = ( argc > 4 ) ? argv[ 4 ] : "";
+
+	Tomtendo::wtCapture capture;
+	capture.Open( captureCfg );
+
+	for ( uint32_t i = 0; i < frameCount; ++i )
+	{
+		nesSystem.RunEpoch( FrameLatencyNs );
+
+		Tomtendo::wtFrameResult frameResult = {};
+		nesSystem.GetFrameResult( frameResult );
+		capture.Submit( frameResult );
+	}
 
+	capture.Close();
 	nesSystem.Shutdown();
+	return 0;
 }
\ No newline at end of file
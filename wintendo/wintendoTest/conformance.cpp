@@ -0,0 +1,498 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+#include "../wintendoCore/src/system/NesSystem.h"
+#include "../wintendoCore/include/tomtendo/interface.h"
+#include "testUtil.h"
+#include "forkTest.h"
+#include "lockstep.h"
+#include "movieTest.h"
+#include "stateTest.h"
+#include "vecEnvTest.h"
+
+// Usage: wintendoTest [-romdir dir] [-frames N] [-jobs N] [rom.nes ...]
+//        wintendoTest -lockstep ..., see lockstep.cpp
+//        wintendoTest -movie ..., see movieTest.cpp
+//        wintendoTest -fork ..., see forkTest.cpp
+//        wintendoTest -vecenv ..., see vecEnvTest.cpp
+//        wintendoTest -state ..., see stateTest.cpp
+// Runs every ROM in romdir and romdir/instr_test-v5/rom_singles unless ROMs are listed.
+// nestest is compared line by line against nestTestLog.txt, everything else reports
+// through the blargg $6000 protocol: $80 running, $81 reset requested, otherwise the result code.
+// Built-in cases are assembled in memory and only run when named, e.g. sram_window.
+
+static const char*		GoldenRom			= "nestest.nes";
+static const char*		GoldenLog			= "nestTestLog.txt";
+static const uint16_t	GoldenResetVector	= 0xC000;
+static const uint32_t	GoldenMaxFrames		= 60;
+
+static const uint16_t	BlarggStatusAddr	= 0x6000;
+static const uint16_t	BlarggTextAddr		= 0x6004;
+static const uint8_t	BlarggRunning		= 0x80;
+static const uint8_t	BlarggNeedsReset	= 0x81;
+static const uint8_t	BlarggSignature[ 3 ]	= { 0xDE, 0xB0, 0x61 };
+static const uint32_t	BlarggMaxText		= 256;
+static const uint32_t	BlarggSignatureFrames	= 300; // The shell writes the signature during init, give up on visual-only ROMs after this
+
+// NROM with CHR RAM. Indirect indexed stores, the one mode that hands the index to WriteMemory
+// separately, land on $5FFF where nothing answers and on $7FFF, the last byte of PRG RAM.
+// Reports through the blargg protocol, $01 if either store went astray.
+static const char*		SramWindowRom		= "sram_window";
+static const uint8_t	SramWindowProgram[] =
+{
+	0xA9, 0x80,			// $8000	LDA #$80
+	0x8D, 0x00, 0x60,	// $8002	STA $6000		Running
+	0xA0, 0x10,			// $8005	LDY #$10
+	0xA9, 0xEF,			// $8007	LDA #$EF
+	0x85, 0x00,			// $8009	STA $00
+	0xA9, 0x5F,			// $800B	LDA #$5F
+	0x85, 0x01,			// $800D	STA $01
+	0xA9, 0xA5,			// $800F	LDA #$A5
+	0x91, 0x00,			// $8011	STA ($00),Y		$5FFF
+	0xA9, 0x7F,			// $8013	LDA #$7F
+	0x85, 0x01,			// $8015	STA $01
+	0xA9, 0xA5,			// $8017	LDA #$A5
+	0x91, 0x00,			// $8019	STA ($00),Y		$7FFF
+	0xA9, 0xDE,			// $801B	LDA #$DE
+	0x8D, 0x01, 0x60,	// $801D	STA $6001
+	0xA9, 0xB0,			// $8020	LDA #$B0
+	0x8D, 0x02, 0x60,	// $8022	STA $6002
+	0xA9, 0x61,			// $8025	LDA #$61
+	0x8D, 0x03, 0x60,	// $8027	STA $6003		Signature
+	0xA2, 0x01,			// $802A	LDX #$01
+	0xAD, 0xFF, 0x7F,	// $802C	LDA $7FFF
+	0xC9, 0xA5,			// $802F	CMP #$A5
+	0xD0, 0x14,			// $8031	BNE $8047
+	0xA9, 0x1F,			// $8033	LDA #$1F
+	0x8D, 0x06, 0x20,	// $8035	STA $2006
+	0xA9, 0xFF,			// $8038	LDA #$FF
+	0x8D, 0x06, 0x20,	// $803A	STA $2006
+	0xAD, 0x07, 0x20,	// $803D	LDA $2007		Fills the read buffer
+	0xAD, 0x07, 0x20,	// $8040	LDA $2007		CHR RAM $1FFF, sits just below PRG RAM in the mapper
+	0xD0, 0x02,			// $8043	BNE $8047
+	0xA2, 0x00,			// $8045	LDX #$00
+	0xA9, 0xF0,			// $8047	LDA #$F0
+	0x85, 0x00,			// $8049	STA $00
+	0xA9, 0x5F,			// $804B	LDA #$5F
+	0x85, 0x01,			// $804D	STA $01
+	0x8A,				// $804F	TXA
+	0x91, 0x00,			// $8050	STA ($00),Y		Result at $6000
+	0x4C, 0x52, 0x80,	// $8052	JMP $8052
+};
+
+enum class testStatus_t : uint8_t
+{
+	PASS,
+	FAIL,
+	TIMEOUT,
+	NO_RESULT,	// Never reported through a protocol we understand, e.g. visual-only tests
+	LOAD_ERROR,
+};
+
+
+struct testConfig_t : testOptions_t
+{
+	std::vector<std::string>	golden;
+};
+
+
+struct testResult_t
+{
+	std::string		rom;
+	testStatus_t	status;
+	uint32_t		frames;
+	double			ms;
+	std::string		message;
+};
+
+
+static Input testInput; // No buttons held
+
+
+static const char* StatusName( const testStatus_t status )
+{
+	switch ( status )
+	{
+	case testStatus_t::PASS:		return "PASS";
+	case testStatus_t::FAIL:		return "FAIL";
+	case testStatus_t::TIMEOUT:		return "TIMEOUT";
+	case testStatus_t::NO_RESULT:	return "SKIP";
+	case testStatus_t::LOAD_ERROR:	return "ERROR";
+	default:						return "?";
+	}
+}
+
+
+static std::string TrimRight( const std::string& str )
+{
+	size_t end = str.size();
+	while ( ( end > 0 ) && ( ( str[ end - 1 ] == ' ' ) || ( str[ end - 1 ] == '\r' ) || ( str[ end - 1 ] == '\n' ) ) ) {
+		--end;
+	}
+	return str.substr( 0, end );
+}
+
+
+static void SplitLines( const std::string& text, std::vector<std::string>& outLines )
+{
+	size_t begin = 0;
+	while ( begin < text.size() )
+	{
+		size_t end = text.find( '\n', begin );
+		if ( end == std::string::npos ) {
+			end = text.size();
+		}
+		outLines.push_back( TrimRight( text.substr( begin, end - begin ) ) );
+		begin = end + 1;
+	}
+}
+
+
+// Compares PC, opcode bytes, mnemonic and registers. The operand column is skipped
+// since nestest.log also annotates the memory value, e.g. "STX $00 = 00"
+static bool MatchesGolden( const std::string& line, const std::string& expected )
+{
+	const size_t OpColumns = 19;
+	const size_t RegColumns = 25; // "A:00 X:00 Y:00 P:24 SP:FD"
+
+	if ( line.compare( 0, OpColumns, expected, 0, OpColumns ) != 0 ) {
+		return false;
+	}
+
+	const size_t lineRegs = line.find( "A:", OpColumns );
+	const size_t expectedRegs = expected.find( "A:", OpColumns );
+	if ( ( lineRegs == std::string::npos ) || ( expectedRegs == std::string::npos ) ) {
+		return false;
+	}
+	return ( line.compare( lineRegs, RegColumns, expected, expectedRegs, RegColumns ) == 0 );
+}
+
+
+class wtConformanceRun
+{
+public:
+	wtConformanceRun( const testConfig_t& config, const std::string& romName, testResult_t& outResult )
+		: cfg( config ), result( outResult )
+	{
+		result.rom = romName;
+		result.status = testStatus_t::LOAD_ERROR;
+		result.frames = 0;
+		result.ms = 0.0;
+
+		sysCfg = DefaultConfig();
+		sysCfg.sys.flags = emulationFlags_t::HEADLESS;
+	}
+
+	void Run()
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		// Boot from memory so save files next to the ROM are neither loaded nor written
+		if ( result.rom == SramWindowRom ) {
+			BuildSramWindowRom( romData );
+			RunBlargg();
+		} else if ( !ReadFile( cfg.romDir + "/" + result.rom, romData ) ) {
+			result.message = "unreadable";
+		} else if ( result.rom == GoldenRom ) {
+			RunGolden();
+		} else {
+			RunBlargg();
+		}
+
+		result.ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+	}
+
+private:
+	static void BuildSramWindowRom( std::vector<uint8_t>& outRom )
+	{
+		const uint8_t header[ 16 ] = { 'N', 'E', 'S', 0x1A, 1, 0 };
+		const uint16_t vectors[ 3 ] = { 0x8052, 0x8000, 0x8052 }; // NMI, reset, IRQ
+
+		outRom.assign( sizeof( header ) + KB( 16 ), 0 );
+		memcpy( outRom.data(), header, sizeof( header ) );
+		memcpy( outRom.data() + sizeof( header ), SramWindowProgram, sizeof( SramWindowProgram ) );
+		for ( uint32_t i = 0; i < 3; ++i )
+		{
+			outRom[ sizeof( header ) + KB( 16 ) - 6 + 2 * i ] = static_cast<uint8_t>( vectors[ i ] & 0xFF );
+			outRom[ sizeof( header ) + KB( 16 ) - 5 + 2 * i ] = static_cast<uint8_t>( vectors[ i ] >> 8 );
+		}
+	}
+
+	bool Boot( const uint32_t resetVector )
+	{
+		system.reset( new wtSystem() );
+		if ( system->Init( romData.data(), static_cast<uint32_t>( romData.size() ), resetVector ) != 0 )
+		{
+			result.message = "bad header";
+			return false;
+		}
+		system->AttachInputHandler( &testInput );
+		system->SetConfig( sysCfg );
+		return true;
+	}
+
+	void StepFrame( wtFrameResult& frameResult )
+	{
+		system->RunEpoch( FrameLatencyNs );
+		system->GetFrameResult( frameResult );
+		++result.frames;
+	}
+
+	void RunGolden()
+	{
+		if ( cfg.golden.empty() )
+		{
+			result.message = std::string( "missing " ) + GoldenLog;
+			return;
+		}
+
+		if ( !Boot( GoldenResetVector ) ) {
+			return;
+		}
+
+		const uint32_t maxFrames = std::min( cfg.frames, GoldenMaxFrames );
+
+		sysCmd_t traceCmd;
+		traceCmd.type = sysCmdType_t::START_TRACE;
+		traceCmd.parms[ 0 ].u = maxFrames;
+		system->SubmitCommand( traceCmd );
+
+		// Compare each frame's trace as it arrives and stop at the first divergence
+		uint64_t consumedLines = 0;
+		size_t goldenIx = 0;
+		std::string text;
+		std::vector<std::string> lines;
+		wtFrameResult frameResult = {};
+
+		while ( result.frames < maxFrames )
+		{
+			StepFrame( frameResult );
+
+			const wtLog& traceLog = system->GetTraceLog();
+			const uint64_t lineCount = traceLog.GetLineCount();
+			text.clear();
+			lines.clear();
+			traceLog.LinesToString( text, consumedLines, lineCount );
+			consumedLines = lineCount;
+			SplitLines( text, lines );
+
+			for ( const std::string& line : lines )
+			{
+				const std::string& expected = cfg.golden[ goldenIx ];
+				if ( !MatchesGolden( line, expected ) )
+				{
+					result.status = testStatus_t::FAIL;
+					result.message = "line " + std::to_string( goldenIx + 1 ) + ": expected \"" + expected + "\" got \"" + line + "\"";
+					return;
+				}
+
+				if ( ++goldenIx == cfg.golden.size() )
+				{
+					result.status = testStatus_t::PASS;
+					result.message = std::to_string( goldenIx ) + " lines match";
+					return;
+				}
+			}
+		}
+
+		result.status = testStatus_t::TIMEOUT;
+		result.message = "matched " + std::to_string( goldenIx ) + " of " + std::to_string( cfg.golden.size() ) + " lines";
+	}
+
+	bool HasBlarggSignature()
+	{
+		for ( uint32_t i = 0; i < 3; ++i )
+		{
+			if ( system->ReadMemory( BlarggStatusAddr + 1 + i ) != BlarggSignature[ i ] ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string ReadBlarggText()
+	{
+		std::string text;
+		for ( uint32_t i = 0; i < BlarggMaxText; ++i )
+		{
+			const char c = static_cast<char>( system->ReadMemory( BlarggTextAddr + i ) );
+			if ( c == '\0' ) {
+				break;
+			}
+			text += ( c == '\n' ) ? ' ' : c;
+		}
+		return TrimRight( text );
+	}
+
+	void RunBlargg()
+	{
+		if ( !Boot( wtSystem::InvalidAddr ) ) {
+			return;
+		}
+
+		bool reported = false;
+		wtFrameResult frameResult = {};
+
+		while ( result.frames < cfg.frames )
+		{
+			StepFrame( frameResult );
+
+			if ( !HasBlarggSignature() )
+			{
+				if ( !reported && ( result.frames >= BlarggSignatureFrames ) ) {
+					break;
+				}
+				continue;
+			}
+			reported = true;
+
+			const uint8_t status = system->ReadMemory( BlarggStatusAddr );
+			if ( status == BlarggRunning ) {
+				continue;
+			}
+
+			if ( status == BlarggNeedsReset )
+			{
+				// No soft reset in the core yet
+				result.status = testStatus_t::FAIL;
+				result.message = "reset requested";
+				return;
+			}
+
+			result.status = ( status == 0 ) ? testStatus_t::PASS : testStatus_t::FAIL;
+			char code[ 4 ];
+			snprintf( code, sizeof( code ), "$%02X", status );
+			result.message = std::string( code ) + " " + ReadBlarggText();
+			return;
+		}
+
+		result.status = reported ? testStatus_t::TIMEOUT : testStatus_t::NO_RESULT;
+		result.message = reported ? ReadBlarggText() : "no $6000 status";
+	}
+
+	const testConfig_t&			cfg;
+	testResult_t&				result;
+	config_t					sysCfg;
+	std::vector<uint8_t>		romData;
+	std::unique_ptr<wtSystem>	system;
+};
+
+
+static bool ParseArgs( const int argc, char* argv[], testConfig_t& cfg )
+{
+	cfg.frames = 60 * 60;
+	if ( !ParseTestArgs( argc, argv, TEST_OPTION_FRAMES | TEST_OPTION_JOBS, cfg ) ) {
+		return false;
+	}
+
+	std::vector<uint8_t> goldenData;
+	if ( ReadFile( cfg.romDir + "/" + GoldenLog, goldenData ) ) {
+		SplitLines( std::string( goldenData.begin(), goldenData.end() ), cfg.golden );
+	}
+
+	return true;
+}
+
+
+int main( int argc, char* argv[] )
+{
+	if ( ( argc > 1 ) && ( strcmp( argv[ 1 ], "-lockstep" ) == 0 ) ) {
+		return LockstepMain( argc - 1, argv + 1 );
+	}
+	if ( ( argc > 1 ) && ( strcmp( argv[ 1 ], "-movie" ) == 0 ) ) {
+		return MovieMain( argc - 1, argv + 1 );
+	}
+	if ( ( argc > 1 ) && ( strcmp( argv[ 1 ], "-fork" ) == 0 ) ) {
+		return ForkMain( argc - 1, argv + 1 );
+	}
+	if ( ( argc > 1 ) && ( strcmp( argv[ 1 ], "-vecenv" ) == 0 ) ) {
+		return VecEnvMain( argc - 1, argv + 1 );
+	}
+	if ( ( argc > 1 ) && ( strcmp( argv[ 1 ], "-state" ) == 0 ) ) {
+		return StateMain( argc - 1, argv + 1 );
+	}
+
+	testConfig_t cfg;
+	if ( !ParseArgs( argc, argv, cfg ) )
+	{
+		fprintf( stderr, "Usage: wintendoTest [-romdir dir] [-frames N] [-jobs N] [rom.nes ...]\n" );
+		fprintf( stderr, "       wintendoTest -lockstep [-romdir dir] [-frames N] [-jobs N] [-seed N] [rom.nes ...]\n" );
+		fprintf( stderr, "       wintendoTest -movie [-romdir dir] [-workdir dir] [-frames N] [-keyframes N] [-jobs N] [-seed N] [rom.nes ...]\n" );
+		fprintf( stderr, "       wintendoTest -fork [-romdir dir] [-frames N] [-copies N] [-jobs N] [-seed N] [rom.nes ...]\n" );
+		fprintf( stderr, "       wintendoTest -vecenv [-romdir dir] [-steps N] [-envs N] [-threads N] [-seed N] [rom.nes ...]\n" );
+		fprintf( stderr, "       wintendoTest -state [-romdir dir] [-frames N] [-jobs N] [-seed N] [rom.nes ...]\n" );
+		return 1;
+	}
+
+	if ( cfg.roms.empty() )
+	{
+		fprintf( stderr, "No ROMs found in %s\n", cfg.romDir.c_str() );
+		return 1;
+	}
+
+	std::vector<testResult_t> results( cfg.roms.size() );
+
+	const auto start = std::chrono::steady_clock::now();
+
+	RunJobs( static_cast<uint32_t>( cfg.roms.size() ), cfg.jobs, [ & ]( const uint32_t romIx )
+	{
+		wtConformanceRun run( cfg, cfg.roms[ romIx ], results[ romIx ] );
+		run.Run();
+	} );
+
+	const double totalMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+	uint32_t counts[ 5 ] = {};
+	size_t nameWidth = 0;
+	for ( const testResult_t& r : results ) {
+		nameWidth = std::max( nameWidth, r.rom.size() );
+	}
+
+	for ( const testResult_t& r : results )
+	{
+		++counts[ static_cast<uint32_t>( r.status ) ];
+		printf( "%-7s %-*s %6u frames %8.1f ms  %s\n", StatusName( r.status ), static_cast<int>( nameWidth ), r.rom.c_str(), r.frames, r.ms, r.message.c_str() );
+	}
+
+	printf( "\n%u passed, %u failed, %u timed out, %u skipped, %u errors in %.1f ms\n",
+		counts[ static_cast<uint32_t>( testStatus_t::PASS ) ],
+		counts[ static_cast<uint32_t>( testStatus_t::FAIL ) ],
+		counts[ static_cast<uint32_t>( testStatus_t::TIMEOUT ) ],
+		counts[ static_cast<uint32_t>( testStatus_t::NO_RESULT ) ],
+		counts[ static_cast<uint32_t>( testStatus_t::LOAD_ERROR ) ],
+		totalMs );
+
+	const uint32_t failures = counts[ static_cast<uint32_t>( testStatus_t::FAIL ) ] + counts[ static_cast<uint32_t>( testStatus_t::TIMEOUT ) ] + counts[ static_cast<uint32_t>( testStatus_t::LOAD_ERROR ) ];
+	return ( failures > 0 ) ? 1 : 0;
+}
@@ -0,0 +1,241 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+#include "../wintendoCore/src/system/NesSystem.h"
+#include "../wintendoCore/include/tomtendo/interface.h"
+#include "testUtil.h"
+#include "forkTest.h"
+
+// Usage: wintendoTest -fork [-romdir dir] [-frames N] [-copies N] [-jobs N] [-seed N] [rom.nes ...]
+// The original runs a third of the frames, then is cloned and both run the next third side by side.
+// The clone is then led astray on an idle pad, re-forked with CopyState and checked for the last third.
+
+static const uint32_t	ForkDefaultFrames	= 300;
+static const uint32_t	ForkDefaultCopies	= 1000;
+static const uint32_t	VideoSettleFrames	= 2;	// Frame buffers aren't forked, the fork's first pictures may be partial
+
+
+struct forkConfig_t : testOptions_t
+{
+	uint32_t					copies;
+};
+
+
+struct forkResult_t
+{
+	std::string		rom;
+	bool			passed;
+	uint32_t		checkedFrames;
+	double			copyUs;
+	double			ms;
+	std::string		message;
+};
+
+
+class wtForkRun
+{
+public:
+	wtForkRun( const forkConfig_t& config, const std::string& romName, forkResult_t& outResult )
+		: cfg( config ), result( outResult ), pad( config.seed ), idle()
+	{
+		result.rom = romName;
+		result.passed = false;
+		result.checkedFrames = 0;
+		result.copyUs = 0.0;
+		result.ms = 0.0;
+
+		sysCfg = DefaultConfig();
+		sysCfg.sys.flags = emulationFlags_t::HEADLESS | emulationFlags_t::FRAME_HASH;
+	}
+
+	void Run()
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		if ( !ReadFile( cfg.romDir + "/" + result.rom, romData ) ) {
+			result.message = "unreadable";
+		} else {
+			Check();
+		}
+
+		result.ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+	}
+
+private:
+	static frameHash_t StepFrame( wtSystem& system )
+	{
+		system.RunEpoch( FrameLatencyNs );
+
+		wtFrameResult frameResult;
+		system.GetFrameResult( frameResult );
+		return frameResult.frameHash;
+	}
+
+	// Runs both machines 'count' frames on the scripted pad and compares them after each
+	bool RunSideBySide( wtSystem& original, wtSystem& fork, const uint32_t firstFrame, const uint32_t count, const char* pass )
+	{
+		for ( uint32_t i = 0; i < count; ++i )
+		{
+			pad.Update( firstFrame + i );
+
+			const frameHash_t a = StepFrame( original );
+			const frameHash_t b = StepFrame( fork );
+
+			const bool videoSettled = ( i >= VideoSettleFrames );
+			if ( ( a.frame != b.frame ) || ( a.state != b.state ) || ( a.ram != b.ram ) || ( videoSettled && ( a.video != b.video ) ) )
+			{
+				result.message = std::string( pass ) + ": frame " + std::to_string( a.frame ) + " differs from the original";
+				return false;
+			}
+			++result.checkedFrames;
+		}
+		return true;
+	}
+
+	void Check()
+	{
+		std::unique_ptr<wtSystem> original( new wtSystem() );
+		if ( original->Init( romData.data(), static_cast<uint32_t>( romData.size() ) ) != 0 )
+		{
+			result.message = "bad header";
+			return;
+		}
+		original->AttachInputHandler( pad.GetInput() );
+		original->SetConfig( sysCfg );
+
+		const uint32_t third = std::max( 1u, cfg.frames / 3 );
+		uint32_t frame = 0;
+		for ( ; frame < third; ++frame )
+		{
+			pad.Update( frame );
+			StepFrame( *original );
+		}
+
+		std::unique_ptr<wtSystem> fork( new wtSystem() );
+		if ( fork->Clone( *original ) != 0 )
+		{
+			result.message = "clone failed";
+			return;
+		}
+		if ( !RunSideBySide( *original, *fork, frame, third, "clone" ) ) {
+			return;
+		}
+		frame += third;
+
+		// Let the fork wander off on its own pad so CopyState has to overwrite a different machine
+		fork->AttachInputHandler( &idle );
+		for ( uint32_t i = 0; i < wtScriptedPad::HoldFrames; ++i ) {
+			StepFrame( *fork );
+		}
+		fork->AttachInputHandler( pad.GetInput() );
+
+		const auto copyStart = std::chrono::steady_clock::now();
+		for ( uint32_t i = 0; i < cfg.copies; ++i )
+		{
+			if ( !fork->CopyState( *original ) )
+			{
+				result.message = "CopyState refused the original";
+				return;
+			}
+		}
+		result.copyUs = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - copyStart ).count() / std::max( 1u, cfg.copies );
+
+		if ( !RunSideBySide( *original, *fork, frame, third, "copy" ) ) {
+			return;
+		}
+
+		result.passed = ( result.checkedFrames > 0 );
+		if ( !result.passed ) {
+			result.message = "no frames compared";
+		}
+	}
+
+	const forkConfig_t&		cfg;
+	forkResult_t&			result;
+	config_t				sysCfg;
+	std::vector<uint8_t>	romData;
+	wtScriptedPad			pad;
+	const Input				idle;
+};
+
+
+static bool ParseArgs( const int argc, char* argv[], forkConfig_t& cfg )
+{
+	cfg.frames = ForkDefaultFrames;
+	cfg.copies = ForkDefaultCopies;
+
+	const bool parsed = ParseTestArgs( argc, argv, TEST_OPTION_FRAMES | TEST_OPTION_JOBS | TEST_OPTION_SEED, cfg, [ &cfg ]( const char* option, const char* value )
+	{
+		if ( strcmp( option, "-copies" ) == 0 )
+		{
+			cfg.copies = static_cast<uint32_t>( std::max( 1, atoi( value ) ) );
+			return true;
+		}
+		return false;
+	} );
+
+	cfg.frames = std::max( 3u, cfg.frames );
+	return parsed;
+}
+
+
+int ForkMain( int argc, char* argv[] )
+{
+	forkConfig_t cfg;
+	if ( !ParseArgs( argc, argv, cfg ) )
+	{
+		fprintf( stderr, "Usage: wintendoTest -fork [-romdir dir] [-frames N] [-copies N] [-jobs N] [-seed N] [rom.nes ...]\n" );
+		return 1;
+	}
+
+	std::vector<forkResult_t> results( cfg.roms.size() );
+
+	const auto job = [ & ]( const uint32_t romIx )
+	{
+		std::unique_ptr<wtForkRun> run( new wtForkRun( cfg, cfg.roms[ romIx ], results[ romIx ] ) );
+		run->Run();
+		return results[ romIx ].passed;
+	};
+
+	const auto formatRow = [ & ]( const uint32_t romIx )
+	{
+		const forkResult_t& r = results[ romIx ];
+		char row[ 256 ];
+		snprintf( row, sizeof( row ), "%6u frames %8.2f us/copy %8.1f ms  %s", r.checkedFrames, r.copyUs, r.ms, r.message.c_str() );
+		return std::string( row );
+	};
+
+	return RunRomJobs( cfg, "forks matched", job, formatRow );
+}
@@ -0,0 +1,397 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+#include "../wintendoCore/src/system/NesSystem.h"
+#include "../wintendoCore/include/tomtendo/interface.h"
+#include "testUtil.h"
+#include "lockstep.h"
+
+// Usage: wintendoTest -lockstep [-romdir dir] [-frames N] [-jobs N] [-seed N] [rom.nes ...]
+// Both machines see the same scripted input, seed 0 holds no buttons. After every frame each
+// savestate section and the finished frame are hashed and compared. On a mismatch both machines
+// rewind to the start of the frame and the divergence is bisected down to a single CPU cycle.
+
+static const uint32_t	LockstepDefaultFrames	= 600;
+static const uint32_t	MaxDumpBytes			= 16;	// Differing bytes listed per section
+
+static const char*		SectionLabels[]			= { STATE_SYSTEM_LABEL, STATE_MEMORY_LABEL, STATE_CPU_LABEL, STATE_PPU_LABEL, STATE_VRAM_LABEL, STATE_APU_LABEL, STATE_MAPPER_LABEL };
+
+enum class lockstepStatus_t : uint8_t
+{
+	MATCH,
+	DIVERGED,
+	LOAD_ERROR,
+};
+
+
+typedef testOptions_t lockstepConfig_t;
+
+
+struct lockstepResult_t
+{
+	std::string			rom;
+	lockstepStatus_t	status;
+	uint32_t			frames;
+	double				ms;
+	std::string			message;
+	std::string			dump;
+};
+
+
+struct sectionHash_t
+{
+	uint32_t	tag;
+	uint32_t	offset;
+	uint32_t	size;
+	uint64_t	hash;
+};
+
+
+static const char* SectionName( const uint32_t tag )
+{
+	for ( const char* label : SectionLabels )
+	{
+		if ( HashString32( label ) == tag ) {
+			return label;
+		}
+	}
+	return "?";
+}
+
+
+class wtLockstepMachine
+{
+public:
+	wtLockstepMachine( const char* machineName, const emulationFlags_t flags )
+		: name( machineName ), frameBufferHash( 0 )
+	{
+		cfg = DefaultConfig();
+		cfg.sys.flags = flags;
+	}
+
+	bool Boot( const std::vector<uint8_t>& romData, const Input* input )
+	{
+		system.reset( new wtSystem() );
+		if ( system->Init( romData.data(), static_cast<uint32_t>( romData.size() ) ) != 0 ) {
+			return false;
+		}
+		system->AttachInputHandler( input );
+		system->SetConfig( cfg );
+		return true;
+	}
+
+	void StepFrame()
+	{
+		system->RunEpoch( FrameLatencyNs );
+
+		wtFrameResult frameResult;
+		system->GetFrameResult( frameResult );
+		cycleBegin = frameResult.dbgInfo.cycleBegin;
+		cycleEnd = frameResult.dbgInfo.cycleEnd;
+
+		const wtDisplayImage* frameBuffer = frameResult.frameBuffer;
+		frameBufferHash = Hash64( frameBuffer->GetRawBuffer(), frameBuffer->GetBufferLength() * sizeof( uint32_t ) );
+	}
+
+	void RunTo( const masterCycle_t& cycle )
+	{
+		system->Run( cycle );
+	}
+
+	// Serializes the machine into 'state' and hashes every labeled section
+	void Hash()
+	{
+		state.resize( system->GetStateSize() );
+		Serializer serializer( state.data(), static_cast<uint32_t>( state.size() ), serializeMode_t::STORE );
+		system->Serialize( serializer );
+
+		sections.clear();
+		for ( uint32_t i = 0; i < serializer.GetSectionCount(); ++i )
+		{
+			const serializerHeader_t::section_t& section = serializer.GetSection( i );
+			sections.push_back( { section.tag, section.offset, section.size, Hash64( state.data() + section.offset, section.size ) } );
+		}
+	}
+
+	void Restore( std::vector<uint8_t>& snapshot )
+	{
+		Serializer serializer( snapshot.data(), static_cast<uint32_t>( snapshot.size() ), serializeMode_t::LOAD );
+		system->Serialize( serializer );
+	}
+
+	std::string Registers()
+	{
+		cpuDebug_t regs;
+		system->GetState( regs );
+
+		char text[ 64 ];
+		snprintf( text, sizeof( text ), "PC:%04X A:%02X X:%02X Y:%02X P:%02X SP:%02X", regs.PC, regs.A, regs.X, regs.Y, regs.P, regs.SP );
+		return text;
+	}
+
+	const char*					name;
+	config_t					cfg;
+	std::unique_ptr<wtSystem>	system;
+	std::vector<uint8_t>		state;
+	std::vector<sectionHash_t>	sections;
+	uint64_t					frameBufferHash;
+	masterCycle_t				cycleBegin;
+	masterCycle_t				cycleEnd;
+};
+
+
+class wtLockstepRun
+{
+public:
+	wtLockstepRun( const lockstepConfig_t& config, const std::string& romName, lockstepResult_t& outResult )
+		: cfg( config ), result( outResult ), pad( config.seed ),
+		fast( "fast", emulationFlags_t::HEADLESS ),
+		reference( "reference", emulationFlags_t::HEADLESS | emulationFlags_t::REFERENCE )
+	{
+		result.rom = romName;
+		result.status = lockstepStatus_t::LOAD_ERROR;
+		result.frames = 0;
+		result.ms = 0.0;
+	}
+
+	void Run()
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		if ( !ReadFile( cfg.romDir + "/" + result.rom, romData ) ) {
+			result.message = "unreadable";
+		} else if ( !fast.Boot( romData, pad.GetInput() ) || !reference.Boot( romData, pad.GetInput() ) ) {
+			result.message = "bad header";
+		} else {
+			RunFrames();
+		}
+
+		result.ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+	}
+
+private:
+	bool StatesMatch() const
+	{
+		if ( fast.sections.size() != reference.sections.size() ) {
+			return false;
+		}
+		for ( size_t i = 0; i < fast.sections.size(); ++i )
+		{
+			if ( ( fast.sections[ i ].size != reference.sections[ i ].size ) || ( fast.sections[ i ].hash != reference.sections[ i ].hash ) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void RunFrames()
+	{
+		// The state hashed after a frame is the snapshot to rewind to if the next one diverges
+		std::vector<uint8_t> fastSnapshot;
+		std::vector<uint8_t> referenceSnapshot;
+
+		fast.Hash();
+		reference.Hash();
+		if ( !StatesMatch() )
+		{
+			result.status = lockstepStatus_t::DIVERGED;
+			result.message = "power-on state differs";
+			DumpDifferences();
+			return;
+		}
+
+		while ( result.frames < cfg.frames )
+		{
+			if ( cfg.seed != 0 ) {
+				pad.Update( result.frames );
+			}
+
+			std::swap( fastSnapshot, fast.state );
+			std::swap( referenceSnapshot, reference.state );
+
+			fast.StepFrame();
+			reference.StepFrame();
+			++result.frames;
+
+			fast.Hash();
+			reference.Hash();
+
+			if ( StatesMatch() && ( fast.frameBufferHash == reference.frameBufferHash ) ) {
+				continue;
+			}
+
+			result.status = lockstepStatus_t::DIVERGED;
+			Bisect( fastSnapshot, referenceSnapshot );
+			return;
+		}
+
+		result.status = lockstepStatus_t::MATCH;
+		result.message = std::to_string( fast.sections.size() ) + " sections and frame buffer match";
+	}
+
+	bool ReplayTo( std::vector<uint8_t>& fastSnapshot, std::vector<uint8_t>& referenceSnapshot, const uint64_t cpuCycles )
+	{
+		const masterCycle_t target = fast.cycleBegin + CpuToMasterCycle( cpuCycle_t( cpuCycles ) );
+
+		fast.Restore( fastSnapshot );
+		reference.Restore( referenceSnapshot );
+		fast.RunTo( target );
+		reference.RunTo( target );
+		fast.Hash();
+		reference.Hash();
+
+		return StatesMatch();
+	}
+
+	void Bisect( std::vector<uint8_t>& fastSnapshot, std::vector<uint8_t>& referenceSnapshot )
+	{
+		const std::string frame = "frame " + std::to_string( result.frames );
+		const bool stateMatched = StatesMatch();
+
+		// The frame is re-run from the snapshots in one call first. If that matches, the difference
+		// lives outside the savestate and can't be narrowed down by rewinding.
+		uint64_t lo = 0;
+		uint64_t hi = MasterToCpuCycle( fast.cycleEnd - fast.cycleBegin ).count();
+		if ( ReplayTo( fastSnapshot, referenceSnapshot, hi ) )
+		{
+			result.message = frame + ( stateMatched ? ": frame buffer differs, machine state matches" : ": diverged, but not after rewinding to the frame start" );
+			return;
+		}
+
+		// Invariant: lo matches, hi differs
+		while ( ( hi - lo ) > 1 )
+		{
+			const uint64_t mid = lo + ( hi - lo ) / 2;
+			if ( ReplayTo( fastSnapshot, referenceSnapshot, mid ) ) {
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+		ReplayTo( fastSnapshot, referenceSnapshot, hi );
+
+		const uint64_t cpuCycle = MasterToCpuCycle( fast.cycleBegin ).count() + hi;
+		result.message = frame + ", CPU cycle " + std::to_string( cpuCycle );
+		DumpDifferences();
+	}
+
+	void DumpDifferences()
+	{
+		std::string& dump = result.dump;
+		char line[ 128 ];
+
+		snprintf( line, sizeof( line ), "  %-10s %s\n", fast.name, fast.Registers().c_str() );
+		dump += line;
+		snprintf( line, sizeof( line ), "  %-10s %s\n", reference.name, reference.Registers().c_str() );
+		dump += line;
+
+		const size_t sectionCount = std::min( fast.sections.size(), reference.sections.size() );
+		for ( size_t i = 0; i < sectionCount; ++i )
+		{
+			const sectionHash_t& a = fast.sections[ i ];
+			const sectionHash_t& b = reference.sections[ i ];
+			if ( ( a.size == b.size ) && ( a.hash == b.hash ) ) {
+				continue;
+			}
+
+			snprintf( line, sizeof( line ), "  %s differs (%u bytes)\n", SectionName( a.tag ), a.size );
+			dump += line;
+
+			uint32_t listed = 0;
+			const uint32_t size = std::min( a.size, b.size );
+			for ( uint32_t offset = 0; ( offset < size ) && ( listed < MaxDumpBytes ); ++offset )
+			{
+				const uint8_t fastByte = fast.state[ a.offset + offset ];
+				const uint8_t referenceByte = reference.state[ b.offset + offset ];
+				if ( fastByte != referenceByte )
+				{
+					snprintf( line, sizeof( line ), "    +%04X  %s %02X  %s %02X\n", offset, fast.name, fastByte, reference.name, referenceByte );
+					dump += line;
+					++listed;
+				}
+			}
+		}
+	}
+
+	const lockstepConfig_t&		cfg;
+	lockstepResult_t&			result;
+	std::vector<uint8_t>		romData;
+	wtScriptedPad				pad;
+	wtLockstepMachine			fast;
+	wtLockstepMachine			reference;
+};
+
+
+static bool ParseArgs( const int argc, char* argv[], lockstepConfig_t& cfg )
+{
+	cfg.frames = LockstepDefaultFrames;
+	return ParseTestArgs( argc, argv, TEST_OPTION_FRAMES | TEST_OPTION_JOBS | TEST_OPTION_SEED, cfg );
+}
+
+
+int LockstepMain( int argc, char* argv[] )
+{
+	lockstepConfig_t cfg;
+	if ( !ParseArgs( argc, argv, cfg ) )
+	{
+		fprintf( stderr, "Usage: wintendoTest -lockstep [-romdir dir] [-frames N] [-jobs N] [-seed N] [rom.nes ...]\n" );
+		return 1;
+	}
+
+	std::vector<lockstepResult_t> results( cfg.roms.size() );
+
+	const auto job = [ & ]( const uint32_t romIx )
+	{
+		std::unique_ptr<wtLockstepRun> run( new wtLockstepRun( cfg, cfg.roms[ romIx ], results[ romIx ] ) );
+		run->Run();
+		return ( results[ romIx ].status == lockstepStatus_t::MATCH );
+	};
+
+	// The differences, if any, go on the lines below the row
+	const auto formatRow = [ & ]( const uint32_t romIx )
+	{
+		const lockstepResult_t& r = results[ romIx ];
+		char row[ 256 ];
+		snprintf( row, sizeof( row ), "%6u frames %8.1f ms  %s", r.frames, r.ms, r.message.c_str() );
+
+		std::string text = row;
+		if ( !r.dump.empty() ) {
+			text += "\n" + r.dump.substr( 0, r.dump.size() - 1 );
+		}
+		return text;
+	};
+
+	return RunRomJobs( cfg, "ROMs ran in lockstep", job, formatRow );
+}
@@ -0,0 +1,346 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+#include "../wintendoCore/src/system/NesSystem.h"
+#include "../wintendoCore/include/tomtendo/interface.h"
+#include "testUtil.h"
+#include "movieTest.h"
+
+// Usage: wintendoTest -movie [-romdir dir] [-workdir dir] [-frames N] [-keyframes N] [-jobs N] [-seed N] [rom.nes ...]
+// Each ROM is copied to workdir so the movie streams to disk beside it. The recording machine
+// holds a scripted pad from power-on; the playback machines hold nothing and only see the movie.
+
+static const uint32_t	MovieDefaultFrames		= 600;
+static const uint32_t	MovieDefaultKeyframes	= 60;
+static const uint32_t	MaxEpochSlack			= 16;	// Epochs allowed past the movie end before giving up
+
+typedef std::map<uint64_t, frameHash_t> frameHashMap_t;
+
+struct movieConfig_t : testOptions_t
+{
+	std::string					workDir;
+	uint32_t					keyframes;
+};
+
+
+struct movieResult_t
+{
+	std::string		rom;
+	bool			passed;
+	uint32_t		checkedFrames;
+	uint64_t		movieBytes;
+	double			ms;
+	std::string		message;
+};
+
+
+class wtMovieRun
+{
+public:
+	wtMovieRun( const movieConfig_t& config, const std::string& romName, movieResult_t& outResult )
+		: cfg( config ), result( outResult ), pad( config.seed )
+	{
+		result.rom = romName;
+		result.passed = false;
+		result.checkedFrames = 0;
+		result.movieBytes = 0;
+		result.ms = 0.0;
+
+		sysCfg = DefaultConfig();
+		sysCfg.sys.flags = emulationFlags_t::HEADLESS | emulationFlags_t::FRAME_HASH;
+
+		std::string flatName = romName;
+		std::replace( flatName.begin(), flatName.end(), '/', '_' );
+		romPath = cfg.workDir + "/movie_" + flatName;
+		moviePath = romPath.substr( 0, romPath.size() - 4 ) + ".wtm";
+	}
+
+	~wtMovieRun()
+	{
+		remove( romPath.c_str() );
+		remove( moviePath.c_str() );
+	}
+
+	void Run()
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<uint8_t> romData;
+		if ( !ReadFile( cfg.romDir + "/" + result.rom, romData ) || !WriteFile( romPath, romData ) ) {
+			result.message = "can't stage ROM in " + cfg.workDir;
+		} else {
+			Check();
+		}
+
+		result.ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+	}
+
+private:
+	bool Boot( std::unique_ptr<wtSystem>& system, const Input* pad )
+	{
+		system.reset( new wtSystem() );
+		if ( system->Init( std::wstring( romPath.begin(), romPath.end() ) ) != 0 ) {
+			return false;
+		}
+		system->AttachInputHandler( pad );
+		system->SetConfig( sysCfg );
+		return true;
+	}
+
+	// Runs until the machine leaves 'replayState', keeping the hash of every frame finished inside it
+	bool RunMovie( wtSystem& system, const replayStateCode_t replayState, const bool scripted, frameHashMap_t& outHashes )
+	{
+		for ( uint32_t epoch = 0; epoch < ( cfg.frames + MaxEpochSlack ); ++epoch )
+		{
+			if ( scripted ) {
+				pad.Update( epoch );
+			}
+
+			system.RunEpoch( FrameLatencyNs );
+
+			wtFrameResult frameResult;
+			system.GetFrameResult( frameResult );
+			if ( frameResult.playbackState.replayState != replayState ) {
+				return true;
+			}
+			outHashes[ frameResult.frameHash.frame ] = frameResult.frameHash;
+		}
+		return false;
+	}
+
+	bool Compare( const frameHashMap_t& recorded, const frameHashMap_t& played, const char* pass )
+	{
+		for ( const auto& it : played )
+		{
+			const auto match = recorded.find( it.first );
+			if ( match == recorded.end() ) {
+				continue;
+			}
+
+			const frameHash_t& a = match->second;
+			const frameHash_t& b = it.second;
+			if ( ( a.state != b.state ) || ( a.video != b.video ) || ( a.ram != b.ram ) )
+			{
+				result.message = std::string( pass ) + ": frame " + std::to_string( it.first ) + " differs from the recording";
+				return false;
+			}
+			++result.checkedFrames;
+		}
+		return true;
+	}
+
+	// Marks the CPU section of every keyframe as saved by a newer build and writes the movie back
+	bool WriteUnreadableKeyframes( std::vector<uint8_t> movieData )
+	{
+		movieFileHeader_t header;
+		if ( movieData.size() < sizeof( header ) ) {
+			return false;
+		}
+		memcpy( &header, movieData.data(), sizeof( header ) );
+
+		uint32_t keyframes = 0;
+		for ( size_t pos = header.headerSize; ( pos + sizeof( movieChunk_t ) ) <= movieData.size(); )
+		{
+			movieChunk_t chunk;
+			memcpy( &chunk, movieData.data() + pos, sizeof( chunk ) );
+			pos += sizeof( chunk );
+
+			stateFileHeader_t state;
+			if ( ( chunk.type == MOVIE_CHUNK_STATE ) && ( chunk.size >= sizeof( state ) ) )
+			{
+				memcpy( &state, movieData.data() + pos, sizeof( state ) );
+				for ( uint32_t i = 0; i < state.sectionCount; ++i )
+				{
+					stateFileSection_t section;
+					uint8_t* entry = movieData.data() + pos + state.sectionOffset + i * state.sectionEntrySize;
+					memcpy( &section, entry, sizeof( section ) );
+					if ( section.tag == HashString32( STATE_CPU_LABEL ) )
+					{
+						section.version = wtStateFile::CurrentVersion( section.tag ) + 1;
+						memcpy( entry, &section, sizeof( section ) );
+						++keyframes;
+					}
+				}
+			}
+			pos += chunk.size;
+		}
+		return ( keyframes > 0 ) && WriteFile( moviePath, movieData );
+	}
+
+	void Check()
+	{
+		std::unique_ptr<wtSystem> recorder;
+		if ( !Boot( recorder, pad.GetInput() ) )
+		{
+			result.message = "bad header";
+			return;
+		}
+
+		sysCmd_t cmd;
+		cmd.type = sysCmdType_t::RECORD;
+		cmd.parms[ 0 ].i = cfg.frames;
+		cmd.parms[ 1 ].u = 1;
+		cmd.parms[ 2 ].i = cfg.keyframes;
+		recorder->SubmitCommand( cmd );
+
+		frameHashMap_t recorded;
+		if ( !RunMovie( *recorder, replayStateCode_t::RECORD, true, recorded ) )
+		{
+			result.message = "recording never finished";
+			return;
+		}
+		recorder.reset(); // Shutdown flushes the tail of the movie
+
+		std::vector<uint8_t> movieData;
+		ReadFile( moviePath, movieData );
+		result.movieBytes = movieData.size();
+
+		const Input idle = Input();
+		const int64_t startFrames[] = { 0, cfg.frames / 2 + 7, cfg.frames / 3 + 3, cfg.frames / 2 + 7 };
+		const char* passNames[] = { "playback", "seek", "rewind", "fallback" };
+		std::unique_ptr<wtSystem> firstPlayer;
+		for ( uint32_t pass = 0; pass < 4; ++pass )
+		{
+			// The last pass seeks past keyframes this build can't read, it has to fall back to power-on
+			if ( ( pass == 3 ) && !WriteUnreadableKeyframes( movieData ) )
+			{
+				result.message = "can't rewrite the movie's keyframes";
+				return;
+			}
+
+			// The rewind goes back over the first player's movie, so it restores from that machine's seek index
+			std::unique_ptr<wtSystem> player( ( pass == 2 ) ? firstPlayer.release() : nullptr );
+			if ( !player && !Boot( player, &idle ) )
+			{
+				result.message = "bad header";
+				return;
+			}
+
+			cmd = sysCmd_t();
+			cmd.type = sysCmdType_t::REPLAY;
+			cmd.parms[ 0 ].i = startFrames[ pass ];
+			player->SubmitCommand( cmd );
+
+			frameHashMap_t played;
+			if ( !RunMovie( *player, replayStateCode_t::REPLAY, false, played ) || played.empty() )
+			{
+				result.message = std::string( passNames[ pass ] ) + ": movie didn't play";
+				return;
+			}
+			if ( played.begin()->first < static_cast<uint64_t>( startFrames[ pass ] ) )
+			{
+				result.message = std::string( passNames[ pass ] ) + ": started before frame " + std::to_string( startFrames[ pass ] );
+				return;
+			}
+
+			// The last frame reads the pad after the movie ends
+			played.erase( std::prev( played.end() ) );
+			if ( !Compare( recorded, played, passNames[ pass ] ) ) {
+				return;
+			}
+
+			if ( pass == 0 ) {
+				firstPlayer = std::move( player );
+			}
+		}
+
+		result.passed = ( result.checkedFrames > 0 );
+		if ( !result.passed ) {
+			result.message = "no frames compared";
+		}
+	}
+
+	const movieConfig_t&	cfg;
+	movieResult_t&			result;
+	config_t				sysCfg;
+	wtScriptedPad			pad;
+	std::string				romPath;
+	std::string				moviePath;
+};
+
+
+static bool ParseArgs( const int argc, char* argv[], movieConfig_t& cfg )
+{
+	cfg.workDir = ".";
+	cfg.frames = MovieDefaultFrames;
+	cfg.keyframes = MovieDefaultKeyframes;
+
+	const bool parsed = ParseTestArgs( argc, argv, TEST_OPTION_FRAMES | TEST_OPTION_JOBS | TEST_OPTION_SEED, cfg, [ &cfg ]( const char* option, const char* value )
+	{
+		if ( strcmp( option, "-workdir" ) == 0 ) {
+			cfg.workDir = value;
+		} else if ( strcmp( option, "-keyframes" ) == 0 ) {
+			cfg.keyframes = static_cast<uint32_t>( std::max( 1, atoi( value ) ) );
+		} else {
+			return false;
+		}
+		return true;
+	} );
+
+	cfg.frames = std::max( 2u, cfg.frames );
+	return parsed;
+}
+
+
+int MovieMain( int argc, char* argv[] )
+{
+	movieConfig_t cfg;
+	if ( !ParseArgs( argc, argv, cfg ) )
+	{
+		fprintf( stderr, "Usage: wintendoTest -movie [-romdir dir] [-workdir dir] [-frames N] [-keyframes N] [-jobs N] [-seed N] [rom.nes ...]\n" );
+		return 1;
+	}
+
+	std::vector<movieResult_t> results( cfg.roms.size() );
+
+	const auto job = [ & ]( const uint32_t romIx )
+	{
+		std::unique_ptr<wtMovieRun> run( new wtMovieRun( cfg, cfg.roms[ romIx ], results[ romIx ] ) );
+		run->Run();
+		return results[ romIx ].passed;
+	};
+
+	const auto formatRow = [ & ]( const uint32_t romIx )
+	{
+		const movieResult_t& r = results[ romIx ];
+		char row[ 256 ];
+		snprintf( row, sizeof( row ), "%6u frames %8llu bytes %8.1f ms  %s", r.checkedFrames, static_cast<unsigned long long>( r.movieBytes ), r.ms, r.message.c_str() );
+		return std::string( row );
+	};
+
+	return RunRomJobs( cfg, "movies replayed", job, formatRow );
+}
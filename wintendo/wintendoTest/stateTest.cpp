@@ -0,0 +1,318 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "../wintendoCore/src/system/NesSystem.h"
+#include "../wintendoCore/include/tomtendo/interface.h"
+#include "testUtil.h"
+#include "stateTest.h"
+
+// Usage: wintendoTest -state [-romdir dir] [-frames N] [-jobs N] [-seed N] [rom.nes ...]
+// The saved machine runs on the scripted pad, the loading machine idles for half as long first so
+// every field it keeps from before the load shows up as a difference.
+
+static const uint32_t	StateDefaultFrames	= 120;
+static const uint32_t	V1SystemSize		= 19;	// sysCycles, frameNumber, strobeOn, btnShift[ 2 ]
+
+static const char* const StateLabels[] = { STATE_SYSTEM_LABEL, STATE_MEMORY_LABEL, STATE_CPU_LABEL, STATE_PPU_LABEL, STATE_APU_LABEL, STATE_MAPPER_LABEL };
+static const uint32_t	StateLabelCount		= sizeof( StateLabels ) / sizeof( StateLabels[ 0 ] );
+
+
+struct stateSection_t
+{
+	uint32_t				tag;
+	uint32_t				version;
+	std::vector<uint8_t>	bytes;
+};
+
+typedef std::vector<stateSection_t> stateSectionList_t;
+
+
+struct stateResult_t
+{
+	std::string		rom;
+	bool			passed;
+	uint32_t		checkedImages;
+	uint32_t		stateBytes;
+	double			ms;
+	std::string		message;
+};
+
+
+// Splits the machine's state into its top level sections, as the current build writes them
+static bool CaptureSections( wtSystem& system, stateSectionList_t& outSections )
+{
+	Serializer serializer( system.GetStateSize(), serializeMode_t::STORE );
+	system.Serialize( serializer );
+
+	std::vector<uint8_t> image;
+	wtStateFile::Build( serializer, system.cart->GetHash(), 0, image );
+
+	wtStateFile file;
+	if ( !file.Parse( image.data(), static_cast<uint32_t>( image.size() ) ) ) {
+		return false;
+	}
+
+	outSections.clear();
+	for ( uint32_t i = 0; i < StateLabelCount; ++i )
+	{
+		stateSection_t section;
+		const uint8_t* data;
+		uint32_t size;
+		if ( !file.FindSection( StateLabels[ i ], &data, &size, &section.version ) ) {
+			return false;
+		}
+		section.tag = HashString32( StateLabels[ i ] );
+		section.bytes.assign( data, data + size );
+		outSections.push_back( section );
+	}
+	return true;
+}
+
+
+// Lays the sections out back to back; versions before 3 get the 12 byte entries without a version
+static void BuildImage( const stateSectionList_t& sections, const uint16_t fileVersion, const uint64_t romHash, std::vector<uint8_t>& outImage )
+{
+	const uint32_t entrySize = ( fileVersion < 3 ) ? StateLegacySectionSize : sizeof( stateFileSection_t );
+
+	std::vector<uint8_t> payload;
+	std::vector<uint8_t> table;
+	for ( const stateSection_t& section : sections )
+	{
+		const stateFileSection_t entry = { section.tag, static_cast<uint32_t>( payload.size() ), static_cast<uint32_t>( section.bytes.size() ), section.version };
+		const uint8_t* entryBytes = reinterpret_cast<const uint8_t*>( &entry );
+		table.insert( table.end(), entryBytes, entryBytes + entrySize );
+		payload.insert( payload.end(), section.bytes.begin(), section.bytes.end() );
+	}
+
+	stateFileHeader_t header = {};
+	header.magic			= StateFileMagic;
+	header.version			= fileVersion;
+	header.headerSize		= sizeof( stateFileHeader_t );
+	header.sectionCount		= static_cast<uint32_t>( sections.size() );
+	header.sectionOffset	= sizeof( stateFileHeader_t );
+	header.payloadOffset	= header.sectionOffset + static_cast<uint32_t>( table.size() );
+	header.payloadSize		= static_cast<uint32_t>( payload.size() );
+	header.payloadChecksum	= Hash32( payload.data(), payload.size() );
+	header.sectionEntrySize	= ( fileVersion < 3 ) ? 0 : entrySize;
+	header.romHash			= romHash;
+
+	const uint8_t* headerBytes = reinterpret_cast<const uint8_t*>( &header );
+	outImage.assign( headerBytes, headerBytes + sizeof( header ) );
+	outImage.insert( outImage.end(), table.begin(), table.end() );
+	outImage.insert( outImage.end(), payload.begin(), payload.end() );
+}
+
+
+class wtStateRun
+{
+public:
+	wtStateRun( const testOptions_t& config, const std::string& romName, stateResult_t& outResult )
+		: cfg( config ), result( outResult ), pad( config.seed ), idle()
+	{
+		result.rom = romName;
+		result.passed = false;
+		result.checkedImages = 0;
+		result.stateBytes = 0;
+		result.ms = 0.0;
+
+		sysCfg = DefaultConfig();
+		sysCfg.sys.flags = emulationFlags_t::HEADLESS;
+	}
+
+	void Run()
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		if ( !ReadFile( cfg.romDir + "/" + result.rom, romData ) ) {
+			result.message = "unreadable";
+		} else {
+			Check();
+		}
+
+		result.ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+	}
+
+private:
+	bool Boot( std::unique_ptr<wtSystem>& system, const Input* input, const uint32_t frames )
+	{
+		system.reset( new wtSystem() );
+		if ( system->Init( romData.data(), static_cast<uint32_t>( romData.size() ) ) != 0 ) {
+			return false;
+		}
+		system->AttachInputHandler( input );
+		system->SetConfig( sysCfg );
+
+		for ( uint32_t frame = 0; frame < frames; ++frame )
+		{
+			pad.Update( frame );
+			system->RunEpoch( FrameLatencyNs );
+		}
+		return true;
+	}
+
+	// Loads 'image' into a machine that has wandered off on an idle pad and checks the result section by section
+	bool CheckLoad( const std::vector<uint8_t>& image, const bool accepted, const stateSectionList_t& expected, const char* pass )
+	{
+		std::unique_ptr<wtSystem> loader;
+		stateSectionList_t before;
+		if ( !Boot( loader, &idle, cfg.frames / 2 ) || !CaptureSections( *loader, before ) )
+		{
+			result.message = std::string( pass ) + ": can't boot the loader";
+			return false;
+		}
+
+		wtStateFile file;
+		const bool loaded = file.Parse( image.data(), static_cast<uint32_t>( image.size() ) ) && loader->LoadSections( file, STATE_SECTION_ALL );
+		if ( loaded != accepted )
+		{
+			result.message = std::string( pass ) + ( accepted ? ": image rejected" : ": image accepted" );
+			return false;
+		}
+
+		stateSectionList_t after;
+		CaptureSections( *loader, after );
+		const stateSectionList_t& want = accepted ? expected : before;
+		for ( uint32_t i = 0; i < StateLabelCount; ++i )
+		{
+			if ( after[ i ].bytes != want[ i ].bytes )
+			{
+				result.message = std::string( pass ) + ": the " + StateLabels[ i ] + " section differs";
+				return false;
+			}
+		}
+		++result.checkedImages;
+		return true;
+	}
+
+	void Check()
+	{
+		std::unique_ptr<wtSystem> saved;
+		std::unique_ptr<wtSystem> powerOn;
+		if ( !Boot( saved, pad.GetInput(), cfg.frames ) || !Boot( powerOn, &idle, 0 ) )
+		{
+			result.message = "bad header";
+			return;
+		}
+
+		stateSectionList_t savedSections;
+		stateSectionList_t powerOnSections;
+		if ( !CaptureSections( *saved, savedSections ) || !CaptureSections( *powerOn, powerOnSections ) )
+		{
+			result.message = "can't capture state";
+			return;
+		}
+		const uint64_t romHash = saved->cart->GetHash();
+
+		std::vector<uint8_t> image;
+		BuildImage( savedSections, StateFileVersion, romHash, image );
+		result.stateBytes = static_cast<uint32_t>( image.size() );
+		if ( !CheckLoad( image, true, savedSections, "current" ) ) {
+			return;
+		}
+
+		// Version 1 ends the System section before mirroring, overflow cycles and DMC transfer, those come from power-on
+		stateSectionList_t v1 = savedSections;
+		v1[ 0 ].version = 1;
+		v1[ 0 ].bytes.resize( V1SystemSize );
+
+		stateSectionList_t v1Expected = savedSections;
+		std::copy( powerOnSections[ 0 ].bytes.begin() + V1SystemSize, powerOnSections[ 0 ].bytes.end(), v1Expected[ 0 ].bytes.begin() + V1SystemSize );
+
+		BuildImage( v1, 1, romHash, image );
+		if ( !CheckLoad( image, true, v1Expected, "version 1" ) ) {
+			return;
+		}
+
+		// A section the file lacks stays at power-on, one this build doesn't know is skipped
+		stateSectionList_t missing = savedSections;
+		missing[ 4 ].tag = HashString32( "Unknown" );
+
+		stateSectionList_t missingExpected = savedSections;
+		missingExpected[ 4 ] = powerOnSections[ 4 ];
+
+		BuildImage( missing, StateFileVersion, romHash, image );
+		if ( !CheckLoad( image, true, missingExpected, "missing section" ) ) {
+			return;
+		}
+
+		// A newer section layout can't be read, so nothing may change
+		stateSectionList_t newer = savedSections;
+		newer[ 2 ].version = wtStateFile::CurrentVersion( newer[ 2 ].tag ) + 1;
+
+		BuildImage( newer, StateFileVersion, romHash, image );
+		if ( !CheckLoad( image, false, savedSections, "newer section" ) ) {
+			return;
+		}
+
+		result.passed = true;
+	}
+
+	const testOptions_t&	cfg;
+	stateResult_t&			result;
+	config_t				sysCfg;
+	std::vector<uint8_t>	romData;
+	wtScriptedPad			pad;
+	const Input				idle;
+};
+
+
+int StateMain( int argc, char* argv[] )
+{
+	testOptions_t cfg;
+	cfg.frames = StateDefaultFrames;
+	if ( !ParseTestArgs( argc, argv, TEST_OPTION_FRAMES | TEST_OPTION_JOBS | TEST_OPTION_SEED, cfg ) )
+	{
+		fprintf( stderr, "Usage: wintendoTest -state [-romdir dir] [-frames N] [-jobs N] [-seed N] [rom.nes ...]\n" );
+		return 1;
+	}
+
+	std::vector<stateResult_t> results( cfg.roms.size() );
+
+	const auto job = [ & ]( const uint32_t romIx )
+	{
+		std::unique_ptr<wtStateRun> run( new wtStateRun( cfg, cfg.roms[ romIx ], results[ romIx ] ) );
+		run->Run();
+		return results[ romIx ].passed;
+	};
+
+	const auto formatRow = [ & ]( const uint32_t romIx )
+	{
+		const stateResult_t& r = results[ romIx ];
+		char row[ 256 ];
+		snprintf( row, sizeof( row ), "%6u images %8u bytes %8.1f ms  %s", r.checkedImages, r.stateBytes, r.ms, r.message.c_str() );
+		return std::string( row );
+	};
+
+	return RunRomJobs( cfg, "states loaded as expected", job, formatRow );
+}
@@ -0,0 +1,244 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#endif
+#include "testUtil.h"
+
+bool ReadFile( const std::string& path, std::vector<uint8_t>& outData )
+{
+	FILE* file = fopen( path.c_str(), "rb" );
+	if ( file == nullptr ) {
+		return false;
+	}
+
+	fseek( file, 0, SEEK_END );
+	const long size = ftell( file );
+	fseek( file, 0, SEEK_SET );
+
+	outData.resize( ( size > 0 ) ? static_cast<size_t>( size ) : 0 );
+	const size_t readSize = outData.empty() ? 0 : fread( outData.data(), 1, outData.size(), file );
+	fclose( file );
+
+	return ( readSize == outData.size() ) && !outData.empty();
+}
+
+
+bool WriteFile( const std::string& path, const std::vector<uint8_t>& data )
+{
+	FILE* file = fopen( path.c_str(), "wb" );
+	if ( file == nullptr ) {
+		return false;
+	}
+
+	const size_t written = fwrite( data.data(), 1, data.size(), file );
+	return ( fclose( file ) == 0 ) && ( written == data.size() );
+}
+
+
+void ListRoms( const std::string& dir, const std::string& prefix, std::vector<std::string>& outRoms )
+{
+	std::vector<std::string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA( ( dir + "\\*.nes" ).c_str(), &findData );
+	if ( find != INVALID_HANDLE_VALUE )
+	{
+		do {
+			names.push_back( findData.cFileName );
+		} while ( FindNextFileA( find, &findData ) );
+		FindClose( find );
+	}
+#else
+	DIR* dirHandle = opendir( dir.c_str() );
+	if ( dirHandle != nullptr )
+	{
+		while ( const dirent* entry = readdir( dirHandle ) )
+		{
+			const std::string name = entry->d_name;
+			if ( ( name.size() > 4 ) && ( name.compare( name.size() - 4, 4, ".nes" ) == 0 ) ) {
+				names.push_back( name );
+			}
+		}
+		closedir( dirHandle );
+	}
+#endif
+	std::sort( names.begin(), names.end() );
+	for ( const std::string& name : names ) {
+		outRoms.push_back( prefix + name );
+	}
+}
+
+
+void ListDefaultRoms( const std::string& romDir, std::vector<std::string>& outRoms )
+{
+	ListRoms( romDir, "", outRoms );
+	ListRoms( romDir + "/instr_test-v5/rom_singles", "instr_test-v5/rom_singles/", outRoms );
+}
+
+
+void RunJobs( const uint32_t jobCount, const uint32_t threadCount, const std::function<void( const uint32_t jobIx )>& job )
+{
+	std::atomic<uint32_t> nextJob( 0 );
+
+	std::vector<std::thread> workers;
+	const uint32_t workerCount = std::min( std::max( 1u, threadCount ), jobCount );
+	for ( uint32_t w = 0; w < workerCount; ++w )
+	{
+		workers.emplace_back( [ & ]()
+		{
+			for ( uint32_t i = nextJob++; i < jobCount; i = nextJob++ ) {
+				job( i );
+			}
+		} );
+	}
+
+	for ( std::thread& worker : workers ) {
+		worker.join();
+	}
+}
+
+
+bool ParseTestArgs( const int argc, char* argv[], const uint32_t optionBits, testOptions_t& opts, const modeOptionParser_t& modeOption )
+{
+	opts.romDir = "../wintendoCore/Tests";
+	opts.jobs = std::max( 1u, std::thread::hardware_concurrency() );
+	opts.seed = 1;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		const bool hasValue = ( i + 1 ) < argc;
+		if ( ( strcmp( argv[ i ], "-romdir" ) == 0 ) && hasValue ) {
+			opts.romDir = argv[ ++i ];
+		} else if ( ( optionBits & TEST_OPTION_FRAMES ) && ( strcmp( argv[ i ], "-frames" ) == 0 ) && hasValue ) {
+			opts.frames = static_cast<uint32_t>( std::max( 0, atoi( argv[ ++i ] ) ) );
+		} else if ( ( optionBits & TEST_OPTION_JOBS ) && ( strcmp( argv[ i ], "-jobs" ) == 0 ) && hasValue ) {
+			opts.jobs = std::max( 1, atoi( argv[ ++i ] ) );
+		} else if ( ( optionBits & TEST_OPTION_SEED ) && ( strcmp( argv[ i ], "-seed" ) == 0 ) && hasValue ) {
+			opts.seed = static_cast<uint32_t>( strtoul( argv[ ++i ], nullptr, 0 ) );
+		} else if ( modeOption && hasValue && modeOption( argv[ i ], argv[ i + 1 ] ) ) {
+			++i;
+		} else if ( argv[ i ][ 0 ] == '-' ) {
+			fprintf( stderr, "Unknown option: %s\n", argv[ i ] );
+			return false;
+		} else {
+			opts.roms.push_back( argv[ i ] );
+		}
+	}
+
+	if ( opts.roms.empty() ) {
+		ListDefaultRoms( opts.romDir, opts.roms );
+	}
+	return true;
+}
+
+
+int RunRomJobs( const testOptions_t& opts, const char* summary, const romJob_t& job, const romRowFormatter_t& formatRow )
+{
+	if ( opts.roms.empty() )
+	{
+		fprintf( stderr, "No ROMs found in %s\n", opts.romDir.c_str() );
+		return 1;
+	}
+
+	const uint32_t romCount = static_cast<uint32_t>( opts.roms.size() );
+	std::vector<uint8_t> passed( romCount, 0 );
+
+	const auto start = std::chrono::steady_clock::now();
+
+	RunJobs( romCount, opts.jobs, [ & ]( const uint32_t romIx ) {
+		passed[ romIx ] = job( romIx ) ? 1 : 0;
+	} );
+
+	const double totalMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+
+	size_t nameWidth = 0;
+	for ( const std::string& rom : opts.roms ) {
+		nameWidth = std::max( nameWidth, rom.size() );
+	}
+
+	uint32_t failures = 0;
+	for ( uint32_t romIx = 0; romIx < romCount; ++romIx )
+	{
+		failures += passed[ romIx ] ? 0 : 1;
+		printf( "%-7s %-*s %s\n", passed[ romIx ] ? "MATCH" : "DIVERGE", static_cast<int>( nameWidth ), opts.roms[ romIx ].c_str(), formatRow( romIx ).c_str() );
+	}
+
+	printf( "\n%u of %u %s in %.1f ms\n", romCount - failures, romCount, summary, totalMs );
+
+	return ( failures > 0 ) ? 1 : 0;
+}
+
+wtScriptedPad::wtScriptedPad( const uint32_t seed )
+{
+	for ( uint32_t i = 0; i < 8; ++i ) {
+		input.BindKey( static_cast<char>( 'A' + i ), Tomtendo::ControllerId::CONTROLLER_0, static_cast<Tomtendo::ButtonFlags>( 1 << i ) );
+	}
+	state = ( seed != 0 ) ? seed : 1;
+}
+
+
+uint8_t wtScriptedPad::NextButtons()
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return static_cast<uint8_t>( state & 0xFF );
+}
+
+
+void wtScriptedPad::Update( const uint32_t frame )
+{
+	if ( ( frame % HoldFrames ) != 0 ) {
+		return;
+	}
+
+	const uint8_t buttons = NextButtons();
+	for ( uint32_t i = 0; i < 8; ++i )
+	{
+		const char key = static_cast<char>( 'A' + i );
+		if ( ( buttons >> i ) & 1 ) {
+			input.StoreKey( key );
+		} else {
+			input.ReleaseKey( key );
+		}
+	}
+}
+
+
+const Tomtendo::Input* wtScriptedPad::GetInput() const
+{
+	return &input;
+}
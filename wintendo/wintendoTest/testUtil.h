@@ -0,0 +1,89 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include "../wintendoCore/include/tomtendo/interface.h"
+
+// Helpers shared by the modes of wintendoTest
+
+bool	ReadFile( const std::string& path, std::vector<uint8_t>& outData );
+bool	WriteFile( const std::string& path, const std::vector<uint8_t>& data );
+void	ListRoms( const std::string& dir, const std::string& prefix, std::vector<std::string>& outRoms );
+void	ListDefaultRoms( const std::string& romDir, std::vector<std::string>& outRoms ); // romDir and romDir/instr_test-v5/rom_singles
+void	RunJobs( const uint32_t jobCount, const uint32_t threadCount, const std::function<void( const uint32_t jobIx )>& job );
+
+// Checks one ROM on a worker thread and returns whether it passed
+typedef std::function<bool( const uint32_t romIx )> romJob_t;
+
+// The mode's columns for one ROM, printed after its name once every job is done
+typedef std::function<std::string( const uint32_t romIx )> romRowFormatter_t;
+
+
+enum testOptionBits_t : uint32_t
+{
+	TEST_OPTION_FRAMES	= ( 1 << 0 ),
+	TEST_OPTION_JOBS	= ( 1 << 1 ),
+	TEST_OPTION_SEED	= ( 1 << 2 ),
+};
+
+struct testOptions_t
+{
+	std::string					romDir;
+	uint32_t					frames;		// Set to the mode's default before parsing
+	uint32_t					jobs;
+	uint32_t					seed;
+	std::vector<std::string>	roms;
+};
+
+// Takes one of the mode's own "-option value" pairs, returns false if it isn't one
+typedef std::function<bool( const char* option, const char* value )> modeOptionParser_t;
+
+// Reads -romdir, the shared options enabled in 'optionBits', the mode's options and the ROM list
+bool	ParseTestArgs( const int argc, char* argv[], const uint32_t optionBits, testOptions_t& opts, const modeOptionParser_t& modeOption = nullptr );
+
+// Runs 'job' for every ROM on opts.jobs threads, prints a MATCH or DIVERGE row per ROM and
+// "N of M <summary> in T ms", and returns the exit code
+int		RunRomJobs( const testOptions_t& opts, const char* summary, const romJob_t& job, const romRowFormatter_t& formatRow );
+
+// Controller 0 on a xorshift32 script, so a seed replays the same pad on every platform
+class wtScriptedPad
+{
+public:
+	static const uint32_t	HoldFrames = 8; // Frames each button pattern is held
+
+	explicit wtScriptedPad( const uint32_t seed );
+
+	uint8_t					NextButtons();
+	void					Update( const uint32_t frame ); // Presses the next pattern at the start of every hold
+	const Tomtendo::Input*	GetInput() const;
+
+private:
+	Tomtendo::Input			input;
+	uint32_t				state;
+};
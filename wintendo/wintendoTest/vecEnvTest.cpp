@@ -0,0 +1,271 @@
+/*
+* MIT License
+*
+* Copyright( c ) 2017-2021 Thomas Griebel
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this softwareand associated documentation files( the "Software" ), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+* The above copyright noticeand this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+#include "../wintendoCore/include/tomtendo/interface.h"
+#include "../wintendoCore/include/tomtendo/vecEnv.h"
+#include "testUtil.h"
+#include "vecEnvTest.h"
+
+using namespace Tomtendo;
+
+// Usage: wintendoTest -vecenv [-romdir dir] [-steps N] [-envs N] [-threads N] [-seed N] [rom.nes ...]
+// Each ROM runs twice: the default observation with frame skip, and full RGB one frame per step.
+// Env 0 and the last env share a seed, one env is reset on its own halfway through.
+
+static const uint32_t	VecEnvDefaultSteps		= 30;
+static const uint32_t	VecEnvDefaultEnvs		= 3;
+static const uint32_t	VecEnvDefaultThreads	= 4;
+
+
+struct vecEnvTestConfig_t : testOptions_t
+{
+	uint32_t					steps;
+	uint32_t					envs;
+	uint32_t					threads;
+};
+
+
+struct vecEnvResult_t
+{
+	bool			passed = false;
+	uint32_t		steps = 0;
+	double			ms = 0.0;
+	std::string		message;
+};
+
+
+struct vecEnvBatch_t
+{
+	wtVecEnv				env;
+	std::vector<uint8_t>	observations;
+	std::vector<uint8_t>	ram;
+};
+
+
+class wtVecEnvRun
+{
+public:
+	wtVecEnvRun( const vecEnvTestConfig_t& config, const std::vector<uint8_t>& rom )
+		: cfg( config ), romData( rom ), pad( config.seed ), steps( 0 )
+	{
+	}
+
+	bool Check( const vecEnvConfig_t& envCfg, std::string& message )
+	{
+		std::unique_ptr<vecEnvBatch_t> serial( new vecEnvBatch_t() );
+		std::unique_ptr<vecEnvBatch_t> pooled( new vecEnvBatch_t() );
+
+		vecEnvConfig_t serialCfg = envCfg;
+		serialCfg.threads = 1;
+		vecEnvConfig_t pooledCfg = envCfg;
+		pooledCfg.threads = cfg.threads;
+
+		if ( !Init( *serial, serialCfg ) || !Init( *pooled, pooledCfg ) )
+		{
+			message = "init failed";
+			return false;
+		}
+
+		const uint32_t envCount = envCfg.envCount;
+		const uint32_t obsSize = serial->env.GetObservationSize();
+
+		std::vector<uint32_t> seeds( envCount );
+		for ( uint32_t envIx = 0; envIx < envCount; ++envIx ) {
+			seeds[ envIx ] = cfg.seed + envIx;
+		}
+		seeds[ envCount - 1 ] = seeds[ 0 ];
+
+		serial->env.Reset( seeds.data(), nullptr, serial->observations.data(), serial->ram.data() );
+		pooled->env.Reset( seeds.data(), nullptr, pooled->observations.data(), pooled->ram.data() );
+		if ( !Compare( *serial, *pooled, "reset", message ) ) {
+			return false;
+		}
+		if ( ( envCount > 1 ) && ( memcmp( &serial->observations[ 0 ], &serial->observations[ ( envCount - 1 ) * obsSize ], obsSize ) != 0 ) )
+		{
+			message = "equal seeds reset to different observations";
+			return false;
+		}
+		const std::vector<uint8_t> firstReset = serial->observations;
+
+		std::vector<ButtonFlags> actions( envCount );
+		std::vector<uint8_t> mask( envCount, 0 );
+		mask[ envCount / 2 ] = 1;
+
+		for ( uint32_t step = 0; step < cfg.steps; ++step )
+		{
+			if ( step == ( cfg.steps / 2 ) )
+			{
+				serial->env.Reset( seeds.data(), mask.data(), serial->observations.data(), serial->ram.data() );
+				pooled->env.Reset( seeds.data(), mask.data(), pooled->observations.data(), pooled->ram.data() );
+				if ( !Compare( *serial, *pooled, "masked reset", message ) ) {
+					return false;
+				}
+			}
+
+			for ( uint32_t envIx = 0; envIx < envCount; ++envIx ) {
+				actions[ envIx ] = static_cast<ButtonFlags>( pad.NextButtons() );
+			}
+			serial->env.Step( actions.data(), serial->observations.data(), serial->ram.data() );
+			pooled->env.Step( actions.data(), pooled->observations.data(), pooled->ram.data() );
+			if ( !Compare( *serial, *pooled, ( "step " + std::to_string( step ) ).c_str(), message ) ) {
+				return false;
+			}
+			++steps;
+		}
+
+		serial->env.Reset( seeds.data(), nullptr, serial->observations.data(), serial->ram.data() );
+		if ( serial->observations != firstReset )
+		{
+			message = "second reset differs from the first";
+			return false;
+		}
+		return true;
+	}
+
+	uint32_t GetStepCount() const
+	{
+		return steps;
+	}
+
+private:
+	bool Init( vecEnvBatch_t& batch, const vecEnvConfig_t& envCfg )
+	{
+		if ( batch.env.Init( romData.data(), static_cast<uint32_t>( romData.size() ), envCfg ) != 0 ) {
+			return false;
+		}
+		batch.observations.resize( batch.env.GetEnvCount() * batch.env.GetObservationSize() );
+		batch.ram.resize( batch.env.GetEnvCount() * batch.env.GetRamSize() );
+		return true;
+	}
+
+	static bool Compare( const vecEnvBatch_t& a, const vecEnvBatch_t& b, const char* pass, std::string& message )
+	{
+		if ( a.observations != b.observations )
+		{
+			message = std::string( pass ) + ": observations differ between the serial and pooled batch";
+			return false;
+		}
+		if ( a.ram != b.ram )
+		{
+			message = std::string( pass ) + ": RAM differs between the serial and pooled batch";
+			return false;
+		}
+		return true;
+	}
+
+	const vecEnvTestConfig_t&	cfg;
+	const std::vector<uint8_t>&	romData;
+	wtScriptedPad				pad;
+	uint32_t					steps;
+};
+
+
+static bool ParseArgs( const int argc, char* argv[], vecEnvTestConfig_t& cfg )
+{
+	cfg.steps = VecEnvDefaultSteps;
+	cfg.envs = VecEnvDefaultEnvs;
+	cfg.threads = VecEnvDefaultThreads;
+
+	return ParseTestArgs( argc, argv, TEST_OPTION_SEED, cfg, [ &cfg ]( const char* option, const char* value )
+	{
+		if ( strcmp( option, "-steps" ) == 0 ) {
+			cfg.steps = std::max( 1, atoi( value ) );
+		} else if ( strcmp( option, "-envs" ) == 0 ) {
+			cfg.envs = std::max( 2, atoi( value ) );
+		} else if ( strcmp( option, "-threads" ) == 0 ) {
+			cfg.threads = std::max( 2, atoi( value ) );
+		} else {
+			return false;
+		}
+		return true;
+	} );
+}
+
+
+int VecEnvMain( int argc, char* argv[] )
+{
+	vecEnvTestConfig_t cfg;
+	if ( !ParseArgs( argc, argv, cfg ) )
+	{
+		fprintf( stderr, "Usage: wintendoTest -vecenv [-romdir dir] [-steps N] [-envs N] [-threads N] [-seed N] [rom.nes ...]\n" );
+		return 1;
+	}
+
+	vecEnvConfig_t pooledCfg = DefaultVecEnvConfig();
+	pooledCfg.envCount = cfg.envs;
+
+	vecEnvConfig_t rawCfg = pooledCfg;
+	rawCfg.frameSkip = 1;
+	rawCfg.grayscale = false;
+	rawCfg.downsample = 1;
+	rawCfg.noopMax = 0;
+
+	// Each ROM's batches already fill the pool, so ROMs run one at a time
+	cfg.jobs = 1;
+
+	std::vector<vecEnvResult_t> results( cfg.roms.size() );
+
+	const auto job = [ & ]( const uint32_t romIx )
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		vecEnvResult_t& r = results[ romIx ];
+		std::vector<uint8_t> romData;
+		if ( !ReadFile( cfg.romDir + "/" + cfg.roms[ romIx ], romData ) )
+		{
+			r.message = "unreadable";
+		}
+		else
+		{
+			wtVecEnvRun run( cfg, romData );
+			r.passed = run.Check( pooledCfg, r.message ) && run.Check( rawCfg, r.message );
+			r.steps = run.GetStepCount();
+		}
+
+		r.ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+		return r.passed;
+	};
+
+	const auto formatRow = [ & ]( const uint32_t romIx )
+	{
+		const vecEnvResult_t& r = results[ romIx ];
+		char row[ 256 ];
+		snprintf( row, sizeof( row ), "%6u steps %8.1f ms  %s", r.steps, r.ms, r.message.c_str() );
+		return std::string( row );
+	};
+
+	return RunRomJobs( cfg, "ROMs stepped identically", job, formatRow );
+}